@@ -0,0 +1,195 @@
+#pragma once
+#include "windows.h"
+#include <directx/dxgiformat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+
+// the slice of DirectXTex the core uses. the pitch math follows DirectXTex, the file loaders and the mip filter
+// need WIC and aren't available off windows
+namespace DirectX {
+	enum TEX_DIMENSION {
+		TEX_DIMENSION_TEXTURE1D = 2,
+		TEX_DIMENSION_TEXTURE2D = 3,
+		TEX_DIMENSION_TEXTURE3D = 4,
+	};
+
+	enum TEX_MISC_FLAG : unsigned long {
+		TEX_MISC_TEXTURECUBE = 0x4L,
+	};
+
+	enum DDS_FLAGS : unsigned long {
+		DDS_FLAGS_NONE = 0x0,
+		DDS_FLAGS_FORCE_RGB = 0x10000,
+	};
+
+	enum WIC_FLAGS : unsigned long {
+		WIC_FLAGS_NONE = 0x0,
+		WIC_FLAGS_FORCE_RGB = 0x8,
+	};
+
+	enum TEX_FILTER_FLAGS : unsigned long {
+		TEX_FILTER_DEFAULT = 0,
+	};
+
+	enum CP_FLAGS : unsigned long {
+		CP_FLAGS_NONE = 0x0,
+	};
+
+	inline bool IsCompressed(DXGI_FORMAT fmt) noexcept {
+		return (fmt >= DXGI_FORMAT_BC1_TYPELESS && fmt <= DXGI_FORMAT_BC5_SNORM)
+			|| (fmt >= DXGI_FORMAT_BC6H_TYPELESS && fmt <= DXGI_FORMAT_BC7_UNORM_SRGB);
+	}
+
+	inline size_t BitsPerPixel(DXGI_FORMAT fmt) noexcept {
+		switch (fmt) {
+		case DXGI_FORMAT_R32G32B32A32_TYPELESS: case DXGI_FORMAT_R32G32B32A32_FLOAT: case DXGI_FORMAT_R32G32B32A32_UINT:
+		case DXGI_FORMAT_R32G32B32A32_SINT:
+			return 128;
+		case DXGI_FORMAT_R32G32B32_TYPELESS: case DXGI_FORMAT_R32G32B32_FLOAT: case DXGI_FORMAT_R32G32B32_UINT:
+		case DXGI_FORMAT_R32G32B32_SINT:
+			return 96;
+		case DXGI_FORMAT_R16G16B16A16_TYPELESS: case DXGI_FORMAT_R16G16B16A16_FLOAT: case DXGI_FORMAT_R16G16B16A16_UNORM:
+		case DXGI_FORMAT_R16G16B16A16_UINT: case DXGI_FORMAT_R16G16B16A16_SNORM: case DXGI_FORMAT_R16G16B16A16_SINT:
+		case DXGI_FORMAT_R32G32_TYPELESS: case DXGI_FORMAT_R32G32_FLOAT: case DXGI_FORMAT_R32G32_UINT: case DXGI_FORMAT_R32G32_SINT:
+		case DXGI_FORMAT_R32G8X24_TYPELESS: case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+			return 64;
+		case DXGI_FORMAT_R10G10B10A2_TYPELESS: case DXGI_FORMAT_R10G10B10A2_UNORM: case DXGI_FORMAT_R10G10B10A2_UINT:
+		case DXGI_FORMAT_R11G11B10_FLOAT: case DXGI_FORMAT_R8G8B8A8_TYPELESS: case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: case DXGI_FORMAT_R8G8B8A8_UINT: case DXGI_FORMAT_R8G8B8A8_SNORM:
+		case DXGI_FORMAT_R8G8B8A8_SINT: case DXGI_FORMAT_R16G16_TYPELESS: case DXGI_FORMAT_R16G16_FLOAT:
+		case DXGI_FORMAT_R16G16_UNORM: case DXGI_FORMAT_R16G16_UINT: case DXGI_FORMAT_R16G16_SNORM: case DXGI_FORMAT_R16G16_SINT:
+		case DXGI_FORMAT_R32_TYPELESS: case DXGI_FORMAT_D32_FLOAT: case DXGI_FORMAT_R32_FLOAT: case DXGI_FORMAT_R32_UINT:
+		case DXGI_FORMAT_R32_SINT: case DXGI_FORMAT_R24G8_TYPELESS: case DXGI_FORMAT_D24_UNORM_S8_UINT:
+		case DXGI_FORMAT_B8G8R8A8_UNORM: case DXGI_FORMAT_B8G8R8X8_UNORM: case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB: case DXGI_FORMAT_B8G8R8X8_TYPELESS: case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+			return 32;
+		case DXGI_FORMAT_R8G8_TYPELESS: case DXGI_FORMAT_R8G8_UNORM: case DXGI_FORMAT_R8G8_UINT: case DXGI_FORMAT_R8G8_SNORM:
+		case DXGI_FORMAT_R8G8_SINT: case DXGI_FORMAT_R16_TYPELESS: case DXGI_FORMAT_R16_FLOAT: case DXGI_FORMAT_D16_UNORM:
+		case DXGI_FORMAT_R16_UNORM: case DXGI_FORMAT_R16_UINT: case DXGI_FORMAT_R16_SNORM: case DXGI_FORMAT_R16_SINT:
+		case DXGI_FORMAT_B5G6R5_UNORM: case DXGI_FORMAT_B5G5R5A1_UNORM: case DXGI_FORMAT_B4G4R4A4_UNORM:
+			return 16;
+		case DXGI_FORMAT_R8_TYPELESS: case DXGI_FORMAT_R8_UNORM: case DXGI_FORMAT_R8_UINT: case DXGI_FORMAT_R8_SNORM:
+		case DXGI_FORMAT_R8_SINT: case DXGI_FORMAT_A8_UNORM: case DXGI_FORMAT_BC2_TYPELESS: case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB: case DXGI_FORMAT_BC3_TYPELESS: case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_TYPELESS: case DXGI_FORMAT_BC5_UNORM: case DXGI_FORMAT_BC5_SNORM: case DXGI_FORMAT_BC6H_TYPELESS:
+		case DXGI_FORMAT_BC6H_UF16: case DXGI_FORMAT_BC6H_SF16: case DXGI_FORMAT_BC7_TYPELESS: case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return 8;
+		case DXGI_FORMAT_BC1_TYPELESS: case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB: case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM: case DXGI_FORMAT_BC4_SNORM:
+			return 4;
+		case DXGI_FORMAT_R1_UNORM:
+			return 1;
+		default:
+			return 0;
+		}
+	}
+
+	inline HRESULT ComputePitch(DXGI_FORMAT fmt, size_t width, size_t height, size_t& rowPitch, size_t& slicePitch,
+		CP_FLAGS = CP_FLAGS_NONE) noexcept {
+		if (IsCompressed(fmt)) {
+			const size_t block_size = BitsPerPixel(fmt) * 2; // 4x4 texels per block
+			rowPitch = std::max<size_t>(1, (width + 3) / 4) * block_size;
+			slicePitch = rowPitch * std::max<size_t>(1, (height + 3) / 4);
+			return S_OK;
+		}
+		const size_t bpp = BitsPerPixel(fmt);
+		if (!bpp) return E_INVALIDARG;
+		rowPitch = (width * bpp + 7) / 8;
+		slicePitch = rowPitch * height;
+		return S_OK;
+	}
+
+	struct TexMetadata {
+		size_t width = 0;
+		size_t height = 0;
+		size_t depth = 0;
+		size_t arraySize = 0;
+		size_t mipLevels = 0;
+		uint32_t miscFlags = 0;
+		uint32_t miscFlags2 = 0;
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		TEX_DIMENSION dimension = TEX_DIMENSION_TEXTURE2D;
+
+		bool IsCubemap() const noexcept { return (miscFlags & TEX_MISC_TEXTURECUBE) != 0; }
+	};
+
+	struct Image {
+		size_t width;
+		size_t height;
+		DXGI_FORMAT format;
+		size_t rowPitch;
+		size_t slicePitch;
+		uint8_t* pixels;
+	};
+
+	// only 2d images, laid out item by item and mip by mip like DirectXTex does
+	class ScratchImage {
+	public:
+		ScratchImage() = default;
+		ScratchImage(ScratchImage&&) noexcept = default;
+		ScratchImage& operator=(ScratchImage&&) noexcept = default;
+		ScratchImage(const ScratchImage&) = delete;
+		ScratchImage& operator=(const ScratchImage&) = delete;
+
+		HRESULT Initialize2D(DXGI_FORMAT fmt, size_t width, size_t height, size_t arraySize, size_t mipLevels,
+			CP_FLAGS = CP_FLAGS_NONE) noexcept {
+			if (!width || !height || !arraySize || !mipLevels || !BitsPerPixel(fmt)) return E_INVALIDARG;
+			metadata = TexMetadata{ .width = width, .height = height, .depth = 1, .arraySize = arraySize,
+				.mipLevels = mipLevels, .format = fmt, .dimension = TEX_DIMENSION_TEXTURE2D };
+			num_images = arraySize * mipLevels;
+			images = std::make_unique<Image[]>(num_images);
+			size = 0;
+			for (size_t item = 0; item < arraySize; ++item) {
+				for (size_t mip = 0; mip < mipLevels; ++mip) {
+					auto& image = images[item * mipLevels + mip];
+					image.width = std::max<size_t>(width >> mip, 1);
+					image.height = std::max<size_t>(height >> mip, 1);
+					image.format = fmt;
+					ComputePitch(fmt, image.width, image.height, image.rowPitch, image.slicePitch);
+					size += image.slicePitch;
+				}
+			}
+			memory = std::make_unique<uint8_t[]>(size);
+			uint8_t* pixels = memory.get();
+			for (size_t i = 0; i < num_images; ++i) {
+				images[i].pixels = pixels;
+				pixels += images[i].slicePitch;
+			}
+			return S_OK;
+		}
+
+		void Release() noexcept {
+			*this = ScratchImage{};
+		}
+
+		const TexMetadata& GetMetadata() const noexcept { return metadata; }
+		const Image* GetImage(size_t mip, size_t item, size_t slice) const noexcept {
+			if (mip >= metadata.mipLevels || item >= metadata.arraySize || slice != 0) return nullptr;
+			return &images[item * metadata.mipLevels + mip];
+		}
+		const Image* GetImages() const noexcept { return images.get(); }
+		size_t GetImageCount() const noexcept { return num_images; }
+		uint8_t* GetPixels() const noexcept { return memory.get(); }
+		size_t GetPixelsSize() const noexcept { return size; }
+
+	private:
+		TexMetadata metadata{};
+		std::unique_ptr<Image[]> images;
+		size_t num_images = 0;
+		std::unique_ptr<uint8_t[]> memory;
+		size_t size = 0;
+	};
+
+	inline HRESULT LoadFromDDSFile(const std::filesystem::path::value_type*, DDS_FLAGS, TexMetadata*, ScratchImage&) noexcept { return E_NOTIMPL; }
+	inline HRESULT LoadFromHDRFile(const std::filesystem::path::value_type*, TexMetadata*, ScratchImage&) noexcept { return E_NOTIMPL; }
+	inline HRESULT LoadFromTGAFile(const std::filesystem::path::value_type*, TexMetadata*, ScratchImage&) noexcept { return E_NOTIMPL; }
+	inline HRESULT LoadFromWICFile(const std::filesystem::path::value_type*, WIC_FLAGS, TexMetadata*, ScratchImage&) noexcept { return E_NOTIMPL; }
+	inline HRESULT GenerateMipMaps(const Image*, size_t, const TexMetadata&, TEX_FILTER_FLAGS, size_t, ScratchImage&) noexcept {
+		return E_NOTIMPL;
+	}
+}
@@ -0,0 +1,14 @@
+#include "windows.h"
+
+// dxcompiler normally provides these, the headless core doesn't link it
+ULONG IUnknown::AddRef() {
+	return ++m_count;
+}
+
+ULONG IUnknown::Release() {
+	const ULONG result = --m_count;
+	if (result == 0) delete this;
+	return result;
+}
+
+IUnknown::~IUnknown() {}
@@ -0,0 +1,2 @@
+#pragma once
+#include <directx/d3d12.h>
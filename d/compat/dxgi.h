@@ -0,0 +1,53 @@
+#pragma once
+#include "windows.h"
+#include <directx/dxgiformat.h>
+#include "dxgicommon.h"
+
+// the subset of dxgi the core and D3D12MemAlloc name, there is no adapter to enumerate off windows
+typedef struct DXGI_ADAPTER_DESC {
+	WCHAR Description[128];
+	UINT VendorId;
+	UINT DeviceId;
+	UINT SubSysId;
+	UINT Revision;
+	SIZE_T DedicatedVideoMemory;
+	SIZE_T DedicatedSystemMemory;
+	SIZE_T SharedSystemMemory;
+	LUID AdapterLuid;
+} DXGI_ADAPTER_DESC;
+
+typedef struct DXGI_ADAPTER_DESC1 {
+	WCHAR Description[128];
+	UINT VendorId;
+	UINT DeviceId;
+	UINT SubSysId;
+	UINT Revision;
+	SIZE_T DedicatedVideoMemory;
+	SIZE_T DedicatedSystemMemory;
+	SIZE_T SharedSystemMemory;
+	LUID AdapterLuid;
+	UINT Flags;
+} DXGI_ADAPTER_DESC1;
+
+struct IDXGIObject : public IUnknown {};
+struct IDXGIDeviceSubObject : public IDXGIObject {};
+
+struct IDXGIAdapter : public IDXGIObject {
+	virtual HRESULT STDMETHODCALLTYPE GetDesc(DXGI_ADAPTER_DESC* pDesc) = 0;
+};
+struct IDXGIAdapter1 : public IDXGIAdapter {
+	virtual HRESULT STDMETHODCALLTYPE GetDesc1(DXGI_ADAPTER_DESC1* pDesc) = 0;
+};
+
+struct IDXGISwapChain : public IDXGIDeviceSubObject {
+	virtual HRESULT STDMETHODCALLTYPE Present(UINT SyncInterval, UINT Flags) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetBuffer(UINT Buffer, REFIID riid, void** ppSurface) = 0;
+};
+struct IDXGISwapChain1 : public IDXGISwapChain {};
+
+struct IDXGIFactory : public IDXGIObject {};
+struct IDXGIFactory1 : public IDXGIFactory {};
+struct IDXGIFactory2 : public IDXGIFactory1 {};
+struct IDXGIFactory3 : public IDXGIFactory2 {};
+struct IDXGIFactory4 : public IDXGIFactory3 {};
+struct IDXGIFactory5 : public IDXGIFactory4 {};
@@ -0,0 +1,2 @@
+#pragma once
+#include "dxgi1_4.h"
@@ -0,0 +1,19 @@
+#pragma once
+#include "windows.h"
+
+typedef struct DXGI_RATIONAL {
+	UINT Numerator;
+	UINT Denominator;
+} DXGI_RATIONAL;
+
+typedef struct DXGI_SAMPLE_DESC {
+	UINT Count;
+	UINT Quality;
+} DXGI_SAMPLE_DESC;
+
+typedef enum DXGI_COLOR_SPACE_TYPE {
+	DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709 = 0,
+	DXGI_COLOR_SPACE_CUSTOM = 0xFFFFFFFF,
+} DXGI_COLOR_SPACE_TYPE;
+
+#define DXGI_ERROR_UNSUPPORTED _HRESULT_TYPEDEF_(0x887A0004L)
@@ -0,0 +1,4 @@
+#pragma once
+#include "windows.h"
+#define __RPCNDR_H_VERSION__ 500
+typedef void* RPC_IF_HANDLE;
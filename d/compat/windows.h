@@ -0,0 +1,106 @@
+#pragma once
+// what the vendored d3d12 headers, d3dx12 and D3D12MemAlloc need from the windows sdk to compile off windows, on top of
+// the types dxc's WinAdapter already brings. nothing here talks to a driver, see Context::headless
+#include <type_traits>
+#include <dxc/Support/WinAdapter.h>
+
+#define MIDL_INTERFACE(x) struct
+#define DECLSPEC_UUID(x)
+#define DECLSPEC_NOVTABLE
+#define interface struct
+#define WINAPI_FAMILY_PARTITION(partitions) (partitions)
+#define WINAPI_PARTITION_APP 1
+#define WINAPI_PARTITION_GAMES 2
+#define WINAPI_PARTITION_DESKTOP 4
+typedef float FLOAT;
+typedef uint16_t UINT16;
+typedef int16_t INT16;
+typedef int64_t INT64;
+typedef unsigned short USHORT;
+typedef short SHORT;
+typedef char CHAR;
+typedef void* PVOID;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef intptr_t INT_PTR;
+#define _Always_(...)
+#define _Field_size_bytes_full_(...)
+#define _Field_size_bytes_full_opt_(...)
+#define _Field_size_full_opt_(...)
+#define _Inexpressible_(...)
+#define _Inout_updates_bytes_(...)
+#define _Out_writes_bytes_opt_(...)
+#define _Out_writes_opt_(...)
+#define _Outptr_opt_result_bytebuffer_(...)
+#define _Outptr_opt_result_maybenull_
+
+typedef struct tagRECT {
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+} RECT;
+typedef struct tagPOINT {
+	LONG x;
+	LONG y;
+} POINT;
+typedef struct _LUID {
+	DWORD LowPart;
+	LONG HighPart;
+} LUID;
+typedef struct _SECURITY_ATTRIBUTES {
+	DWORD nLength;
+	LPVOID lpSecurityDescriptor;
+	BOOL bInheritHandle;
+} SECURITY_ATTRIBUTES;
+DECLARE_HANDLE(HWND);
+DECLARE_HANDLE(HMONITOR);
+#define WINAPI
+#define APIENTRY
+#define CALLBACK
+#define EXTERN_C extern "C"
+#define DECLARE_INTERFACE(iface) struct iface
+#define DECLARE_INTERFACE_(iface, base) struct iface : public base
+#define STDMETHOD(method) virtual HRESULT STDMETHODCALLTYPE method
+#define STDMETHOD_(type, method) virtual type STDMETHODCALLTYPE method
+#define PURE = 0
+#define THIS_
+#define THIS void
+#define BEGIN_INTERFACE
+#define END_INTERFACE
+#define CONST_VTBL
+
+// the root signature helpers of d3dx12.h allocate their temporaries from the process heap
+inline HANDLE GetProcessHeap() { return nullptr; }
+inline LPVOID HeapAlloc(HANDLE, DWORD, SIZE_T size) { return malloc(size); }
+inline BOOL HeapFree(HANDLE, DWORD, LPVOID memory) { free(memory); return TRUE; }
+// events are only waited on behind a device fence, which a headless queue never has
+#define INFINITE 0xFFFFFFFF
+#define EVENT_ALL_ACCESS 0x1F0003
+#define WAIT_OBJECT_0 0
+inline HANDLE CreateEventEx(SECURITY_ATTRIBUTES*, const char*, DWORD, DWORD) { return nullptr; }
+inline DWORD WaitForSingleObject(HANDLE, DWORD) { return WAIT_OBJECT_0; }
+inline BOOL CloseHandle(HANDLE) { return TRUE; }
+// declared only, there is no driver behind these to hand them out
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) EXTERN_C const GUID name
+#define DEFINE_ENUM_FLAG_OPERATORS(T)                                                                                            \
+	extern "C++" {                                                                                                               \
+	inline constexpr T operator|(T a, T b) { return T(static_cast<std::underlying_type_t<T>>(a) | static_cast<std::underlying_type_t<T>>(b)); } \
+	inline constexpr T operator&(T a, T b) { return T(static_cast<std::underlying_type_t<T>>(a) & static_cast<std::underlying_type_t<T>>(b)); } \
+	inline constexpr T operator^(T a, T b) { return T(static_cast<std::underlying_type_t<T>>(a) ^ static_cast<std::underlying_type_t<T>>(b)); } \
+	inline constexpr T operator~(T a) { return T(~static_cast<std::underlying_type_t<T>>(a)); }                               \
+	inline T& operator|=(T& a, T b) { return a = a | b; }                                                                       \
+	inline T& operator&=(T& a, T b) { return a = a & b; }                                                                       \
+	inline T& operator^=(T& a, T b) { return a = a ^ b; }                                                                       \
+	}
+typedef GUID UUID;
+
+// WinAdapter only takes types in __uuidof, the msvc form also takes expressions (IID_PPV_ARGS, D3D12MemAlloc).
+// nothing off windows resolves an interface by guid, so unregistered interfaces get the null guid
+template <typename T> inline GUID __emulated_uuidof() { return GUID{}; }
+template <typename T> inline GUID __uuidof_expr(T&&) { return __emulated_uuidof<std::decay_t<T>>(); }
+#undef __uuidof
+#define __uuidof(x) __uuidof_expr(x)
+#undef IID_PPV_ARGS
+#define IID_PPV_ARGS(ppType) __uuidof(**(ppType)), reinterpret_cast<void**>(ppType)
+inline const IID IID_IUnknown = __emulated_uuidof<IUnknown>();
@@ -0,0 +1,63 @@
+#pragma once
+#include <type_traits>
+#include <utility>
+#include "../windows.h"
+
+namespace Microsoft::WRL {
+	template <typename T>
+	class ComPtr {
+	public:
+		using InterfaceType = T;
+
+		ComPtr() = default;
+		ComPtr(std::nullptr_t) {}
+		template <typename U> ComPtr(U* other) : ptr(other) { add_ref(); }
+		ComPtr(const ComPtr& other) : ptr(other.ptr) { add_ref(); }
+		template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+		ComPtr(const ComPtr<U>& other) : ptr(other.Get()) { add_ref(); }
+		ComPtr(ComPtr&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+		template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+		ComPtr(ComPtr<U>&& other) noexcept : ptr(other.Detach()) {}
+		~ComPtr() { release(); }
+
+		auto operator=(std::nullptr_t) -> ComPtr& { release(); return *this; }
+		auto operator=(T* other) -> ComPtr& { ComPtr(other).Swap(*this); return *this; }
+		auto operator=(const ComPtr& other) -> ComPtr& { ComPtr(other).Swap(*this); return *this; }
+		auto operator=(ComPtr&& other) noexcept -> ComPtr& { ComPtr(std::move(other)).Swap(*this); return *this; }
+		template <typename U>
+		auto operator=(const ComPtr<U>& other) -> ComPtr& { ComPtr(other).Swap(*this); return *this; }
+
+		auto Swap(ComPtr& other) noexcept -> void { std::swap(ptr, other.ptr); }
+		[[nodiscard]] auto Get() const -> T* { return ptr; }
+		auto operator->() const -> T* { return ptr; }
+		explicit operator bool() const { return ptr != nullptr; }
+		auto operator&() -> T** { release(); return &ptr; }
+		auto GetAddressOf() -> T** { return &ptr; }
+		[[nodiscard]] auto GetAddressOf() const -> T* const* { return &ptr; }
+		auto ReleaseAndGetAddressOf() -> T** { release(); return &ptr; }
+		auto Detach() -> T* { return std::exchange(ptr, nullptr); }
+		auto Attach(T* other) -> void { release(); ptr = other; }
+		auto Reset() -> unsigned long { return release(); }
+		template <typename U>
+		auto As(ComPtr<U>* other) const -> HRESULT { return ptr->QueryInterface(__emulated_uuidof<U>(), reinterpret_cast<void**>(other->ReleaseAndGetAddressOf())); }
+		template <typename U>
+		auto CopyTo(U** other) const -> HRESULT { return ptr->QueryInterface(__emulated_uuidof<U>(), reinterpret_cast<void**>(other)); }
+		auto CopyTo(T** other) const -> HRESULT { add_ref(); *other = ptr; return S_OK; }
+
+	private:
+		template <typename U> friend class ComPtr;
+
+		auto add_ref() const -> void { if (ptr) ptr->AddRef(); }
+		auto release() -> unsigned long {
+			T* old = std::exchange(ptr, nullptr);
+			return old ? old->Release() : 0;
+		}
+
+		T* ptr{ nullptr };
+	};
+
+	template <typename T, typename U>
+	auto operator==(const ComPtr<T>& a, const ComPtr<U>& b) -> bool { return a.Get() == b.Get(); }
+	template <typename T>
+	auto operator==(const ComPtr<T>& a, std::nullptr_t) -> bool { return a.Get() == nullptr; }
+}
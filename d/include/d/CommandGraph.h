@@ -1,15 +1,33 @@
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <future>
 #include <ranges>
+#include <thread>
 
 #include "d/CommandList.h"
+#include "d/Future.h"
+#include "d/LinearArena.h"
+#include "d/Queue.h"
 #include "d/Resource.h"
+#include "d/TransientResources.h"
 
 namespace d {
 	enum class CommandType {
 		eDraw,
 		eCopyBuffer,
+		eDispatch,
+		eDispatchIndirect,
+		eTraceRays,
+		eCopyTexture,
+	};
+
+	// a single read or write of a command, index is into the command's reads or writes
+	struct CommandAccess {
+		u32 command;
+		u32 index;
+		bool write;
 	};
 
 	struct DrawCmd {
@@ -27,15 +45,14 @@ namespace d {
 		u32 dst_offset;
 		u32 src_offset;
 		u32 num_bytes;
-
-		void _run_cmd();
 	};
 
+	// packed header of a recorded command, reads and writes live in the recorder's arena
 	struct CommandInfo {
 		CommandType type;
 		u32 index;
-		std::vector<Handle> reads; // resources read by this command
-		std::vector<Handle> writes;// resources written to by this command
+		std::span<const Handle> reads; // resources read by this command
+		std::span<const Handle> writes;// resources written to by this command
 
 		[[nodiscard]] auto read_contains(Handle handle) const -> bool {
 			return std::ranges::any_of(reads, [&](const auto& read) { return read == handle;  });
@@ -45,21 +62,28 @@ namespace d {
 		}
 	};
 
+	// spans of the internal infos point into the recorder's arena, reads and writes are shared with the command's CommandInfo
 	struct nDrawInfo {
-		std::vector<Handle> reads; // shader reads
-		std::vector<Handle> writes; // shader unordered accesses + render targets
-		std::vector<ResourceMetaData> meta_data; // in order of read + writes 
+		std::span<const Handle> reads; // shader reads
+		std::span<const Handle> writes; // shader unordered accesses + render targets
+		std::span<const ResourceMetaData> meta_data; // in order of read + writes 
 
-		std::vector<ByteSpan> push_constants;
-		std::vector<DrawCmd> commands;
+		std::span<const std::span<const std::byte>> push_constants; // one per draw command
+		std::span<const DrawCmd> commands;
 
 		std::string_view debug_name;
-		GraphicsPipeline pl;
+		const GraphicsPipeline* pl;
 		bool depth{ false };
 
+		// resolved before recording, the view caches can't be touched by the recording threads
+		std::span<const D3D12_CPU_DESCRIPTOR_HANDLE> render_target_handles;
+		std::optional<D3D12_CPU_DESCRIPTOR_HANDLE> depth_target_handle;
+		std::optional<TextureExtent> viewport; // of the first render or depth target
+
 		[[nodiscard]] auto get_meta_data(usize index, bool write) const -> ResourceMetaData { return write ? meta_data[index + reads.size()] : meta_data[index]; }
 		[[nodiscard]] inline auto get_barrier_info(usize index, bool write) const -> std::pair<D3D12_BARRIER_SYNC, D3D12_BARRIER_ACCESS>;
 
+		auto resolve_targets(LinearArena& arena) -> void;
 		auto do_command(CommandList& list) const -> void;
 	};
 
@@ -67,6 +91,7 @@ namespace d {
 		std::initializer_list<std::pair<Handle, ResourceMetaData>> resources;
 		std::initializer_list<ByteSpan> push_constants;
 		std::initializer_list<DrawCmd> draw_cmds;
+		const GraphicsPipeline* pl{ nullptr };
 		std::string_view debug_name;
 	};
 
@@ -78,20 +103,141 @@ namespace d {
 		u32 num_bytes;
 	};
 
+	// direct and indirect compute dispatches
+	struct nDispatchInfo {
+		std::span<const Handle> reads; // shader reads + argument buffer
+		std::span<const Handle> writes; // shader unordered accesses
+		std::span<const ResourceMetaData> meta_data; // in order of read + writes
+
+		std::span<const std::byte> push_constants;
+		const ComputePipeline* pl;
+		std::array<u32, 3> group_count;
+		std::optional<std::pair<Resource<Buffer>, u32>> indirect_args; // (argument buffer, offset) of dispatch_indirect
+
+		std::string_view debug_name;
+
+		[[nodiscard]] auto get_meta_data(usize index, bool write) const -> ResourceMetaData { return write ? meta_data[index + reads.size()] : meta_data[index]; }
+		[[nodiscard]] inline auto get_barrier_info(usize index, bool write) const -> std::pair<D3D12_BARRIER_SYNC, D3D12_BARRIER_ACCESS>;
+
+		auto do_command(CommandList& list) const -> void;
+	};
+
+	struct DispatchInfo {
+		std::initializer_list<std::pair<Handle, ResourceMetaData>> resources;
+		std::span<const std::byte> push_constants;
+		const ComputePipeline* pl{ nullptr };
+		u32 group_count_x{ 1 };
+		u32 group_count_y{ 1 };
+		u32 group_count_z{ 1 };
+		std::string_view debug_name;
+	};
+
+	// args holds a D3D12_DISPATCH_ARGUMENTS at args_offset, it is read as an indirect argument by the graph
+	struct DispatchIndirectInfo {
+		std::initializer_list<std::pair<Handle, ResourceMetaData>> resources;
+		std::span<const std::byte> push_constants;
+		const ComputePipeline* pl{ nullptr };
+		Resource<Buffer> args;
+		u32 args_offset{ 0 };
+		std::string_view debug_name;
+	};
+
+	struct nTraceRaysInfo {
+		std::span<const Handle> reads; // shader reads + acceleration structures
+		std::span<const Handle> writes; // shader unordered accesses
+		std::span<const ResourceMetaData> meta_data; // in order of read + writes
+
+		std::span<const std::byte> push_constants;
+		const RayTracingPipeline* pl;
+		TextureExtent extent;
+
+		std::string_view debug_name;
+
+		[[nodiscard]] auto get_meta_data(usize index, bool write) const -> ResourceMetaData { return write ? meta_data[index + reads.size()] : meta_data[index]; }
+		[[nodiscard]] inline auto get_barrier_info(usize index, bool write) const -> std::pair<D3D12_BARRIER_SYNC, D3D12_BARRIER_ACCESS>;
+
+		auto do_command(CommandList& list) const -> void;
+	};
+
+	struct TraceRaysInfo {
+		std::initializer_list<std::pair<Handle, ResourceMetaData>> resources;
+		std::span<const std::byte> push_constants;
+		const RayTracingPipeline* pl{ nullptr };
+		TextureExtent extent;
+		std::string_view debug_name;
+	};
+
+	struct nCopyTextureInfo {
+		Resource<D2> dst;
+		Resource<D2> src;
+	};
+
+	struct CopyTextureInfo {
+		Resource<D2> dst;
+		Resource<D2> src;
+	};
+
 	struct CommandRecorder {
+		// allocations and time between reset and compile of the last recorded frame
+		struct Stats {
+			u32 num_commands{ 0 };
+			u32 num_allocations{ 0 };
+			usize arena_bytes{ 0 };
+			double record_ns{ 0. };
+		};
+
+		// everything variable sized a frame records, rewound by reset
+		LinearArena arena;
 		std::vector<nDrawInfo> draw_infos;
 		std::vector<nCopyBufferInfo> copy_buffer_infos;
+		std::vector<nDispatchInfo> dispatch_infos; // both eDispatch and eDispatchIndirect
+		std::vector<nTraceRaysInfo> trace_rays_infos;
+		std::vector<nCopyTextureInfo> copy_texture_infos;
 
 		std::vector<CommandInfo> command_stream;
+		// resources whose contents have to survive the graph, without any every command is kept
+		std::vector<Handle> outputs;
+		// uploads still in flight, the first submission touching one of their resources waits on its queue.
+		// not part of the topology, so a future becoming ready doesn't cost a recompile
+		std::vector<ResourceFuture> futures;
+		// rebuilt by every compile, kept around so its allocation is reused
+		std::vector<u64> topology_key;
+
+		Stats stats;
+		std::chrono::high_resolution_clock::time_point reset_time;
+		u64 heap_allocations_at_reset{ 0 }; // get_num_heap_allocations
 
-		auto draw(const DrawInfo& info)->CommandRecorder;
-		auto copy_buffer(const CopyBufferInfo& info)->CommandRecorder;
+		auto draw(const DrawInfo& info)->CommandRecorder&;
+		auto copy_buffer(const CopyBufferInfo& info)->CommandRecorder&;
+		auto dispatch(const DispatchInfo& info)->CommandRecorder&;
+		auto dispatch_indirect(const DispatchIndirectInfo& info)->CommandRecorder&;
+		auto trace_rays(const TraceRaysInfo& info)->CommandRecorder&;
+		auto copy_texture(const CopyTextureInfo& info)->CommandRecorder&;
+		// commands whose writes don't reach a marked output through read or write dependencies get culled
+		auto mark_output(Handle res)->CommandRecorder&;
+		// orders every command touching the future's resource behind the work producing it, ready futures are dropped right away
+		auto wait_for(const ResourceFuture& future)->CommandRecorder&;
 
-		[[nodiscard]] inline auto get_draw_info(const CommandInfo& info) const->nDrawInfo;
-		[[nodiscard]] inline auto get_copy_buffer_info(const CommandInfo& info) const->nCopyBufferInfo;
+		[[nodiscard]] inline auto get_draw_info(const CommandInfo& info) const -> const nDrawInfo&;
+		[[nodiscard]] inline auto get_copy_buffer_info(const CommandInfo& info) const -> const nCopyBufferInfo&;
+		[[nodiscard]] inline auto get_dispatch_info(const CommandInfo& info) const -> const nDispatchInfo&;
+		[[nodiscard]] inline auto get_trace_rays_info(const CommandInfo& info) const -> const nTraceRaysInfo&;
+		[[nodiscard]] inline auto get_copy_texture_info(const CommandInfo& info) const -> const nCopyTextureInfo&;
+		// meta data of the shader resources of draws, dispatches and ray dispatches, empty for copies
+		[[nodiscard]] auto get_meta_data(const CommandInfo& info) const -> std::span<const ResourceMetaData>;
+		[[nodiscard]] auto get_debug_name(const CommandInfo& info) const -> std::string_view;
 		[[nodiscard]] auto get_barrier_info(const CommandInfo& info, usize index, bool write) const -> std::pair<D3D12_BARRIER_SYNC, D3D12_BARRIER_ACCESS>;
 		[[nodiscard]] auto get_layout_requirements(const CommandInfo& info) const -> std::vector<std::pair<Handle, D3D12_BARRIER_LAYOUT>>;
+		[[nodiscard]] auto get_preferred_queue(const CommandInfo& info) const -> QueueType;
+		// packs everything barriers and layouts are derived from into topology_key
+		auto build_topology_key() -> void;
+		// of topology_key, only picks the cache entry, a hit still compares the whole key
+		[[nodiscard]] auto topology_hash() const -> u64;
 		auto do_command(CommandList& list, const CommandInfo& info) const;
+		auto resolve_views() -> void;
+		auto reset() -> void;
+		// closes the frame's stats, called by compile
+		auto finish_recording() -> void;
 	};
 
 	struct Empty {};
@@ -106,29 +252,187 @@ namespace d {
 			bool is_texture;
 		};
 
+		struct ResourceUsage {
+			D3D12_BARRIER_SYNC sync{ D3D12_BARRIER_SYNC_NONE };
+			D3D12_BARRIER_ACCESS access{ D3D12_BARRIER_ACCESS_NO_ACCESS };
+			D3D12_BARRIER_LAYOUT layout{ D3D12_BARRIER_LAYOUT_COMMON };
+		};
+
+		// per handle state while flattening, stamps are step + 1 so 0 means untouched
+		struct ResourceTrack {
+			ID3D12Resource* native{ nullptr }; // looked up once on first touch
+			ResourceUsage last;
+			ResourceUsage step;
+			D3D12_BARRIER_SYNC edge_sync{ D3D12_BARRIER_SYNC_NONE };
+			D3D12_BARRIER_ACCESS edge_access{ D3D12_BARRIER_ACCESS_NO_ACCESS };
+			D3D12_BARRIER_LAYOUT initial_layout{ D3D12_BARRIER_LAYOUT_COMMON };
+			u32 step_stamp{ 0 };
+			u32 edge_stamp{ 0 };
+			bool is_texture{ false };
+			bool transient{ false };
+			bool discard{ false }; // first use of a transient, its contents are undefined
+		};
+
+		struct Stats {
+			u32 num_commands{ 0 };
+			u32 num_edges{ 0 };
+			u32 num_steps{ 0 };
+			u32 num_barriers{ 0 };
+			u32 num_barrier_batches{ 0 };
+			u32 num_async_commands{ 0 };
+			u32 num_submissions{ 0 };
+			u32 num_queue_waits{ 0 };
+			u32 num_skipped_waits{ 0 }; // cross queue dependencies already covered by an earlier wait
+			u32 num_split_barriers{ 0 }; // barriers begun right after the last use and ended right before the next one
+			u32 num_culled_commands{ 0 };
+			double graphify_ms{ 0. };
+			double flatten_ms{ 0. };
+		};
+
+		// the commands of one execution step that run on the same queue, barriers are merged into a single Barrier() call
+		struct QueueStep {
+			u32 step;
+			std::vector<u32> commands;
+			std::vector<D3D12_BUFFER_BARRIER> buffer_barriers;
+			std::vector<D3D12_TEXTURE_BARRIER> texture_barriers;
+			// handle each barrier above was built for, native pointers are null on the null backend and for unplaced transients
+			std::vector<Handle> buffer_barrier_handles;
+			std::vector<Handle> texture_barrier_handles;
+			// begin halves of split barriers, recorded after the step's commands
+			std::vector<D3D12_BUFFER_BARRIER> split_buffer_barriers;
+			std::vector<D3D12_TEXTURE_BARRIER> split_texture_barriers;
+			// a split barrier is still open after this step, both halves have to end up in the same command list
+			bool split_pending{ false };
+		};
+
+		// one ExecuteCommandLists on a single queue, waits and signals refer to the n-th signal of a queue within the graph
+		struct Submission {
+			QueueType queue;
+			std::vector<QueueStep> steps;
+			std::vector<std::pair<QueueType, u32>> waits;
+			std::optional<u32> signal;
+		};
+
+		// everything derived from the topology of a command stream, reused as long as the topology stays the same
+		struct Compiled {
+			// adj list of execution DAG and flattened version of that groups commands into execution steps
+			std::vector<std::vector<std::pair<u32, std::vector<Barrier>>>> command_adj_list;
+			// culled commands have no edges and don't show up in any execution step
+			std::vector<bool> live_commands;
+			std::vector<std::pair<std::vector<u32>, std::vector<Barrier>>> execution_steps;
+			// (index of command, array of textures and their required layouts)
+			std::vector<std::vector<std::pair<Handle, D3D12_BARRIER_LAYOUT>>> required_layouts;
+			std::vector<QueueType> command_queues;
+
+			// in submission order, a wait always refers to a signal of an earlier submission
+			std::vector<Submission> submissions;
+			// restores texture layouts at the end of the last general submission
+			std::vector<D3D12_TEXTURE_BARRIER> native_exit_barriers;
+			// joins the async queues back into the general queue
+			std::vector<std::pair<QueueType, u32>> exit_waits;
+
+			// what this was compiled from, compared on every cache hit since different topologies can share a hash
+			std::vector<u64> topology_key;
+			Stats stats;
+		};
+
+		struct CacheStats {
+			u32 hits{ 0 };
+			u32 misses{ 0 };
+			u32 collisions{ 0 }; // hash hits whose topology differed, counted as misses as well
+			double hit_ms{ 0. };  // total time spent hashing and looking up on hits
+			double miss_ms{ 0. }; // total time spent compiling on misses
+		};
+
 		CommandRecorder recorder;
-		// adj list of execution DAG and flattened version of that groups commands into execution steps
-		std::vector<std::vector<std::pair<u32, std::vector<Barrier>>>> command_adj_list;
-		std::vector<std::pair<std::vector<u32>, std::vector<Barrier>>> execution_steps;
-		// (index of command, array of textures and their required layouts)
-		std::vector<std::vector<std::pair<Handle, D3D12_BARRIER_LAYOUT>>> required_layouts;
-
-		// per execution step
-		std::vector<std::vector<D3D12_BUFFER_BARRIER>> native_buffer_barriers;
-		std::vector<std::vector<D3D12_TEXTURE_BARRIER>> native_texture_barriers;
-		// per command
-		std::vector<std::vector<D3D12_TEXTURE_BARRIER>> native_command_level_transitions;
+		// textures and buffers that only live within this graph, placed when the graph gets compiled
+		TransientResources transients;
+
+		// compiled graphs keyed by CommandRecorder::topology_hash
+		std::unordered_map<u64, Compiled> compiled_cache;
+		const Compiled* compiled{ nullptr };
+		// the whole cache is dropped once a compile finds it this full, there is no lru
+		usize max_cached_graphs{ 64 };
+		CacheStats cache_stats;
+
+		// longest chain of dependent commands by cost, no reordering or queue assignment gets the frame below it
+		struct CriticalPath {
+			std::vector<u32> commands; // in execution order
+			double cost_us{ 0. };
+			double frame_us{ 0. }; // replaying the submissions with the same costs, every queue running its commands one after another
+		};
+
+		struct RecordStats {
+			u32 num_lists{ 0 };
+			u32 num_future_waits{ 0 }; // queue waits on resource futures still in flight, at most one per queue and submission
+			u32 num_allocations{ 0 }; // heap allocations of the last execute, none once the lists and the members below are grown
+			double execute_ms{ 0. };
+		};
+
+		// a contiguous range of (step, first command, end command) of one submission recorded into its own list,
+		// a step's barriers are recorded by the chunk that starts at the step's first command
+		struct RecordChunk {
+			const Submission* submission;
+			u32 first_range; // into chunk_ranges
+			u32 end_range;
+			CommandList* list;
+		};
+
+		struct ChunkRange {
+			const QueueStep* step;
+			u32 begin;
+			u32 end;
+		};
+
+		// futures still in flight touching a handle slot, stamps are execute_stamp so stale entries need no clearing
+		struct PendingFutures {
+			u32 stamp{ 0 };
+			u32 first_future; // into recorder.futures, chained through next_pending_future
+			std::array<bool, num_queue_types> covered;
+		};
+
+		// every chunk of a submission records into its own list with its own allocator. one set per frame slot
+		// (Context::get_frame_index), so an allocator is only reset once the gpu is done with the frame that used it last.
+		// that only holds while a graph is executed at most once per frame
+		std::vector<std::array<std::vector<CommandList>, num_queue_types>> frame_lists;
+		std::optional<u64> last_executed_frame; // Context::frame_number
+		// a submission is split into chunks of about total weight / threads, a draw weighs its number of draw calls.
+		// at most this many threads of Context::workers pull chunks, the calling one included
+		u32 max_recording_threads{ std::thread::hardware_concurrency() };
+		u32 min_recording_chunk_weight{ 256 };
+		RecordStats record_stats;
+
+		// execute's bookkeeping, cleared every frame but kept for its capacity
+		std::vector<RecordChunk> chunks;
+		std::vector<ChunkRange> chunk_ranges;
+		std::vector<std::pair<usize, usize>> submission_chunks; // [first, end) chunk of every submission
+		std::vector<QueueFences> future_waits; // per submission
+		std::array<std::vector<u64>, num_queue_types> signal_values; // fence values of the signals issued, indexed like Submission::signal
+		std::vector<PendingFutures> pending_futures; // by handle slot
+		std::vector<u32> next_pending_future; // like recorder.futures, ~0u ends a chain
+		u32 execute_stamp{ 0 };
 
 		CommandGraph() = default;
 		~CommandGraph() = default;
 
 		auto visualize_graph_to_image(const char* name) -> void;
+		// costs are in microseconds and indexed like the command stream. without measurements a draw costs one per draw call
+		// plus one and everything else one, which is only good for the shape of the frame
+		[[nodiscard]] auto estimate_command_costs() const -> std::vector<double>;
+		[[nodiscard]] auto find_critical_path(std::span<const double> costs) const -> CriticalPath;
+		// chrome://tracing / perfetto json of the compiled graph, a lane per queue with every barrier and a lane with the critical path
+		auto export_trace(const char* path, std::span<const double> costs = {}) const -> void;
 
 		auto record() -> std::tuple<CommandRecorder&> { return recorder; }
 
-		[[nodiscard]] auto get_barrier_dependencies(const CommandInfo& c0, const CommandInfo& c1) const -> std::vector<Barrier>;
-		auto graphify() -> void;
-		auto flatten() -> void;
-		auto do_commands(CommandList& list) const;
+		auto cull(Compiled& out) const -> void;
+		[[nodiscard]] auto make_barrier(const CommandInfo& c0, const CommandAccess& a0, const CommandInfo& c1, const CommandAccess& a1, Handle res) const -> Barrier;
+		auto graphify(Compiled& out) const -> void;
+		auto flatten(Compiled& out) -> void;
+		auto compile() -> void;
+		// records and submits the compiled graph on all queues, the general queue waits for everything at the end.
+		// at most once per frame, the lists of the frame slot are reused on every call
+		auto execute() -> void;
+		auto report_stats() const -> void;
 	};
 }
@@ -6,7 +6,7 @@
 #include "d/Types.h"
 #include "d/stdafx.h"
 
-#include <glm/glm.hpp>
+#include <span>
 
 
 namespace d {
@@ -32,9 +32,26 @@ namespace d {
 		RayTracingPipeline& pl;
 	};
 
+	// what a list recorded since its last record(), null lists only keep these
+	struct CommandListStats {
+		u32 num_draws{ 0 };
+		u32 num_dispatches{ 0 }; // direct, indirect and ray dispatches
+		u32 num_copies{ 0 };
+		u32 num_barrier_calls{ 0 };
+		u32 num_barriers{ 0 };
+		u32 num_state_changes{ 0 }; // pipelines, targets, viewports and index buffers
+		u64 copy_bytes{ 0 };        // buffer copies and copies between buffers and textures, whole texture copies don't know their footprint without a device
+		u64 push_constant_bytes{ 0 };
+
+		auto operator+=(const CommandListStats& o) -> CommandListStats&;
+	};
+
 	struct CommandList {
 		ComPtr<ID3D12CommandAllocator> allocator;
 		ComPtr<ID3D12GraphicsCommandList7> handle;
+		CommandListStats stats;
+		D3D12_COMMAND_LIST_TYPE type{ D3D12_COMMAND_LIST_TYPE_DIRECT };
+		bool null{ false }; // handed out by a null queue, nothing gets recorded natively
 
 		CommandList() = default;
 		~CommandList() = default;
@@ -42,12 +59,35 @@ namespace d {
 		auto record()->CommandList&;
 		auto finish()->CommandList&;
 
+		// viewport and scissor covering the whole target
+		auto set_viewport(u32 width, u32 height)->CommandList&;
+
 		auto copy_buffer_region(Resource<Buffer> src, Resource<Buffer> dst,
-			usize size, u32 src_offset = 0, u32 dst_offset = 0)
+			usize size, u64 src_offset = 0, u64 dst_offset = 0)
 			->CommandList&;
 
+		auto copy_image(Resource<D2> src, Resource<D2> dst)->CommandList&;
+		// one subresource of dst from a buffer laid out like footprint, Offset is into src
+		auto copy_texture_region(Resource<Buffer> src, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint, Handle dst, u32 subresource)->CommandList&;
+		// box of one subresource of src into a buffer laid out like footprint, Offset is into dst
+		auto copy_texture_to_buffer(Handle src, u32 subresource, const D3D12_BOX& box, Resource<Buffer> dst, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint)->CommandList&;
+
+		// one Barrier() call for everything in the batch
+		auto barrier(std::span<const D3D12_BUFFER_BARRIER> buffer_barriers, std::span<const D3D12_TEXTURE_BARRIER> texture_barriers)->CommandList&;
+		auto set_render_targets(std::span<const D3D12_CPU_DESCRIPTOR_HANDLE> render_targets, const D3D12_CPU_DESCRIPTOR_HANDLE* depth_target)->CommandList&;
+		// pipeline, bindless heap and root signature
+		auto set_pipeline(const GraphicsPipeline& pl)->CommandList&;
+		auto set_pipeline(const ComputePipeline& pl)->CommandList&;
+		auto set_pipeline(const RayTracingPipeline& pl)->CommandList&;
+		auto set_graphics_push_constants(std::span<const std::byte> push_constants)->CommandList&;
+		auto set_compute_push_constants(std::span<const std::byte> push_constants)->CommandList&;
+
+		auto draw_indexed(const D3D12_INDEX_BUFFER_VIEW& ibo_view, u32 index_count, u32 instance_count, u32 start_index)->CommandList&;
+		auto dispatch(u32 x, u32 y, u32 z)->CommandList&;
+		auto dispatch_indirect(Resource<Buffer> args, u32 offset)->CommandList&;
+		auto dispatch_rays(const RayTracingPipeline& pl, const TextureExtent& extent)->CommandList&;
+
 		//auto clear_image(Resource<D2> image, float color[4])->CommandList&;
-		//auto copy_image(Resource<D2> src, Resource<D2> dst)->CommandList&;
 
 		//auto transition(u32 res_handle, D3D12_RESOURCE_STATES after_state)->CommandList&;
 		//auto transition(Resource<Buffer> buffer, D3D12_RESOURCE_STATES after_state)->CommandList&;
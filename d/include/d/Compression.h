@@ -0,0 +1,47 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "d/Types.h"
+
+namespace d {
+	enum class PayloadCodec : u8 {
+		eStored,
+		eLZ4, // lz4 block format, what LZ4_compress_default writes
+	};
+
+	constexpr u32 payload_magic = 0x59415042; // "BPAY"
+	constexpr u32 default_payload_chunk_size = 64 * 1024;
+
+	// compressed asset bytes on disk: this header, a u32 compressed size per chunk, then the chunks back to back.
+	// every chunk decompresses to chunk_size bytes (the last one to the rest) on its own, so chunks can go to different
+	// workers and straight to their place in the destination. a chunk whose compressed size equals its size is stored as is
+	struct PayloadHeader {
+		u32 magic{ payload_magic };
+		PayloadCodec codec{ PayloadCodec::eLZ4 };
+		u8 padding[3]{};
+		u32 chunk_size{ default_payload_chunk_size };
+		u32 num_chunks{ 0 };
+		u64 size{ 0 }; // decompressed
+	};
+
+	struct PayloadChunk {
+		std::span<const std::byte> src;
+		u64 dst_offset;
+		u32 size; // decompressed
+	};
+
+	// header and chunks of a payload, nullopt if it is truncated or not a payload at all
+	[[nodiscard]] auto parse_payload(std::span<const std::byte> payload) -> std::optional<std::pair<PayloadHeader, std::vector<PayloadChunk>>>;
+	// writes exactly dst.size() bytes, false on corrupt input instead of reading or writing out of bounds
+	[[nodiscard]] auto decompress_chunk(PayloadCodec codec, std::span<const std::byte> src, std::span<std::byte> dst) -> bool;
+
+	// greedy single pass compressor, fast rather than small. meant for tools and tests, the engine only decompresses
+	auto lz4_compress_block(std::span<const std::byte> src, std::vector<std::byte>& dst) -> void;
+	[[nodiscard]] auto lz4_decompress_block(std::span<const std::byte> src, std::span<std::byte> dst) -> bool;
+	[[nodiscard]] auto compress_payload(std::span<const std::byte> data, PayloadCodec codec = PayloadCodec::eLZ4,
+		u32 chunk_size = default_payload_chunk_size) -> std::vector<std::byte>;
+}
@@ -2,64 +2,226 @@
 
 #include "d/stdafx.h"
 
-#include <GLFW/glfw3.h>
 #include <d/D3D12MemAlloc.h>
 
+#include <array>
+#include <deque>
+#include <functional>
+#include <variant>
+
 #include "d/AssetLibrary.h"
+#include "d/FlatHashMap.h"
+#include "d/Future.h"
 #include "d/Queue.h"
 #include "d/Resource.h"
 #include "d/ResourceCreator.h"
+#include "d/WorkerPool.h"
+
+struct GLFWwindow;
 
 namespace d {
+	// d3d12 caps shader visible CBV_SRV_UAV heaps at a million descriptors on every binding tier
+	constexpr u32 max_bindless_descriptors = 1'000'000;
+
+	// cpu only heap, descriptors are written here and never read by the gpu directly
 	struct DescriptorHeap {
 		ComPtr<ID3D12DescriptorHeap> heap;
+		D3D12_DESCRIPTOR_HEAP_TYPE type;
 		D3D12_CPU_DESCRIPTOR_HANDLE start;
 		D3D12_CPU_DESCRIPTOR_HANDLE end;
-		usize size{ 0 };
+		usize size{ 0 }; // descriptors handed out past start so far, including freed ones
+		u32 capacity{ 0 };
+		u32 max_capacity{ 0 }; // doubles up to this once full, moving every descriptor
 		u32 stride;
+		std::vector<u32> free_indices; // freed descriptors are reused before end moves on
+		// registry slot whose cached view sits at each index, invalid_handle_index for the rest. lets a grow only visit
+		// the views it moved
+		std::vector<u32> owner_slots;
+		// where descriptor 0 ends up in the shader visible heap, and the descriptors that changed since the last copy
+		// there. only used by the staging heap of bindless descriptors
+		u32 shader_index_offset{ 0 };
+		bool track_dirty{ false };
+		std::vector<u32> dirty_indices;
+		bool rewritten{ false }; // a dirty descriptor was written over in place instead of freshly allocated
 
 		DescriptorHeap() = default;
-		auto init(D3D12_DESCRIPTOR_HEAP_TYPE type, u32 num_desc) -> void;
+		auto init(D3D12_DESCRIPTOR_HEAP_TYPE type, u32 num_desc, u32 max_num_desc = 0) -> void;
+
+		auto allocate()->D3D12_CPU_DESCRIPTOR_HANDLE;
+		auto free(D3D12_CPU_DESCRIPTOR_HANDLE handle) -> void;
+		auto mark_dirty(D3D12_CPU_DESCRIPTOR_HANDLE handle) -> void;
+		// a descriptor shaders may already have read got new contents
+		auto mark_rewritten(D3D12_CPU_DESCRIPTOR_HANDLE handle) -> void;
+		auto set_owner(D3D12_CPU_DESCRIPTOR_HANDLE handle, Handle resource) -> void;
 
 		auto push_back(const ResourceViewInfo& info)->u32;
 		auto push_back(const AccelerationStructureViewInfo& info) -> u32;
 		auto push_back_get_handle(const ResourceViewInfo& info)
 			->D3D12_CPU_DESCRIPTOR_HANDLE;
 		auto get_index_of(D3D12_CPU_DESCRIPTOR_HANDLE handle)->u32;
+		// index shaders use in ResourceDescriptorHeap[]
+		[[nodiscard]] auto get_shader_index(D3D12_CPU_DESCRIPTOR_HANDLE handle) -> u32 { return shader_index_offset + get_index_of(handle); }
+		auto grow() -> void;
+	};
+
+	struct DescriptorStats {
+		u32 num_copy_calls{ 0 };  // CopyDescriptors calls, one per flush that had anything to copy
+		u32 num_copied_ranges{ 0 };
+		u32 num_copied_descriptors{ 0 };
+		u32 num_grows{ 0 };
+		u32 num_rewrite_retires{ 0 }; // shader visible heaps replaced because descriptors in flight frames read were rewritten
+		u32 num_frame_descriptors{ 0 }; // taken from the ring over the whole lifetime
+	};
+
+	// the one shader visible CBV_SRV_UAV heap. the front is a ring of descriptors that only live for a frame and get
+	// reclaimed by fence value, persistent descriptors sit behind it. both are written to cpu only staging heaps first and
+	// copied over in one batched CopyDescriptors call per flush, shader visible heaps are write combined and can't be a copy source
+	struct BindlessHeap {
+		ComPtr<ID3D12DescriptorHeap> heap;
+		D3D12_CPU_DESCRIPTOR_HANDLE start;
+		u32 stride{ 1 };
+		u32 ring_capacity{ 0 };
+		u32 persistent_capacity{ 0 }; // follows the persistent staging heap, the shader visible heap is recreated when that grew
+
+		DescriptorHeap ring_staging;
+		// monotonic counters, ring index = counter % ring_capacity
+		u64 ring_head{ 0 };
+		u64 ring_tail{ 0 };
+		u64 ring_flushed{ 0 }; // everything before this is already copied to the shader visible heap
+
+		// ring allocations and replaced heaps stay around until every queue passed the fences of the frame that used them last
+		std::deque<std::pair<QueueFences, u64>> ring_frames;
+		std::deque<std::pair<QueueFences, ComPtr<ID3D12DescriptorHeap>>> retired_heaps;
+
+		DescriptorStats stats;
+
+		// the shader visible heap itself is created by the first flush
+		auto init(u32 num_frame_desc) -> void;
+		// count contiguous per frame descriptors, returns the first ring index which is also their shader index
+		auto allocate_frame(u32 count) -> u32;
+		[[nodiscard]] auto get_frame_staging_handle(u32 ring_index) const -> D3D12_CPU_DESCRIPTOR_HANDLE;
+		// uncached view that is only valid for the frame, returns its shader index
+		auto push_frame_view(const ResourceViewInfo& info) -> u32;
+		// copies everything written since the last flush into the shader visible heap. it is replaced by a new one when
+		// the persistent heap grew or rewrote descriptors frames in flight may still read
+		auto flush(DescriptorHeap& persistent) -> void;
+		// the ring descriptors taken so far are in use until the current fence values of all queues complete
+		auto end_frame() -> void;
+		auto reclaim() -> void;
+		// persistent is the staging heap flushed into this one
+		auto report_stats(const DescriptorHeap& persistent) const -> void;
 	};
 
 	struct DescriptorStorage {
 		DescriptorHeap render_target_heap;
 		DescriptorHeap depth_stencil_heap;
-		DescriptorHeap bindable_desc_heap;
+		DescriptorHeap bindable_desc_heap; // persistent bindless descriptors, staging side
+		BindlessHeap bindless;
 
-		auto init(u32 num_desc) -> void;
+		auto init(u32 num_bindable, u32 num_frame_bindable, u32 num_targets) -> void;
+		auto flush() -> void { bindless.flush(bindable_desc_heap); }
 	};
 
 	struct ResourceState {
 		ResourceType type;
 		D3D12_BARRIER_ACCESS access_state { D3D12_BARRIER_ACCESS_COMMON };
 		D3D12_BARRIER_LAYOUT layout { D3D12_BARRIER_LAYOUT_COMMON };
+		bool transient{ false }; // placed by a command graph, the slot stays reserved while there is no native resource
+	};
+
+	// everything barrier building and command recording touch per handle, 32 bytes so two share a cache line
+	struct HotResource {
+		ID3D12Resource* native{ nullptr }; // owned by the cold half
+		D3D12_GPU_VIRTUAL_ADDRESS gpu_addr{ 0 };
+		ResourceState state;
+	};
+
+	// a view cache entry of a resource, kept with the resource so releasing or replacing it doesn't have to scan the caches
+	struct CachedView {
+		std::variant<BufferViewInfo, TextureViewInfo, AccelerationStructureViewInfo> info;
+		DescriptorHeap* heap;
+		D3D12_CPU_DESCRIPTOR_HANDLE handle;
+	};
+
+	// only needed when resources get created, released, named or get views
+	struct ColdResource {
+		ComPtr<ID3D12Resource> resource;
+		ComPtr<D3D12MA::Allocation> allocation;
+		NameId name;
+		std::vector<CachedView> views;
+		// what a headless resource would have been created with, real ones ask their native resource
+		std::optional<D3D12_RESOURCE_DESC> headless_desc;
+	};
+
+	// what a released resource leaves behind for the gpu, kept until every queue passed the fence values it got tagged with
+	struct DeferredRelease {
+		QueueFences fences;
+		ComPtr<ID3D12Resource> resource;
+		ComPtr<D3D12MA::Allocation> allocation;
+		std::vector<std::pair<DescriptorHeap*, D3D12_CPU_DESCRIPTOR_HANDLE>> descriptors;
+	};
+
+	struct DeferredReleaseStats {
+		u32 num_deferred{ 0 };
+		u32 num_collected{ 0 };
+		u32 max_pending{ 0 };
+	};
+
+	struct ResourceSlot {
+		u32 generation{ 0 };
+		u32 next_free{ invalid_handle_index }; // only meaningful while the slot is on the free list
 	};
 
 	struct ResourceRegistry {
-		std::vector<ResourceState> resource_states;
-		std::vector<ComPtr<ID3D12Resource>> resources;
-		std::vector<ComPtr<D3D12MA::Allocation>> allocations;
+		// all indexed by slot, released slots form an intrusive free list starting at free_head
+		std::vector<HotResource> hot;
+		std::vector<ColdResource> cold;
+		std::vector<ResourceSlot> slots;
+		u32 free_head{ invalid_handle_index };
 
-		std::unordered_map<std::string_view, u32> named_resource_map;
+		NameTable names;
+		FlatHashMap<u32, Handle, NameIdHash> named_resource_map; // NameId::value -> handle
 
-		std::unordered_map<BufferViewInfo, D3D12_CPU_DESCRIPTOR_HANDLE>
-			buffer_view_cache;
-		std::unordered_map<TextureViewInfo, D3D12_CPU_DESCRIPTOR_HANDLE>
-			texture_view_cache;
-		std::unordered_map<AccelerationStructureViewInfo, D3D12_CPU_DESCRIPTOR_HANDLE>
-			acceleration_structure_cache;
+		FlatHashMap<BufferViewInfo, D3D12_CPU_DESCRIPTOR_HANDLE> buffer_view_cache;
+		FlatHashMap<TextureViewInfo, D3D12_CPU_DESCRIPTOR_HANDLE> texture_view_cache;
+		FlatHashMap<AccelerationStructureViewInfo, D3D12_CPU_DESCRIPTOR_HANDLE> acceleration_structure_cache;
 
 		DescriptorStorage storage;
 
+		// not ordered by fence, a release waiting on an idle queue must not hold up the ones behind it
+		std::vector<DeferredRelease> deferred_releases;
+		DeferredReleaseStats deferred_stats;
+
 		auto create_buffer(const BufferCreateInfo& info) const -> Resource<Buffer>;
-		auto create_texture_2d(TextureCreateInfo& info) const -> Resource<D2>;
+		auto create_texture_2d(const TextureCreateInfo& info) const -> Resource<D2>;
+		[[nodiscard]] auto get_desc(Handle handle) const -> D3D12_RESOURCE_DESC;
+		// rewrites every cached view of a handle in place after its native resource changed. shader indices stay the same,
+		// the bindless heap swaps its shader visible heap on the next flush so frames in flight keep the old descriptors
+		auto refresh_views(Handle handle) -> void;
+		// drops every cached view of a handle, their descriptors are handed to descriptors to be freed later
+		auto release_views(Handle handle, std::vector<std::pair<DescriptorHeap*, D3D12_CPU_DESCRIPTOR_HANDLE>>& descriptors) -> void;
+		// points the cached views in a heap at their new location after the heap moved
+		auto rebase_views(const DescriptorHeap& heap, D3D12_CPU_DESCRIPTOR_HANDLE old_start) -> void;
+		// swaps the native resource behind a live handle, views have to be refreshed separately.
+		// the old native is released once the work submitted so far is done
+		auto set_native(Handle handle, const ComPtr<ID3D12Resource>& resource) -> void;
+		auto defer_release(DeferredRelease&& release) -> void;
+		// frees everything whose fences passed
+		auto collect_releases() -> void;
+		// deferred releases and the bindless descriptors
+		auto report_stats() const -> void;
+
+		[[nodiscard]] auto is_alive(Handle handle) const -> bool {
+			const u32 index = get_handle_index(handle);
+			return index < slots.size() && slots[index].generation == get_handle_generation(handle);
+		}
+		// slot a handle points at, handles whose resource got released fail here in debug builds
+		[[nodiscard]] auto get_slot(Handle handle) const -> u32 {
+#ifdef _DEBUG
+			assert_log(is_alive(handle), "stale resource handle, its resource was released");
+#endif
+			return get_handle_index(handle);
+		}
 	};
 
 	struct Swapchain {
@@ -71,30 +233,207 @@ namespace d {
 		u32 image_index{ 0 };
 	};
 
+	// what a headless context would have asked a device for
+	struct HeadlessStats {
+		u32 num_resources{ 0 };
+		u64 resource_bytes{ 0 }; // estimated, see get_headless_allocation_info
+		u32 num_views{ 0 };
+		u64 mapped_bytes{ 0 };
+	};
+
+	constexpr u32 default_frames_in_flight = 2;
+	constexpr u64 default_upload_ring_size = 64ull * 1024 * 1024;
+	constexpr u64 default_readback_ring_size = 16ull * 1024 * 1024;
+
+	// where size bytes go in a ring of monotonic head and tail counters, the tail end is skipped instead of wrapping.
+	// nullopt if they don't fit before tail
+	[[nodiscard]] auto fit_ring_allocation(u64 head, u64 tail, u64 capacity, u64 size, u64 alignment) -> std::optional<u64>;
+
+	struct UploadStats {
+		u32 num_batches{ 0 }; // submissions on the copy queue
+		u32 num_copies{ 0 };
+		u64 num_bytes{ 0 };
+		u32 num_full_waits{ 0 }; // times a stager had to submit early and wait because the ring ran full
+		u64 num_compressed_bytes{ 0 };
+		u64 num_decompressed_bytes{ 0 };
+		double decompress_ms{ 0. }; // wall time of the workers, not summed over them
+	};
+
+	// one persistently mapped upload heap buffer every Stager packs its data into. allocations never wrap, the tail end of
+	// the ring is skipped instead. space is handed back once the copy queue passed the fence of the batch that used it.
+	// the copy lists live here as well, so a stager can go out of scope while its copies are still in flight
+	struct UploadRing {
+		Resource<Buffer> buffer;
+		std::byte* mapped{ nullptr };
+		std::vector<std::byte> host_memory; // headless rings have no upload heap, packing still goes through memory
+		bool write_combined{ false }; // mapped upload heap memory, fast to write and very slow to read back
+		u64 capacity{ 0 };
+		// monotonic counters, ring offset = counter % capacity
+		u64 head{ 0 };
+		u64 tail{ 0 };
+		std::deque<std::pair<u64, u64>> batches; // (copy queue fence value, head once the batch was packed)
+		// (list, copy queue fence value of its last submission), a deque so handed out lists stay put
+		std::deque<std::pair<CommandList, u64>> lists;
+		UploadStats stats;
+
+		auto init(u64 size) -> void;
+		// ring offset of size bytes, nullopt if they don't fit even after reclaiming. the caller has to submit what it packed so far
+		auto allocate(u64 size, u64 alignment) -> std::optional<u64>;
+		// a copy queue list the gpu is done with, already recording
+		auto acquire_list() -> CommandList&;
+		// submits the list without waiting, everything allocated so far is read until the returned fence value
+		auto submit(CommandList& list) -> u64;
+		// blocks until the oldest batch in flight is done and reclaims it
+		auto wait_oldest() -> void;
+		auto reclaim() -> void;
+		auto report_stats() const -> void;
+	};
+
+	struct ReadbackStats {
+		u32 num_requests{ 0 };
+		u32 num_delivered{ 0 };
+		u32 num_batches{ 0 }; // submissions on the general queue
+		u64 num_bytes{ 0 };
+		u64 latency_frames{ 0 }; // summed over delivered requests, frames between request and callback
+		u32 num_full_waits{ 0 }; // times a request had to wait for older ones because the ring ran full
+		u32 num_grows{ 0 }; // times it was full of requests from the current frame instead
+	};
+
+	// what a readback callback gets, data lives in the readback ring and is only valid during the callback
+	struct ReadbackResult {
+		std::span<const std::byte> data;
+		// texture readbacks only: rows of the region are footprint.layout.Footprint.RowPitch apart, Offset is 0
+		std::optional<SubresourceFootprint> footprint;
+	};
+	using ReadbackCallback = std::function<void(const ReadbackResult&)>;
+
+	// a region of one subresource, the whole subresource without a box
+	struct TextureReadbackRange {
+		u32 subresource{ 0 };
+		std::optional<D3D12_BOX> box;
+	};
+
+	struct ReadbackRequest {
+		Handle src;
+		u64 src_offset; // buffers only
+		u32 subresource; // textures only, like box
+		D3D12_BOX box;
+		std::optional<SubresourceFootprint> footprint; // set for textures, Offset is into the ring
+		u64 begin; // ring counter, the data sits at begin % capacity
+		u64 end;   // head once the request got packed
+		u64 size;
+		u64 fence_value; // general queue, 0 while the copy isn't recorded and submitted yet
+		u64 frame_number; // Context::frame_number when requested
+		ReadbackCallback callback;
+	};
+
+	// one persistently mapped readback heap buffer every readback gets copied into, the mirror of UploadRing. the copies
+	// of a frame are recorded into one general queue list submitted at its end, behind everything else the frame did, so
+	// a readback sees the results of the frame it was requested in. callbacks run in request order from BeginRendering
+	// once that frame got through the gpu, the cpu only waits when the ring runs full or on wait()
+	struct ReadbackRing {
+		Resource<Buffer> buffer;
+		const std::byte* mapped{ nullptr };
+		std::vector<std::byte> host_memory; // headless rings have no readback heap, callbacks get zeroes
+		u64 capacity{ 0 };
+		// monotonic counters, ring offset = counter % capacity
+		u64 head{ 0 };
+		u64 tail{ 0 };
+		std::deque<ReadbackRequest> requests; // in request order, which is also fence order
+		// (list, general queue fence value of its last submission)
+		std::deque<std::pair<CommandList, u64>> lists;
+		u64 num_requested{ 0 };
+		u64 num_delivered{ 0 }; // requests are delivered in order, a future is ready once its id is below this
+		ReadbackStats stats;
+
+		auto init(u64 size) -> void;
+		// size bytes of src starting at offset. sources have to stay alive until the end of the frame
+		auto request_readback(Resource<Buffer> src, u64 offset, u64 size, ReadbackCallback callback) -> ReadbackFuture;
+		// textures are read in their resting layout, the one command graphs restore at their end
+		auto request_readback(Handle src, const TextureReadbackRange& range, ReadbackCallback callback) -> ReadbackFuture;
+		// records and submits the copies of everything requested so far without waiting, EndRendering does this every frame
+		auto submit() -> void;
+		// runs the callbacks of every request the gpu is done with
+		auto deliver() -> void;
+		// blocks until request id got delivered, submitting it first if needed
+		auto wait(u64 id) -> void;
+
+		// ring counter of size bytes. waits for submitted requests while they don't fit, grows once only
+		// unsubmitted ones are left
+		auto allocate(u64 size, u64 alignment) -> u64;
+		// moves the unsubmitted requests into a bigger buffer with room for size more bytes
+		auto grow(u64 size, u64 alignment) -> void;
+		auto create_ring_buffer(u64 size) -> void;
+		// a general queue list the gpu is done with, already recording
+		auto acquire_list() -> CommandList&;
+		auto report_stats() const -> void;
+	};
+
+	// what the cpu records a frame into while the gpu may still be reading earlier frames. a frame slot is reused
+	// once the ring comes around to it again, the cpu only waits if the gpu hasn't finished the frame that used it last
+	struct Frame {
+		CommandList main_command_list;
+		QueueFences fences{}; // of every queue right after the frame got submitted, zero before the slot's first use
+	};
+
+	struct FrameStats {
+		u64 num_frames{ 0 };
+		u32 num_cpu_waits{ 0 }; // BeginRendering calls that had to wait on the gpu
+		double cpu_wait_ms{ 0. };
+	};
+
 	struct Context {
 		ComPtr<ID3D12Device5> device;
 		ComPtr<IDXGIFactory5> factory;
 
 		Queue general_queue;
-		// TODO: add multiple queue support
+		Queue async_compute_queue;
+		Queue async_transfer_queue;
 #ifdef _DEBUG
 		ComPtr<ID3D12Debug> debug_interface;
 		ComPtr<ID3D12Debug1> debug_interface1;
 #endif
 
-		CommandList main_command_list;
-
-		Queue general_q;
+		std::vector<Frame> frames;
+		u64 frame_number{ 0 }; // frames begun so far
+		FrameStats frame_stats;
+		ComPtr<ID3D12CommandSignature> dispatch_indirect_signature;
 
 		ComPtr<D3D12MA::Allocator> allocator;
 		Swapchain swap_chain;
 		AssetLibrary asset_lib;
 		ResourceRegistry resource_registry;
+		UploadRing upload_ring;
+		ReadbackRing readback_ring;
+
+		// no window, device or gpu: queues and command lists are null and resources have no native side, which leaves
+		// the cpu side of the engine (recording, graph compilation, staging) to run without one. the d_core target in
+		// CMakeLists.txt builds that part on its own, off windows against the stand in headers in d/compat
+		bool headless{ false };
+		HeadlessStats headless_stats;
+		// shared by command graph recording and stager decompression, started by init
+		std::unique_ptr<WorkerPool> workers;
 
 		Context() = default;
+		Context(Context&&) = default;
+		auto operator=(Context&&)->Context & = default;
 		~Context() = default;
 
-		auto init(GLFWwindow* window, u32 sc_count) -> void;
+		auto init(GLFWwindow* window, u32 sc_count, u32 frames_in_flight = default_frames_in_flight) -> void;
+		// pipelines, acceleration structures and the asset library still need a real device
+		auto init_headless(u32 width, u32 height, u32 sc_count, u32 frames_in_flight = default_frames_in_flight) -> void;
+		auto init_frames(u32 frames_in_flight) -> void;
+
+		[[nodiscard]] auto get_queue(QueueType type) -> Queue&;
+
+		// slot of the frame currently being recorded
+		[[nodiscard]] auto get_frame_index() const -> u32 { return static_cast<u32>(frame_number % frames.size()); }
+		// signals queues with unsignaled work first, so the values cover everything submitted so far
+		[[nodiscard]] auto get_fences() -> QueueFences;
+		[[nodiscard]] auto fences_completed(const QueueFences& fences) -> bool;
+		auto wait_for_fences(const QueueFences& fences) -> void;
+		// frames, descriptors, deferred releases, uploads and readbacks, plus the null queues when headless
+		auto report_stats() -> void;
 
 		[[nodiscard]] auto
 			BeginRendering()->std::pair<Resource<D2>, CommandList&>;
@@ -103,7 +442,12 @@ namespace d {
 
 		auto register_resource(const ComPtr<ID3D12Resource>& resource,
 			const ComPtr<D3D12MA::Allocation>& allocation, ResourceState initial_state)->u32;
+		// the handle is dead right away, the native resource, its allocation and descriptors live on until the gpu passed
+		// the fences. without fences that is everything submitted so far, pending_on also covers the next signal of a queue
+		// for work that is recorded but not submitted yet
 		auto release_resource(Handle handle) -> void;
+		auto release_resource(Handle handle, QueueType pending_on) -> void;
+		auto release_resource(Handle handle, const QueueFences& fences) -> void;
 
 	};
 
@@ -123,30 +467,42 @@ namespace d {
 		return rd_barrier;
 	}
 
+	[[nodiscard]] inline auto get_hot_res(Handle handle) -> HotResource& {
+		return c.resource_registry.hot[c.resource_registry.get_slot(handle)];
+	}
+
 	template <ResourceC T>
 	inline auto get_native_res(Resource<T> handle) -> ID3D12Resource* {
-		u32 index = static_cast<u32>(handle);
-		return c.resource_registry.resources[index].Get();
+		return get_hot_res(static_cast<u32>(handle)).native;
 	};
 
+	template <ResourceC T>
+	[[nodiscard]] inline auto get_named_res(const NameId& name) -> Resource<T> {
+		const auto* handle = c.resource_registry.named_resource_map.find(name.value);
+		assert_log(handle, "rescource with name doesn't exist");
+		return Resource<T>(*handle);
+	};
+	// hashes the string on every call, prefer the NameId overload with _name in anything that runs per frame
 	template <ResourceC T>
 	[[nodiscard]] inline auto get_named_res(std::string_view name) -> Resource<T> {
-		assert_log(c.resource_registry.named_resource_map.contains(name), "rescource with name doesn't exist");
-		return Resource<T>(c.resource_registry.named_resource_map[name]);
+		return get_named_res<T>(make_name_id(name));
 	};
+	inline auto intern_name(std::string_view name) -> NameId {
+		return c.resource_registry.names.intern(name);
+	}
 	template <ResourceC T>
 	inline auto get_res_state(Resource<T> handle) -> ResourceState& {
-		u32 index = static_cast<u32>(handle);
-		return c.resource_registry.resource_states[index];
+		return get_hot_res(static_cast<u32>(handle)).state;
 	};
 	[[nodiscard]] inline auto get_res_state(Handle handle) -> ResourceState {
-		return c.resource_registry.resource_states[handle];
+		return get_hot_res(handle).state;
 	};
 
 	inline auto get_native_res(Handle handle) -> ID3D12Resource* {
-		return c.resource_registry.resources[handle].Get();
+		return get_hot_res(handle).native;
 	}
 
-	[[nodiscard]] auto InitContext(GLFWwindow* window, u32 sc_count) -> std::pair<ResourceRegistry&, AssetLibrary&>;
+	[[nodiscard]] auto InitContext(GLFWwindow* window, u32 sc_count, u32 frames_in_flight = default_frames_in_flight) -> std::pair<ResourceRegistry&, AssetLibrary&>;
+	[[nodiscard]] auto InitHeadlessContext(u32 width, u32 height, u32 sc_count, u32 frames_in_flight = default_frames_in_flight) -> ResourceRegistry&;
 
 } // namespace d
@@ -441,7 +441,7 @@ struct Budget
 struct D3D12MA_API VirtualAllocation
 {
     /// \brief Unique idenitfier of current allocation. 0 means null/invalid.
-    AllocHandle AllocHandle;
+    D3D12MA::AllocHandle AllocHandle;
 };
 
 /** \brief Represents single memory allocation.
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "d/Types.h"
+
+namespace d {
+	// open addressing with linear probing over one flat array, erase shifts the following cluster back instead of leaving
+	// tombstones. a lookup is one hash and a short scan of neighbouring slots, no node chasing. the hash has to be well
+	// mixed in its low bits since it's masked down to the slot count
+	template <typename K, typename V, typename H = std::hash<K>>
+	struct FlatHashMap {
+		struct Slot {
+			K key{};
+			V value{};
+			bool occupied{ false };
+		};
+
+		std::vector<Slot> slots;
+		usize count{ 0 };
+		usize mask{ 0 };
+
+		[[nodiscard]] auto size() const -> usize { return count; }
+		[[nodiscard]] auto empty() const -> bool { return count == 0; }
+
+		auto clear() -> void {
+			for (auto& slot : slots) slot = Slot{};
+			count = 0;
+		}
+
+		// at most 3/4 full, capacity stays a power of two
+		auto reserve(usize num_elements) -> void {
+			const usize needed = std::bit_ceil(std::max<usize>(num_elements + num_elements / 3 + 1, 16));
+			if (needed > slots.size()) rehash(needed);
+		}
+
+		[[nodiscard]] auto find(const K& key) -> V* {
+			return const_cast<V*>(std::as_const(*this).find(key));
+		}
+
+		[[nodiscard]] auto find(const K& key) const -> const V* {
+			if (count == 0) return nullptr;
+			for (usize i = H{}(key) & mask;; i = (i + 1) & mask) {
+				const auto& slot = slots[i];
+				if (!slot.occupied) return nullptr;
+				if (slot.key == key) return &slot.value;
+			}
+		}
+
+		[[nodiscard]] auto contains(const K& key) const -> bool { return find(key) != nullptr; }
+
+		// default constructs the value if the key isn't there yet
+		auto operator[](const K& key) -> V& {
+			reserve(count + 1);
+			usize i = H{}(key) & mask;
+			for (; slots[i].occupied; i = (i + 1) & mask) {
+				if (slots[i].key == key) return slots[i].value;
+			}
+			slots[i] = Slot{ .key = key, .value = {}, .occupied = true };
+			++count;
+			return slots[i].value;
+		}
+
+		auto erase(const K& key) -> bool {
+			if (count == 0) return false;
+			usize i = H{}(key) & mask;
+			for (; slots[i].occupied; i = (i + 1) & mask) {
+				if (slots[i].key == key) break;
+			}
+			if (!slots[i].occupied) return false;
+
+			// pull back every following entry whose home slot doesn't lie between the hole and itself
+			for (usize j = (i + 1) & mask; slots[j].occupied; j = (j + 1) & mask) {
+				const usize home = H{}(slots[j].key) & mask;
+				if (((j - home) & mask) < ((j - i) & mask)) continue;
+				slots[i] = std::move(slots[j]);
+				i = j;
+			}
+			slots[i] = Slot{};
+			--count;
+			return true;
+		}
+
+		template <typename F>
+		auto for_each(F&& f) -> void {
+			for (auto& slot : slots) {
+				if (slot.occupied) f(std::as_const(slot.key), slot.value);
+			}
+		}
+
+		auto rehash(usize num_slots) -> void {
+			auto old = std::exchange(slots, std::vector<Slot>(num_slots));
+			mask = num_slots - 1;
+			for (auto& slot : old) {
+				if (!slot.occupied) continue;
+				usize i = H{}(slot.key) & mask;
+				while (slots[i].occupied) i = (i + 1) & mask;
+				slots[i] = std::move(slot);
+			}
+		}
+	};
+}
@@ -3,12 +3,26 @@
 #include "d/Resource.h"
 
 namespace d {
+  // a resource whose contents are ready once work_queue passed fence_value, handed out by Stager::flush.
+  // commands that touch it are only ordered behind the work through CommandRecorder::wait_for
   struct ResourceFuture {
-    QueueType work_queue; // basically ignore for now since everything's on 1 general queue
-    D3D12_RESOURCE_STATES state_before;
-    D3D12_BARRIER_SYNC sync_before;
-    D3D12_BARRIER_ACCESS access_before;
-    D3D12_BARRIER_LAYOUT layout_before;
+    QueueType work_queue{ QueueType::ASYNC_TRANSFER };
+    u64 fence_value{ 0 };
     Handle res;
+    // nothing was uploaded because the staged data was unusable, the resource keeps what it held. ready right away
+    bool failed{ false };
+
+    [[nodiscard]] auto ready() const -> bool;
+    // blocks the cpu, only meant for loading screens and tools
+    auto wait() const -> void;
+  };
+
+  // a readback handed out by ReadbackRing::request_readback, ready once its callback ran
+  struct ReadbackFuture {
+    u64 id{ 0 };
+
+    [[nodiscard]] auto ready() const -> bool;
+    // blocks the cpu until the callback ran, for screenshots and tools rather than every frame
+    auto wait() const -> void;
   };
-}
\ No newline at end of file
+}
@@ -35,6 +35,26 @@ inline constexpr uint32_t operator"" _fnv1a(const char* aString, const size_t aS
 	return hash_type::hash(aString, aStrlen, hash_type::default_offset_basis);
 }
 
+namespace hash {
+	// splitmix64 finalizer, every input bit flips about half of the output bits
+	constexpr uint64_t mix64(uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ull;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebull;
+		x ^= x >> 31;
+		return x;
+	}
+
+	// for keys packed into 64 bit words by hand, one multiply chain per word instead of a std::hash call per field
+	template<typename... Words>
+	constexpr uint64_t words64(Words... words) {
+		uint64_t h = 0x9e3779b97f4a7c15ull;
+		((h = mix64(h ^ static_cast<uint64_t>(words))), ...);
+		return h;
+	}
+} // namespace hash
+
 template<typename T>
 inline void hash_combine(size_t& seed, const T& v) {
 	std::hash<T> hasher;
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "d/Types.h"
+
+namespace d {
+	// every operator new of the process goes through a counting replacement, what a piece of code allocated is the
+	// difference between two calls. counts all threads, not just the calling one
+	[[nodiscard]] auto get_num_heap_allocations() -> u64;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "d/Types.h"
+
+namespace d {
+	// bump allocator for data that only lives for one recorded frame. blocks are kept across reset, so once the arena
+	// grew to the size of a frame, recording that frame again doesn't touch the heap. memory never moves, spans stay valid until reset
+	struct LinearArena {
+		struct Block {
+			std::unique_ptr<std::byte[]> data;
+			usize size;
+		};
+
+		std::vector<Block> blocks;
+		usize block_index{ 0 };
+		usize offset{ 0 };
+		usize num_used_bytes{ 0 };
+		usize min_block_size{ 64 * 1024 };
+		u32 num_block_allocations{ 0 }; // over the whole lifetime of the arena
+
+		LinearArena() = default;
+		LinearArena(const LinearArena&) = delete;
+		auto operator=(const LinearArena&)->LinearArena & = delete;
+		~LinearArena() = default;
+
+		auto allocate(usize size, usize alignment) -> void*;
+		[[nodiscard]] auto capacity() const -> usize;
+		auto reset() -> void;
+
+		template <typename T>
+			requires std::is_trivially_copyable_v<T>
+		auto allocate_array(usize count) -> std::span<T> {
+			if (count == 0) return {};
+			return std::span<T>(static_cast<T*>(allocate(sizeof(T) * count, alignof(T))), count);
+		}
+
+		template <typename T>
+			requires std::is_trivially_copyable_v<T>
+		auto copy(std::span<const T> values) -> std::span<const T> {
+			auto dst = allocate_array<T>(values.size());
+			std::ranges::copy(values, dst.begin());
+			return dst;
+		}
+	};
+}
@@ -1,8 +1,12 @@
 #pragma once
 
+#ifdef _WIN32
 #define SPDLOG_WCHAR_TO_UTF8_SUPPORT
+#endif
 #include <spdlog/spdlog.h>
+#ifdef _WIN32
 #include "comdef.h"
+#endif
 
 template <typename T, size_t Size>
 char(*count_of_helper(T(&_arr)[Size]))[Size];
@@ -13,12 +17,22 @@ char(*count_of_helper(T(&_arr)[Size]))[Size];
 #define err_log(msg, ...) spdlog::error(msg, ##__VA_ARGS__);
 #define warn_log(msg, ...) spdlog::warn(msg, ##__VA_ARGS__);
 
+#ifdef _WIN32
+#define DX_CHECK_MESSAGE(hr)                             \
+  do {                                                   \
+    _com_error err(hr);                                  \
+    err_log(L"Error {}", err.ErrorMessage());            \
+  } while (0)
+#else
+#define DX_CHECK_MESSAGE(hr) err_log("Error 0x{:08x}", static_cast<unsigned>(hr))
+#endif
+
 #define DX_CHECK(hr)                                     \
   do {                                                   \
-    if (FAILED(hr)) {                                    \
-      _com_error err(hr);                                \
+    const HRESULT dx_check_hr = (hr);                    \
+    if (FAILED(dx_check_hr)) {                           \
       err_log("File '{}', line {}", __FILE__, __LINE__); \
-      err_log(L"Error {}", err.ErrorMessage());          \
+      DX_CHECK_MESSAGE(dx_check_hr);                     \
       assert(0);                                         \
     }                                                    \
   } while (0)                                            \
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+
+#include "d/FlatHashMap.h"
+#include "d/Hash.h"
+#include "d/Types.h"
+
+namespace d {
+	// 32 bit fnv1a of a name. literals are hashed at compile time through _name, dynamic names get interned once,
+	// after that naming and looking up resources only compares integers
+	struct NameId {
+		u32 value{ 0 }; // 0 is no name
+#ifdef _DEBUG
+		std::string_view debug_str; // literal or interned string behind the id, feeds the reverse map
+#endif
+
+		[[nodiscard]] constexpr auto valid() const -> bool { return value != 0; }
+		constexpr auto operator==(const NameId& o) const -> bool { return value == o.value; }
+	};
+
+	// doesn't keep the string around, only for literals and lookups. names that have to outlive their string go through intern_name
+	[[nodiscard]] constexpr auto make_name_id(std::string_view name) -> NameId {
+		NameId id{ .value = hash::fnv1a::hash(name.data(), name.size(), hash::fnv1a::default_offset_basis) };
+#ifdef _DEBUG
+		id.debug_str = name;
+#endif
+		return id;
+	}
+
+	consteval auto operator""_name(const char* str, usize len) -> NameId {
+		return make_name_id(std::string_view(str, len));
+	}
+
+	struct NameIdHash {
+		auto operator()(u32 id) const noexcept -> usize { return hash::mix64(id); }
+	};
+
+	// owns the strings of dynamic names so nothing keyed by them can dangle. debug builds also remember every literal
+	// that named something, so ids can be turned back into strings for logging and collisions get caught
+	struct NameTable {
+		FlatHashMap<u32, std::string_view, NameIdHash> interned; // views into strings
+		std::deque<std::string> strings;
+#ifdef _DEBUG
+		FlatHashMap<u32, std::string_view, NameIdHash> debug_names;
+#endif
+
+		auto intern(std::string_view name) -> NameId;
+		// records the string behind a literal id, does nothing in release builds
+		auto note(const NameId& id) -> void;
+		// empty for literal ids in release builds
+		[[nodiscard]] auto get_string(const NameId& id) const -> std::string_view;
+	};
+}
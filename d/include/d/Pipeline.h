@@ -30,8 +30,30 @@ namespace d {
 		GraphicsPipeline() = default;
 		~GraphicsPipeline() = default;
 
-		[[nodiscard]] auto get_native() const->ID3D12PipelineState*;
+		[[nodiscard]] auto get_native() const -> ID3D12PipelineState* { return pso.Get(); }
 	};
+	struct ComputePipeline;
+
+	struct ComputePipelineStream {
+		D3D12_COMPUTE_PIPELINE_STATE_DESC desc{};
+
+		auto set_compute_shader(const char* label)->ComputePipelineStream&;
+
+		auto build(bool include_root_constants, std::optional<u32> num_constants)->ComputePipeline;
+	};
+
+	struct ComputePipeline {
+		ComPtr<ID3D12PipelineState> pso;
+		ComPtr<ID3D12RootSignature> root_signature;
+		ComPtr<ID3DBlob> rootSignatureBlob;
+		ComPtr<ID3DBlob> errorBlob;
+
+		ComputePipeline() = default;
+		~ComputePipeline() = default;
+
+		[[nodiscard]] auto get_native() const -> ID3D12PipelineState* { return pso.Get(); }
+	};
+
 	// RAY GENERATION | HIT GROUP TABLE ENTRIES ... | MISS GROUP TABLE ENTRIES ... |
 	struct ShaderBindingTable {
 		Resource<Buffer> storage;
@@ -54,7 +76,7 @@ namespace d {
 		RayTracingPipeline() = default;
 		~RayTracingPipeline() = default;
 
-		[[nodiscard]] auto get_native() const->ID3D12StateObject*;
+		[[nodiscard]] auto get_native() const -> ID3D12StateObject* { return pso.Get(); }
 	};
 
 	struct RayTracingPipelineStream {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <span>
 
 #include "d/stdafx.h"
@@ -13,20 +14,67 @@ namespace d {
 		ASYNC_COMPUTE,
 		ASYNC_TRANSFER,
 	};
+	constexpr usize num_queue_types = 3;
+
+	constexpr auto queue_type_to_string(QueueType type) -> const char* {
+		switch (type) {
+		case QueueType::GENERAL: return "general";
+		case QueueType::ASYNC_COMPUTE: return "async compute";
+		case QueueType::ASYNC_TRANSFER: return "async transfer";
+		default: return "unknown";
+		}
+	}
+	// a fence value per queue, indexed by QueueType
+	using QueueFences = std::array<u64, num_queue_types>;
+
+	[[nodiscard]] constexpr auto get_command_list_type(QueueType type) -> D3D12_COMMAND_LIST_TYPE {
+		switch (type) {
+		case QueueType::ASYNC_COMPUTE: return D3D12_COMMAND_LIST_TYPE_COMPUTE;
+		case QueueType::ASYNC_TRANSFER: return D3D12_COMMAND_LIST_TYPE_COPY;
+		default: return D3D12_COMMAND_LIST_TYPE_DIRECT;
+		}
+	}
+
+	[[nodiscard]] constexpr auto get_queue_type(D3D12_COMMAND_LIST_TYPE type) -> QueueType {
+		switch (type) {
+		case D3D12_COMMAND_LIST_TYPE_COMPUTE: return QueueType::ASYNC_COMPUTE;
+		case D3D12_COMMAND_LIST_TYPE_COPY: return QueueType::ASYNC_TRANSFER;
+		default: return QueueType::GENERAL;
+		}
+	}
+
+	// totals over everything a queue got handed since init
+	struct QueueStats {
+		u32 num_submissions{ 0 };
+		u32 num_lists{ 0 };
+		u32 num_signals{ 0 };
+		u32 num_waits{ 0 };
+		CommandListStats commands;
+	};
 
 	struct Queue {
 		ComPtr<ID3D12CommandQueue> handle;
 		ComPtr<ID3D12Fence> idle_fence;
-		HANDLE idle_event;
+		HANDLE idle_event{ nullptr };
 		QueueType type{ QueueType::GENERAL };
-		UINT fence_val{ 0 };
+		u64 fence_val{ 0 }; // last value signaled on idle_fence
+		bool unsignaled_work{ false }; // lists were executed after the last signal, fence_val doesn't cover them
+		QueueStats stats;
+		// created for a headless context: lists are null, fences complete as soon as they are signaled
+		bool null{ false };
 
 		Queue(QueueType type);
 		Queue() = default;
-		~Queue() { CloseHandle(idle_event); }
+		~Queue() { if (idle_event) CloseHandle(idle_event); }
 		auto init(QueueType type) -> void;
 		auto submit_lists(std::initializer_list<CommandList> lists) -> void;
+		// executes without signaling, pair with signal() / wait() to order work across queues
+		auto execute_lists(std::span<const CommandList> lists) -> void;
+		auto signal() -> u64;
+		auto wait(const Queue& other, u64 value) -> void;
+		auto block_until(u64 value, u32 timeout = INFINITE) -> void;
 		auto block_until_idle(u32 timeout = INFINITE) -> void;
+		[[nodiscard]] auto get_completed_value() const -> u64;
 		[[nodiscard]] auto get_command_list()->d::CommandList;
 	};
 }
\ No newline at end of file
@@ -1,16 +1,29 @@
 #pragma once
 
+#include <bit>
 #include <optional>
 #include <variant>
 
 #include "d/Logging.h"
 #include "d/Hash.h"
+#include "d/Name.h"
 #include "d/Types.h"
 #include "d/stdafx.h"
 
 namespace d {
 	using Handle = u32;
 
+	// low bits index a registry slot, high bits are the generation of that slot when the handle was handed out.
+	// releasing a resource bumps the generation, so handles kept around after that can be told apart from the slot's next resource
+	constexpr u32 handle_index_bits = 20;
+	constexpr u32 handle_index_mask = (1u << handle_index_bits) - 1;
+	constexpr u32 max_handle_generation = (1u << (32 - handle_index_bits)) - 1;
+	constexpr u32 invalid_handle_index = handle_index_mask; // end of the registry free list, never a valid slot
+
+	[[nodiscard]] constexpr auto make_handle(u32 index, u32 generation) -> Handle { return generation << handle_index_bits | index; }
+	[[nodiscard]] constexpr auto get_handle_index(Handle handle) -> u32 { return handle & handle_index_mask; }
+	[[nodiscard]] constexpr auto get_handle_generation(Handle handle) -> u32 { return handle >> handle_index_bits; }
+
 	enum class Buffer : Handle {};
 	enum class D1 : Handle {};
 	enum class D2 : Handle {};
@@ -35,6 +48,10 @@ namespace d {
 		AccelStructure,
 	};
 
+	[[nodiscard]] constexpr auto is_texture_type(ResourceType type) -> bool {
+		return type != ResourceType::Buffer && type != ResourceType::AccelStructure;
+	}
+
 	template <typename T>
 	concept BufferResourceC = std::same_as<T, Buffer>;
 	template <typename T>
@@ -101,7 +118,7 @@ namespace d {
 		eReadWriteAtomic,
 		eRenderTarget,
 		eDepthTarget,
-
+		eIndirectArgument,
 	};
 	enum class AccessDomain: u8 {
 		eNone,
@@ -133,6 +150,8 @@ namespace d {
 		ResourceType type{};
 
 		[[nodiscard]] auto desc_index() const->u32;
+		// uncached, only valid until the frame it was created in finished on the gpu
+		[[nodiscard]] auto frame_desc_index() const->u32;
 		[[nodiscard]] auto desc_handle() const->D3D12_CPU_DESCRIPTOR_HANDLE;
 	};
 
@@ -178,6 +197,9 @@ namespace d {
 		Resource() = default;
 		explicit Resource(u32 _handle) : handle(static_cast<Buffer>(_handle)) {}
 
+		// names the buffer for get_named_res, a later resource with the same name takes it over.
+		// ids have to come from _name or intern_name, dynamic strings get interned by the string_view overload
+		Resource<Buffer> operator >> (const NameId& name) const;
 		Resource<Buffer> operator >> (const std::string_view& name) const;
 
 		operator u32() const { return static_cast<Handle>(handle); }
@@ -526,30 +548,31 @@ namespace std {
 	template <>
 	struct hash<d::BufferViewInfo> {
 		std::size_t operator()(const d::BufferViewInfo& x) const noexcept {
-			std::size_t h = 0x0;
-			hash_combine(h, x.first_element, x.num_elements, x.stride, x.buffer_usage,
-				x.resource_handle, x.type);
-			return h;
+			return ::hash::words64(
+				static_cast<uint64_t>(x.resource_handle) | static_cast<uint64_t>(x.first_element) << 32,
+				static_cast<uint64_t>(x.num_elements) | static_cast<uint64_t>(x.stride) << 32,
+				static_cast<uint64_t>(x.buffer_usage) | static_cast<uint64_t>(x.type) << 8);
 		}
 	};
 
 	template <>
 	struct hash<d::TextureViewInfo> {
 		std::size_t operator()(const d::TextureViewInfo& x) const noexcept {
-			std::size_t h = 0x0;
-			hash_combine(h, x.format, x.texture_usage, x.mip_slice,
-				x.first_array_depth_slice, x.num_slices, x.highest_quality_mip,
-				x.num_mips, x.min_mip_clamp, x.resource_handle, x.type);
-			return h;
+			// -0 and 0 compare equal, so they have to hash the same
+			const uint32_t clamp = x.min_mip_clamp == 0.f ? 0u : std::bit_cast<uint32_t>(x.min_mip_clamp);
+			return ::hash::words64(
+				static_cast<uint64_t>(x.resource_handle) | static_cast<uint64_t>(x.format) << 32,
+				static_cast<uint64_t>(x.first_array_depth_slice) | static_cast<uint64_t>(x.num_slices) << 32,
+				static_cast<uint64_t>(x.mip_slice) | static_cast<uint64_t>(x.num_mips) << 32,
+				static_cast<uint64_t>(x.highest_quality_mip) | static_cast<uint64_t>(clamp) << 32,
+				static_cast<uint64_t>(x.texture_usage) | static_cast<uint64_t>(x.type) << 8);
 		}
 	};
 
 	template <>
 	struct hash<d::AccelerationStructureViewInfo> {
 		std::size_t operator()(const d::AccelerationStructureViewInfo& x) const noexcept {
-			std::size_t h = 0x0;
-			hash_combine(h, x.handle, x.native.Location);
-			return h;
+			return ::hash::words64(x.handle, x.native.Location);
 		}
 	};
 
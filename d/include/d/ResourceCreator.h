@@ -37,6 +37,22 @@ namespace d {
 		TextureExtent extent;
 		//    MemoryUsage usage{MemoryUsage::GPU};
 		TextureUsage usage;
+		u32 num_mips{ 1 }; // 0 is a full chain down to 1x1
 	};
 
+	// where one subresource sits in a buffer it gets copied from or to
+	struct SubresourceFootprint {
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout; // offset relative to the first subresource
+		u32 num_rows{ 0 }; // per depth slice, block rows for compressed formats
+		u64 row_size{ 0 }; // texel bytes of a row, the rest of the row pitch is padding
+	};
+
+	[[nodiscard]] auto get_resource_desc(const BufferCreateInfo& create_info) -> D3D12_RESOURCE_DESC;
+	[[nodiscard]] auto get_resource_desc(const TextureCreateInfo& texture_info) -> D3D12_RESOURCE_DESC;
+	// what GetResourceAllocationInfo would roughly say without a device: tightly packed texels, 64KB aligned
+	[[nodiscard]] auto get_headless_allocation_info(const D3D12_RESOURCE_DESC& desc) -> D3D12_RESOURCE_ALLOCATION_INFO;
+	// GetCopyableFootprints of every subresource in subresource order, mips of the first slice first. headless contexts
+	// compute the same layout by hand: rows padded to the pitch alignment, subresources at the placement alignment
+	[[nodiscard]] auto get_copyable_footprints(const D3D12_RESOURCE_DESC& desc) -> std::vector<SubresourceFootprint>;
+
 }
@@ -2,7 +2,12 @@
 
 #include <DirectXTex.h>
 
+#include <optional>
+#include <thread>
+
 #include "d/CommandList.h"
+#include "d/Compression.h"
+#include "d/Future.h"
 #include "d/Queue.h"
 #include "d/Resource.h"
 namespace d {
@@ -15,18 +20,48 @@ namespace d {
 		DirectX::TexMetadata metadata;
 		DirectX::ScratchImage scratch;
 	};
+	// a payload written by compress_payload, decompressed straight into the upload ring when the stager gets flushed
+	struct CompressedStageEntry {
+		ByteSpan payload;
+		Handle dst;
+		std::optional<DirectX::TexMetadata> texture; // decompresses to every subresource laid out like pack_texture_upload
+	};
+	// buffer data is packed this far apart in the upload ring
+	constexpr u64 buffer_upload_alignment = 16;
+
+	// collects uploads and copies them from the context's upload ring on the copy queue
 	struct Stager {
 		std::vector<BufferStageEntry> buffer_entries;
 		std::vector<TextureStageEntry> texture_entries;
-		Queue async_transfer;
-		CommandList list;
-		u32 max_stage_size;
+		std::vector<CompressedStageEntry> compressed_entries;
+		std::vector<ResourceFuture> futures; // of the last flush
+		// at most this many threads of Context::workers decompress, the flushing one included
+		u32 max_decompression_threads{ std::thread::hardware_concurrency() };
+		std::vector<std::vector<std::byte>> bounce_buffers; // per decompressing thread, as large as the largest chunk
 
-		Stager();
+		Stager() = default;
 		~Stager() = default;
 
-		//Resource<D2> stage_texture_from_file(const char* path);
+		// dds, hdr, tga or anything wic reads. images without mips get a full chain unless generate_mips is off
+		auto stage_texture_from_file(const char* path, bool generate_mips = true) -> Resource<D2>;
+		// every mip and array slice of image, dst has to match its format, extent and counts
+		auto stage_texture(Resource<D2> dst, DirectX::ScratchImage&& image) -> void;
+		// data has to stay alive until the stager got flushed
 		auto stage_buffer(Resource<Buffer> dst, ByteSpan data) -> void;
+		// payloads have to stay alive until the stager got flushed, and decompressed fit into the upload ring
+		auto stage_compressed_buffer(Resource<Buffer> dst, ByteSpan payload) -> void;
+		// payload is the output of pack_texture_upload for a texture with metadata, compressed
+		auto stage_compressed_texture(Resource<D2> dst, const DirectX::TexMetadata& metadata, ByteSpan payload) -> void;
+		// every subresource of image laid out the way the upload ring copies it to a texture, what asset tools compress
+		[[nodiscard]] static auto pack_texture_upload(const DirectX::ScratchImage& image) -> std::vector<std::byte>;
+		// packs everything staged into the upload ring and submits the copies with one list and one fence, without waiting.
+		// compressed payloads get decompressed into the ring by up to max_decompression_threads workers first.
+		// returns a future per staged resource, buffers, textures then compressed payloads each in staging order, valid
+		// until the next flush. only submits early and waits when the ring runs full, buffers larger than the ring go over
+		// in ring sized pieces. payloads that don't parse, match their texture, fit the ring or decompress, and textures
+		// with a subresource larger than the ring, are skipped and get a failed future
+		auto flush() -> std::span<const ResourceFuture>;
+		// flush and wait for the copies
 		auto stage_block_until_over() -> void;
 	};
 
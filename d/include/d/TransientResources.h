@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <span>
+#include <unordered_map>
+
+#include <d/D3D12MemAlloc.h>
+
+#include "d/Resource.h"
+#include "d/ResourceCreator.h"
+#include "d/stdafx.h"
+
+namespace d {
+	// resource heap tier 1 can't mix buffers, render/depth targets and other textures in one heap
+	enum class TransientHeapKind : u8 {
+		eBuffer,
+		eTargetTexture,
+		eTexture,
+	};
+	constexpr usize num_transient_heap_kinds = 3;
+
+	// first and last execution step a transient is touched in
+	struct TransientLifetime {
+		u32 first_step;
+		u32 last_step;
+
+		[[nodiscard]] auto overlaps(const TransientLifetime& o) const -> bool { return first_step <= o.last_step && o.first_step <= last_step; }
+	};
+
+	struct TransientResource {
+		Handle handle;
+		D3D12_RESOURCE_DESC desc;
+		TransientHeapKind heap_kind;
+		u64 size;
+		u64 alignment;
+
+		// placement inside the heap of its kind, only valid while placed
+		std::optional<u64> offset;
+		std::optional<TransientLifetime> lifetime;
+		// transients that used the same memory earlier in the graph, the first use has to wait on them
+		std::vector<Handle> aliases;
+	};
+
+	struct TransientStats {
+		u32 num_placed{ 0 };
+		u64 dedicated_bytes{ 0 }; // what committed allocations of all placed transients would take
+		u64 heap_bytes{ 0 };      // what the placed heaps need for the current plan
+		u32 num_replans{ 0 };     // times placing had to recreate native resources
+	};
+
+	// graph owned resources that only live between their first and last execution step, packed first fit
+	// into one shared placed heap per kind so transients with disjoint lifetimes alias the same memory
+	struct TransientResources {
+		std::vector<TransientResource> resources;
+		std::unordered_map<Handle, u32> resource_indices;
+		std::array<ComPtr<D3D12MA::Allocation>, num_transient_heap_kinds> heaps;
+		std::array<u64, num_transient_heap_kinds> heap_sizes{};
+		TransientStats stats;
+
+		TransientResources() = default;
+		TransientResources(const TransientResources&) = delete;
+		auto operator=(const TransientResources&)->TransientResources & = delete;
+		~TransientResources();
+
+		// handles are valid right away, native resources only exist once a graph using them got compiled
+		auto create_buffer(const BufferCreateInfo& info) -> Resource<Buffer>;
+		auto create_texture_2d(const TextureCreateInfo& info) -> Resource<D2>;
+
+		[[nodiscard]] auto find(Handle handle) const -> const TransientResource*;
+		// lifetimes are indexed like resources, returns true if any native resource got recreated
+		auto place(std::span<const std::optional<TransientLifetime>> lifetimes) -> bool;
+
+		auto add(const D3D12_RESOURCE_DESC& desc, TransientHeapKind heap_kind, ResourceType type) -> Handle;
+	};
+}
@@ -2,6 +2,8 @@
 #include <cstdint>
 #include <cstddef>
 #include <span>
+#include <type_traits>
+#include <vector>
 
 typedef std::uint8_t u8;
 typedef std::uint16_t u16;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "d/Types.h"
+
+namespace d {
+	// threads started once and woken for every batch of work, so recording a frame or flushing a stager doesn't start any.
+	// the calling thread takes part in every batch as thread 0, run returns once all threads of the batch are done
+	struct WorkerPool {
+		std::vector<std::thread> threads;
+		// batch counter in the high half, threads of the batch (the calling one included) in the low half. workers wait on
+		// it changing, both halves are read at once so a worker never mixes up two batches
+		std::atomic<u64> batch_state{ 0 };
+		std::atomic<u32> num_running{ 0 }; // workers of the current batch that aren't done yet
+		std::atomic<bool> stop{ false };
+		// written before batch_state is bumped and only read by workers of that batch
+		void* job_data{ nullptr };
+		void (*job_fn)(void*, u32){ nullptr };
+
+		explicit WorkerPool(u32 num_workers);
+		WorkerPool(const WorkerPool&) = delete;
+		auto operator=(const WorkerPool&)->WorkerPool & = delete;
+		~WorkerPool();
+
+		// threads besides the calling one
+		[[nodiscard]] auto num_workers() const -> u32 { return static_cast<u32>(threads.size()); }
+		// job(thread_index) on min(num_threads, num_workers() + 1) threads. job is only referenced, nothing is allocated.
+		// one batch at a time, a job can't run another batch on the same pool
+		template <typename F>
+		auto run(u32 num_threads, F&& job) -> void {
+			run_erased(num_threads, const_cast<void*>(static_cast<const void*>(&job)), [](void* data, u32 thread_index) {
+				(*static_cast<std::remove_reference_t<F>*>(data))(thread_index);
+			});
+		}
+
+		auto run_erased(u32 num_threads, void* data, void (*fn)(void*, u32)) -> void;
+		auto work(u32 thread_index) -> void;
+	};
+}
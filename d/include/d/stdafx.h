@@ -4,6 +4,7 @@
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
 #endif
 
+#ifdef _WIN32
 #define NOMINMAX
 #include <Windows.h>
 
@@ -14,6 +15,16 @@
 #include <string>
 #include <wrl.h>
 #include <shellapi.h>
+#else
+// the headless core builds against the shims in d/compat, see CMakeLists.txt
+#include <windows.h>
+
+#include <directx/d3dx12.h>
+#include <dxgi1_6.h>
+
+#include <string>
+#include <wrl.h>
+#endif
 
 namespace d {
 	using namespace Microsoft::WRL;
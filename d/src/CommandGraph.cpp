@@ -1,13 +1,226 @@
 #include "d/CommandGraph.h"
 #include "d/Context.h"
+#include "d/HeapAllocations.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <fstream>
-#include <unordered_set>
+#include <iomanip>
 #include <ranges>
-#include <stack>
+#include <thread>
+#include <unordered_map>
 
 namespace d {
 
+	namespace {
+		auto is_read_only_layout(D3D12_BARRIER_LAYOUT layout) -> bool {
+			return layout == D3D12_BARRIER_LAYOUT_SHADER_RESOURCE || layout == D3D12_BARRIER_LAYOUT_COPY_SOURCE ||
+				layout == D3D12_BARRIER_LAYOUT_GENERIC_READ;
+		}
+
+		// two commands in the same step can only disagree on the layout of a texture they both read
+		auto merge_layouts(D3D12_BARRIER_LAYOUT l0, D3D12_BARRIER_LAYOUT l1) -> D3D12_BARRIER_LAYOUT {
+			if (l0 == l1) return l0;
+			assert_log(is_read_only_layout(l0) && is_read_only_layout(l1), "conflicting texture layouts within one execution step");
+			return D3D12_BARRIER_LAYOUT_GENERIC_READ;
+		}
+
+		// without a native resource (headless) targets are assumed to cover the swap chain
+		auto get_target_extent(Handle target) -> TextureExtent {
+			auto* native = get_native_res(target);
+			if (native == nullptr) return TextureExtent::full_swap_chain();
+			const auto desc = native->GetDesc();
+			return TextureExtent{ .width = static_cast<u32>(desc.Width), .height = desc.Height };
+		}
+
+		struct Accesses {
+			std::span<const Handle> reads;
+			std::span<const Handle> writes;
+			std::span<const ResourceMetaData> meta_data; // in order of reads + writes
+		};
+
+		// splits shader resources into reads and writes that sit next to each other in the arena, extra reads go last
+		auto split_accesses(LinearArena& arena, std::initializer_list<std::pair<Handle, ResourceMetaData>> resources,
+			std::optional<std::pair<Handle, ResourceMetaData>> extra_read = std::nullopt) -> Accesses {
+			const auto is_read = [](const ResourceMetaData& metadata) {
+				return metadata.type == AccessType::eRead || metadata.type == AccessType::eIndirectArgument;
+			};
+			const auto is_write = [](const ResourceMetaData& metadata) {
+				return metadata.type == AccessType::eReadWriteAtomic || metadata.type == AccessType::eRenderTarget || metadata.type == AccessType::eDepthTarget;
+			};
+			usize num_reads = extra_read.has_value() ? 1 : 0;
+			usize num_writes = 0;
+			for (const auto& metadata : resources | std::views::values) {
+				num_reads += is_read(metadata) ? 1 : 0;
+				num_writes += is_write(metadata) ? 1 : 0;
+			}
+
+			const auto handles = arena.allocate_array<Handle>(num_reads + num_writes);
+			const auto meta_data = arena.allocate_array<ResourceMetaData>(num_reads + num_writes);
+			usize r = 0;
+			usize w = num_reads;
+			for (const auto& [handle, metadata] : resources) {
+				if (is_read(metadata)) handles[r] = handle, meta_data[r++] = metadata;
+				else if (is_write(metadata)) handles[w] = handle, meta_data[w++] = metadata;
+			}
+			if (extra_read.has_value()) handles[r] = extra_read->first, meta_data[r] = extra_read->second;
+			return Accesses{ .reads = handles.first(num_reads), .writes = handles.subspan(num_reads), .meta_data = meta_data };
+		}
+
+		// start of every command and step when replaying the submissions in order, a queue runs one command at a time
+		struct Timeline {
+			std::vector<double> command_start;
+			std::vector<std::vector<double>> step_start; // per submission and step
+			std::vector<std::vector<double>> step_end;
+			std::vector<double> submission_start;
+			std::array<std::vector<double>, num_queue_types> signal_time;
+			double end{ 0. };
+		};
+
+		auto simulate(const CommandGraph::Compiled& compiled, std::span<const double> costs) -> Timeline {
+			Timeline timeline;
+			timeline.command_start.assign(costs.size(), 0.);
+			std::array<double, num_queue_types> queue_time{};
+			for (const auto& submission : compiled.submissions) {
+				const auto q = static_cast<usize>(submission.queue);
+				double t = queue_time[q];
+				for (const auto& [src, signal] : submission.waits) t = std::max(t, timeline.signal_time[static_cast<usize>(src)][signal]);
+				timeline.submission_start.emplace_back(t);
+				auto& step_start = timeline.step_start.emplace_back();
+				auto& step_end = timeline.step_end.emplace_back();
+				for (const auto& step : submission.steps) {
+					step_start.emplace_back(t);
+					for (const auto v : step.commands) {
+						timeline.command_start[v] = t;
+						t += costs[v];
+					}
+					step_end.emplace_back(t);
+				}
+				if (submission.signal.has_value()) {
+					auto& signals = timeline.signal_time[q];
+					signals.resize(std::max<usize>(signals.size(), *submission.signal + 1));
+					signals[*submission.signal] = t;
+				}
+				queue_time[q] = t;
+			}
+			timeline.end = std::ranges::max(queue_time);
+			return timeline;
+		}
+
+		auto json_escape(std::string_view text) -> std::string {
+			std::string escaped;
+			escaped.reserve(text.size());
+			for (const char ch : text) {
+				if (ch == '"' || ch == '\\') escaped += '\\';
+				escaped += static_cast<unsigned char>(ch) < 0x20 ? ' ' : ch;
+			}
+			return escaped;
+		}
+
+		template <usize N>
+		auto flags_to_string(u32 value, const std::array<std::pair<u32, const char*>, N>& names, const char* none) -> std::string {
+			if (value == 0) return none;
+			std::string text;
+			for (const auto& [flag, name] : names) {
+				if ((value & flag) != flag) continue;
+				if (!text.empty()) text += '|';
+				text += name;
+			}
+			return text;
+		}
+
+		auto sync_to_string(D3D12_BARRIER_SYNC sync) -> std::string {
+			static constexpr std::array<std::pair<u32, const char*>, 20> names{ {
+				{ D3D12_BARRIER_SYNC_ALL, "ALL" }, { D3D12_BARRIER_SYNC_DRAW, "DRAW" }, { D3D12_BARRIER_SYNC_INPUT_ASSEMBLER, "INPUT_ASSEMBLER" },
+				{ D3D12_BARRIER_SYNC_VERTEX_SHADING, "VERTEX_SHADING" }, { D3D12_BARRIER_SYNC_PIXEL_SHADING, "PIXEL_SHADING" },
+				{ D3D12_BARRIER_SYNC_DEPTH_STENCIL, "DEPTH_STENCIL" }, { D3D12_BARRIER_SYNC_RENDER_TARGET, "RENDER_TARGET" },
+				{ D3D12_BARRIER_SYNC_COMPUTE_SHADING, "COMPUTE_SHADING" }, { D3D12_BARRIER_SYNC_RAYTRACING, "RAYTRACING" },
+				{ D3D12_BARRIER_SYNC_COPY, "COPY" }, { D3D12_BARRIER_SYNC_RESOLVE, "RESOLVE" }, { D3D12_BARRIER_SYNC_EXECUTE_INDIRECT, "EXECUTE_INDIRECT" },
+				{ D3D12_BARRIER_SYNC_ALL_SHADING, "ALL_SHADING" }, { D3D12_BARRIER_SYNC_NON_PIXEL_SHADING, "NON_PIXEL_SHADING" },
+				{ D3D12_BARRIER_SYNC_EMIT_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO, "EMIT_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO" },
+				{ D3D12_BARRIER_SYNC_VIDEO_DECODE, "VIDEO_DECODE" }, { D3D12_BARRIER_SYNC_VIDEO_PROCESS, "VIDEO_PROCESS" },
+				{ D3D12_BARRIER_SYNC_BUILD_RAYTRACING_ACCELERATION_STRUCTURE, "BUILD_RAYTRACING_ACCELERATION_STRUCTURE" },
+				{ D3D12_BARRIER_SYNC_COPY_RAYTRACING_ACCELERATION_STRUCTURE, "COPY_RAYTRACING_ACCELERATION_STRUCTURE" },
+				{ D3D12_BARRIER_SYNC_SPLIT, "SPLIT" },
+			} };
+			return flags_to_string(static_cast<u32>(sync), names, "NONE");
+		}
+
+		auto access_to_string(D3D12_BARRIER_ACCESS access) -> std::string {
+			static constexpr std::array<std::pair<u32, const char*>, 18> names{ {
+				{ D3D12_BARRIER_ACCESS_NO_ACCESS, "NO_ACCESS" }, { D3D12_BARRIER_ACCESS_VERTEX_BUFFER, "VERTEX_BUFFER" },
+				{ D3D12_BARRIER_ACCESS_CONSTANT_BUFFER, "CONSTANT_BUFFER" }, { D3D12_BARRIER_ACCESS_INDEX_BUFFER, "INDEX_BUFFER" },
+				{ D3D12_BARRIER_ACCESS_RENDER_TARGET, "RENDER_TARGET" }, { D3D12_BARRIER_ACCESS_UNORDERED_ACCESS, "UNORDERED_ACCESS" },
+				{ D3D12_BARRIER_ACCESS_DEPTH_STENCIL_WRITE, "DEPTH_STENCIL_WRITE" }, { D3D12_BARRIER_ACCESS_DEPTH_STENCIL_READ, "DEPTH_STENCIL_READ" },
+				{ D3D12_BARRIER_ACCESS_SHADER_RESOURCE, "SHADER_RESOURCE" }, { D3D12_BARRIER_ACCESS_STREAM_OUTPUT, "STREAM_OUTPUT" },
+				{ D3D12_BARRIER_ACCESS_INDIRECT_ARGUMENT, "INDIRECT_ARGUMENT" }, { D3D12_BARRIER_ACCESS_COPY_DEST, "COPY_DEST" },
+				{ D3D12_BARRIER_ACCESS_COPY_SOURCE, "COPY_SOURCE" }, { D3D12_BARRIER_ACCESS_RESOLVE_DEST, "RESOLVE_DEST" },
+				{ D3D12_BARRIER_ACCESS_RESOLVE_SOURCE, "RESOLVE_SOURCE" },
+				{ D3D12_BARRIER_ACCESS_RAYTRACING_ACCELERATION_STRUCTURE_READ, "RAYTRACING_ACCELERATION_STRUCTURE_READ" },
+				{ D3D12_BARRIER_ACCESS_RAYTRACING_ACCELERATION_STRUCTURE_WRITE, "RAYTRACING_ACCELERATION_STRUCTURE_WRITE" },
+				{ D3D12_BARRIER_ACCESS_SHADING_RATE_SOURCE, "SHADING_RATE_SOURCE" },
+			} };
+			return flags_to_string(static_cast<u32>(access), names, "COMMON");
+		}
+
+		auto layout_to_string(D3D12_BARRIER_LAYOUT layout) -> std::string {
+			switch (layout) {
+			case D3D12_BARRIER_LAYOUT_UNDEFINED: return "UNDEFINED";
+			case D3D12_BARRIER_LAYOUT_COMMON: return "COMMON"; // same as PRESENT
+			case D3D12_BARRIER_LAYOUT_GENERIC_READ: return "GENERIC_READ";
+			case D3D12_BARRIER_LAYOUT_RENDER_TARGET: return "RENDER_TARGET";
+			case D3D12_BARRIER_LAYOUT_UNORDERED_ACCESS: return "UNORDERED_ACCESS";
+			case D3D12_BARRIER_LAYOUT_DEPTH_STENCIL_WRITE: return "DEPTH_STENCIL_WRITE";
+			case D3D12_BARRIER_LAYOUT_DEPTH_STENCIL_READ: return "DEPTH_STENCIL_READ";
+			case D3D12_BARRIER_LAYOUT_SHADER_RESOURCE: return "SHADER_RESOURCE";
+			case D3D12_BARRIER_LAYOUT_COPY_SOURCE: return "COPY_SOURCE";
+			case D3D12_BARRIER_LAYOUT_COPY_DEST: return "COPY_DEST";
+			default: return std::to_string(static_cast<u32>(layout));
+			}
+		}
+
+		auto command_type_to_string(CommandType type) -> const char* {
+			switch (type) {
+			case CommandType::eDraw: return "draw";
+			case CommandType::eCopyBuffer: return "copy_buffer";
+			case CommandType::eDispatch: return "dispatch";
+			case CommandType::eDispatchIndirect: return "dispatch_indirect";
+			case CommandType::eTraceRays: return "trace_rays";
+			case CommandType::eCopyTexture: return "copy_texture";
+			default: return "unknown";
+			}
+		}
+
+		// texture layouts of draws, dispatches and ray dispatches
+		template <typename T>
+		auto append_shader_layouts(const T& info, std::vector<std::pair<Handle, D3D12_BARRIER_LAYOUT>>& layout_requirements) -> void {
+			usize i = 0;
+			for (const auto& read : info.reads) {
+				if (is_texture_type(get_res_state(read).type) && info.get_meta_data(i, false).type == AccessType::eRead) {
+					layout_requirements.emplace_back(read, D3D12_BARRIER_LAYOUT_SHADER_RESOURCE);
+				}
+				++i;
+			}
+			i = 0;
+			for (const auto& write : info.writes) {
+				const auto& meta_data = info.get_meta_data(i, true);
+				if (is_texture_type(get_res_state(write).type)) {
+					if (meta_data.type == AccessType::eRenderTarget) {
+						layout_requirements.emplace_back(write, D3D12_BARRIER_LAYOUT_RENDER_TARGET);
+					}
+					else if (meta_data.type == AccessType::eDepthTarget) {
+						layout_requirements.emplace_back(write, D3D12_BARRIER_LAYOUT_DEPTH_STENCIL_WRITE);
+					}
+					else if (meta_data.type == AccessType::eReadWriteAtomic) {
+						layout_requirements.emplace_back(write, D3D12_BARRIER_LAYOUT_UNORDERED_ACCESS);
+					}
+				}
+				++i;
+			}
+		}
+	}
+
 	[[nodiscard]] inline auto nDrawInfo::get_barrier_info(usize index, bool write) const -> std::pair<D3D12_BARRIER_SYNC, D3D12_BARRIER_ACCESS> {
 		const auto& _meta_data = get_meta_data(index, write);
 		D3D12_BARRIER_SYNC sync;
@@ -19,7 +232,7 @@ namespace d {
 			sync = D3D12_BARRIER_SYNC_PIXEL_SHADING;
 			break;
 		default:
-			sync = D3D12_BARRIER_SYNC_NONE;
+			sync = D3D12_BARRIER_SYNC_DRAW;
 			break;
 		}
 		D3D12_BARRIER_ACCESS access;
@@ -38,6 +251,10 @@ namespace d {
 			access = D3D12_BARRIER_ACCESS_DEPTH_STENCIL_WRITE;
 			sync = D3D12_BARRIER_SYNC_DEPTH_STENCIL;
 			break;
+		case AccessType::eIndirectArgument:
+			access = D3D12_BARRIER_ACCESS_INDIRECT_ARGUMENT;
+			sync = D3D12_BARRIER_SYNC_EXECUTE_INDIRECT;
+			break;
 		default:
 			access = D3D12_BARRIER_ACCESS_NO_ACCESS;
 			break;
@@ -45,69 +262,111 @@ namespace d {
 		return std::make_pair(sync, access);
 	}
 
-	auto nDrawInfo::do_command(CommandList& list) const -> void {
-		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> render_targets;
-		std::optional<D3D12_CPU_DESCRIPTOR_HANDLE> depth_target;
+	auto nDrawInfo::resolve_targets(LinearArena& arena) -> void {
+		depth_target_handle.reset();
+		viewport.reset();
+		const auto num_render_targets = std::ranges::count_if(meta_data, [](const ResourceMetaData& metadata) { return metadata.type == AccessType::eRenderTarget; });
+		const auto handles = arena.allocate_array<D3D12_CPU_DESCRIPTOR_HANDLE>(static_cast<usize>(num_render_targets));
+		render_target_handles = handles;
 		usize i = 0;
+		usize rt = 0;
 		for (const auto& output : writes) {
 			const auto type = get_meta_data(i, true).type;
 			if (type == AccessType::eRenderTarget) {
-				render_targets.push_back(Resource<D2>(output)
+				handles[rt++] = Resource<D2>(output)
 					.rtv_view({})
-					.desc_handle());
+					.desc_handle();
+				if (!viewport) viewport = get_target_extent(output);
 			}
 			else if (type == AccessType::eDepthTarget) {
-				depth_target = Resource<D2>(output).dsv_view({}).desc_handle();
+				depth_target_handle = Resource<D2>(output).dsv_view({}).desc_handle();
+				if (!viewport) viewport = get_target_extent(output);
 			}
 			++i;
 		}
-		list.handle->OMSetRenderTargets(static_cast<UINT>(render_targets.size()), render_targets.data(), false, depth_target.has_value() ? &depth_target.value() : nullptr);
+	}
 
-		list.handle->SetPipelineState(pl.get_native());
-		list.handle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		list.handle->SetDescriptorHeaps(1, c.resource_registry.storage.bindable_desc_heap.heap.GetAddressOf());
-		list.handle->SetGraphicsRootSignature(pl.root_signature.Get());
+	auto nDrawInfo::do_command(CommandList& list) const -> void {
+		// the graph records into its own lists, so every draw covers its targets itself
+		if (viewport) list.set_viewport(viewport->width, viewport->height);
+		list.set_render_targets(render_target_handles, depth_target_handle.has_value() ? &depth_target_handle.value() : nullptr)
+			.set_pipeline(*pl);
 
-		i = 0;
+		usize i = 0;
 		for (const auto& cmd : commands) {
-			list.handle->SetGraphicsRoot32BitConstants(0, static_cast<UINT>(push_constants[i].size() / 4), push_constants[i].data(), 0);
-			list.handle->IASetIndexBuffer(&cmd.ibo_view);
-			list.handle->DrawIndexedInstanced(cmd.index_count_per_instance, cmd.instance_count, cmd.start_index_location, 0, 0);
+			list.set_graphics_push_constants(push_constants[i])
+				.draw_indexed(cmd.ibo_view, cmd.index_count_per_instance, cmd.instance_count, cmd.start_index_location);
 			++i;
 		}
 	}
 
-	auto CommandRecorder::draw(const DrawInfo& info) -> CommandRecorder {
-		std::vector<Handle> reads;
-		std::vector<Handle> writes;
-		std::vector<ResourceMetaData> meta_data;
-		{
-			std::vector<ResourceMetaData> read_meta;
-			std::vector<ResourceMetaData> write_meta;
-			for (const auto& [handle, metadata] : info.resources) {
-				if (metadata.type == AccessType::eRead) reads.emplace_back(handle), read_meta.emplace_back(metadata);
-				else if (metadata.type == AccessType::eReadWriteAtomic || metadata.type == AccessType::eRenderTarget || metadata.type == AccessType::eDepthTarget) {
-					writes.emplace_back(handle), write_meta.emplace_back(metadata);
-				}
+	[[nodiscard]] inline auto nDispatchInfo::get_barrier_info(usize index, bool write) const -> std::pair<D3D12_BARRIER_SYNC, D3D12_BARRIER_ACCESS> {
+		switch (get_meta_data(index, write).type) {
+		case AccessType::eRead:
+			return std::make_pair(D3D12_BARRIER_SYNC_COMPUTE_SHADING, D3D12_BARRIER_ACCESS_SHADER_RESOURCE);
+		case AccessType::eReadWriteAtomic:
+			return std::make_pair(D3D12_BARRIER_SYNC_COMPUTE_SHADING, D3D12_BARRIER_ACCESS_UNORDERED_ACCESS);
+		case AccessType::eIndirectArgument:
+			return std::make_pair(D3D12_BARRIER_SYNC_EXECUTE_INDIRECT, D3D12_BARRIER_ACCESS_INDIRECT_ARGUMENT);
+		default:
+			return std::make_pair(D3D12_BARRIER_SYNC_COMPUTE_SHADING, D3D12_BARRIER_ACCESS_NO_ACCESS);
+		}
+	}
+
+	auto nDispatchInfo::do_command(CommandList& list) const -> void {
+		list.set_pipeline(*pl)
+			.set_compute_push_constants(push_constants);
+		if (indirect_args.has_value()) {
+			const auto& [args, offset] = *indirect_args;
+			list.dispatch_indirect(args, offset);
+		}
+		else {
+			list.dispatch(group_count[0], group_count[1], group_count[2]);
+		}
+	}
+
+	[[nodiscard]] inline auto nTraceRaysInfo::get_barrier_info(usize index, bool write) const -> std::pair<D3D12_BARRIER_SYNC, D3D12_BARRIER_ACCESS> {
+		switch (get_meta_data(index, write).type) {
+		case AccessType::eRead:
+			// acceleration structures are read by the traversal, not as shader resources
+			if (!write && get_res_state(reads[index]).type == ResourceType::AccelStructure) {
+				return std::make_pair(D3D12_BARRIER_SYNC_RAYTRACING, D3D12_BARRIER_ACCESS_RAYTRACING_ACCELERATION_STRUCTURE_READ);
 			}
-			meta_data.insert(meta_data.end(), read_meta.begin(), read_meta.end());
-			meta_data.insert(meta_data.end(), write_meta.begin(), write_meta.end());
+			return std::make_pair(D3D12_BARRIER_SYNC_RAYTRACING, D3D12_BARRIER_ACCESS_SHADER_RESOURCE);
+		case AccessType::eReadWriteAtomic:
+			return std::make_pair(D3D12_BARRIER_SYNC_RAYTRACING, D3D12_BARRIER_ACCESS_UNORDERED_ACCESS);
+		default:
+			return std::make_pair(D3D12_BARRIER_SYNC_RAYTRACING, D3D12_BARRIER_ACCESS_NO_ACCESS);
 		}
+	}
+
+	auto nTraceRaysInfo::do_command(CommandList& list) const -> void {
+		list.set_pipeline(*pl)
+			.set_compute_push_constants(push_constants)
+			.dispatch_rays(*pl, extent);
+	}
+
+	auto CommandRecorder::draw(const DrawInfo& info) -> CommandRecorder& {
+		assert_log(info.pl != nullptr, "draw needs a graphics pipeline");
+		const auto accesses = split_accesses(arena, info.resources);
+		auto push_constants = arena.allocate_array<std::span<const std::byte>>(info.push_constants.size());
+		std::ranges::transform(info.push_constants, push_constants.begin(), [&](std::span<const std::byte> bytes) { return arena.copy(bytes); });
 
 		u32 index = static_cast<u32>(draw_infos.size());
 		draw_infos.emplace_back(nDrawInfo{
-			.reads = reads,
-			.writes = writes,
-			.meta_data = meta_data,
-			.push_constants = info.push_constants,
-			.commands = info.draw_cmds,
+			.reads = accesses.reads,
+			.writes = accesses.writes,
+			.meta_data = accesses.meta_data,
+			.push_constants = push_constants,
+			.commands = arena.copy(std::span(info.draw_cmds.begin(), info.draw_cmds.size())),
 			.debug_name = info.debug_name,
+			.pl = info.pl,
 			});
-		command_stream.emplace_back(CommandType::eDraw, index, reads, writes);
+		command_stream.emplace_back(CommandType::eDraw, index, accesses.reads, accesses.writes);
 		return *this;
 	}
 
-	auto CommandRecorder::copy_buffer(const CopyBufferInfo& info)->CommandRecorder {
+	auto CommandRecorder::copy_buffer(const CopyBufferInfo& info)->CommandRecorder& {
 		auto copy_info = nCopyBufferInfo{
 			.dst = info.dst,
 			.src = info.src,
@@ -117,24 +376,159 @@ namespace d {
 		};
 		u32 index = static_cast<u32>(copy_buffer_infos.size());
 		copy_buffer_infos.emplace_back(copy_info);
-		command_stream.emplace_back(CommandType::eDraw, index, std::vector <Handle>{ info.src }, std::vector <Handle>{ info.dst });
+		const auto handles = arena.allocate_array<Handle>(2);
+		handles[0] = info.src;
+		handles[1] = info.dst;
+		command_stream.emplace_back(CommandType::eCopyBuffer, index, handles.first(1), handles.last(1));
 		return *this;
 	}
 
-	inline auto CommandRecorder::get_draw_info(const CommandInfo& info) const -> nDrawInfo {
+	auto CommandRecorder::dispatch(const DispatchInfo& info) -> CommandRecorder& {
+		assert_log(info.pl != nullptr, "dispatch needs a compute pipeline");
+		const auto accesses = split_accesses(arena, info.resources);
+
+		u32 index = static_cast<u32>(dispatch_infos.size());
+		dispatch_infos.emplace_back(nDispatchInfo{
+			.reads = accesses.reads,
+			.writes = accesses.writes,
+			.meta_data = accesses.meta_data,
+			.push_constants = arena.copy(info.push_constants),
+			.pl = info.pl,
+			.group_count = { info.group_count_x, info.group_count_y, info.group_count_z },
+			.debug_name = info.debug_name,
+			});
+		command_stream.emplace_back(CommandType::eDispatch, index, accesses.reads, accesses.writes);
+		return *this;
+	}
+
+	auto CommandRecorder::dispatch_indirect(const DispatchIndirectInfo& info) -> CommandRecorder& {
+		assert_log(info.pl != nullptr, "dispatch needs a compute pipeline");
+		// the argument buffer is the last read, so a producing dispatch gets ordered before this one
+		const auto accesses = split_accesses(arena, info.resources, std::make_pair(static_cast<Handle>(info.args), ResourceMetaData{ .type = AccessType::eIndirectArgument }));
+
+		u32 index = static_cast<u32>(dispatch_infos.size());
+		dispatch_infos.emplace_back(nDispatchInfo{
+			.reads = accesses.reads,
+			.writes = accesses.writes,
+			.meta_data = accesses.meta_data,
+			.push_constants = arena.copy(info.push_constants),
+			.pl = info.pl,
+			.group_count = {},
+			.indirect_args = std::make_pair(info.args, info.args_offset),
+			.debug_name = info.debug_name,
+			});
+		command_stream.emplace_back(CommandType::eDispatchIndirect, index, accesses.reads, accesses.writes);
+		return *this;
+	}
+
+	auto CommandRecorder::trace_rays(const TraceRaysInfo& info) -> CommandRecorder& {
+		assert_log(info.pl != nullptr, "trace_rays needs a ray tracing pipeline");
+		const auto accesses = split_accesses(arena, info.resources);
+
+		u32 index = static_cast<u32>(trace_rays_infos.size());
+		trace_rays_infos.emplace_back(nTraceRaysInfo{
+			.reads = accesses.reads,
+			.writes = accesses.writes,
+			.meta_data = accesses.meta_data,
+			.push_constants = arena.copy(info.push_constants),
+			.pl = info.pl,
+			.extent = info.extent,
+			.debug_name = info.debug_name,
+			});
+		command_stream.emplace_back(CommandType::eTraceRays, index, accesses.reads, accesses.writes);
+		return *this;
+	}
+
+	auto CommandRecorder::copy_texture(const CopyTextureInfo& info) -> CommandRecorder& {
+		u32 index = static_cast<u32>(copy_texture_infos.size());
+		copy_texture_infos.emplace_back(nCopyTextureInfo{ .dst = info.dst, .src = info.src });
+		const auto handles = arena.allocate_array<Handle>(2);
+		handles[0] = info.src;
+		handles[1] = info.dst;
+		command_stream.emplace_back(CommandType::eCopyTexture, index, handles.first(1), handles.last(1));
+		return *this;
+	}
+
+	auto CommandRecorder::mark_output(Handle res) -> CommandRecorder& {
+		outputs.emplace_back(res);
+		return *this;
+	}
+
+	auto CommandRecorder::wait_for(const ResourceFuture& future) -> CommandRecorder& {
+		if (!future.ready()) futures.emplace_back(future);
+		return *this;
+	}
+
+	inline auto CommandRecorder::get_draw_info(const CommandInfo& info) const -> const nDrawInfo& {
 		assert_log(info.type == CommandType::eDraw, "Trying to fetch incorrect command type");
 		return draw_infos[info.index];
 	}
 
-	inline auto CommandRecorder::get_copy_buffer_info(const CommandInfo& info) const -> nCopyBufferInfo {
+	inline auto CommandRecorder::get_copy_buffer_info(const CommandInfo& info) const -> const nCopyBufferInfo& {
 		assert_log(info.type == CommandType::eCopyBuffer, "Trying to fetch incorrect command type");
 		return copy_buffer_infos[info.index];
 	}
 
+	inline auto CommandRecorder::get_dispatch_info(const CommandInfo& info) const -> const nDispatchInfo& {
+		assert_log(info.type == CommandType::eDispatch || info.type == CommandType::eDispatchIndirect, "Trying to fetch incorrect command type");
+		return dispatch_infos[info.index];
+	}
+
+	inline auto CommandRecorder::get_trace_rays_info(const CommandInfo& info) const -> const nTraceRaysInfo& {
+		assert_log(info.type == CommandType::eTraceRays, "Trying to fetch incorrect command type");
+		return trace_rays_infos[info.index];
+	}
+
+	inline auto CommandRecorder::get_copy_texture_info(const CommandInfo& info) const -> const nCopyTextureInfo& {
+		assert_log(info.type == CommandType::eCopyTexture, "Trying to fetch incorrect command type");
+		return copy_texture_infos[info.index];
+	}
+
+	auto CommandRecorder::get_meta_data(const CommandInfo& info) const -> std::span<const ResourceMetaData> {
+		switch (info.type) {
+		case CommandType::eDraw:
+			return get_draw_info(info).meta_data;
+		case CommandType::eDispatch:
+		case CommandType::eDispatchIndirect:
+			return get_dispatch_info(info).meta_data;
+		case CommandType::eTraceRays:
+			return get_trace_rays_info(info).meta_data;
+		default:
+			return {};
+		}
+	}
+
+	auto CommandRecorder::get_debug_name(const CommandInfo& info) const -> std::string_view {
+		switch (info.type) {
+		case CommandType::eDraw:
+			return get_draw_info(info).debug_name;
+		case CommandType::eDispatch:
+		case CommandType::eDispatchIndirect:
+			return get_dispatch_info(info).debug_name;
+		case CommandType::eTraceRays:
+			return get_trace_rays_info(info).debug_name;
+		case CommandType::eCopyBuffer:
+			return "copy buffer";
+		case CommandType::eCopyTexture:
+			return "copy texture";
+		default:
+			return "";
+		}
+	}
+
 	auto CommandRecorder::get_barrier_info(const CommandInfo& info, usize index, bool write) const -> std::pair<D3D12_BARRIER_SYNC, D3D12_BARRIER_ACCESS> {
 		switch (info.type) {
 		case CommandType::eDraw:
 			return get_draw_info(info).get_barrier_info(index, write);
+		case CommandType::eDispatch:
+		case CommandType::eDispatchIndirect:
+			return get_dispatch_info(info).get_barrier_info(index, write);
+		case CommandType::eTraceRays:
+			return get_trace_rays_info(info).get_barrier_info(index, write);
+		case CommandType::eCopyBuffer:
+		case CommandType::eCopyTexture:
+			// copies read their source and write their destination
+			return std::make_pair(D3D12_BARRIER_SYNC_COPY, write ? D3D12_BARRIER_ACCESS_COPY_DEST : D3D12_BARRIER_ACCESS_COPY_SOURCE);
 		default:
 			assert_log(0, "cannot get barrier info from unkown command type");
 			return std::make_pair(D3D12_BARRIER_SYNC_NONE, D3D12_BARRIER_ACCESS_NO_ACCESS);
@@ -144,40 +538,48 @@ namespace d {
 	auto CommandRecorder::get_layout_requirements(const CommandInfo& info) const -> std::vector<std::pair<Handle, D3D12_BARRIER_LAYOUT>> {
 		std::vector<std::pair<Handle, D3D12_BARRIER_LAYOUT>> layout_requirements;
 
-		const auto& draw_info = get_draw_info(info);
-		usize i = 0u;
 		switch (info.type) {
 		case CommandType::eDraw:
-			for (const auto& read : draw_info.reads) {
-				const auto& meta_data = draw_info.get_meta_data(i, false);
-				if (get_res_state(read).type == ResourceType::D2) {
-					layout_requirements.emplace_back(read, D3D12_BARRIER_LAYOUT_SHADER_RESOURCE);
-				}
-				++i;
-			}
-			i = 0;
-			for (const auto& write : draw_info.writes) {
-				const auto& meta_data = draw_info.get_meta_data(i, true);
-				if (get_res_state(write).type == ResourceType::D2) {
-					if (meta_data.type == AccessType::eRenderTarget) {
-						layout_requirements.emplace_back(write, D3D12_BARRIER_LAYOUT_RENDER_TARGET);
-					}
-					else if (meta_data.type == AccessType::eDepthTarget) {
-						layout_requirements.emplace_back(write, D3D12_BARRIER_LAYOUT_DEPTH_STENCIL_WRITE);
-					}
-					else if (meta_data.type == AccessType::eReadWriteAtomic) {
-						layout_requirements.emplace_back(write, D3D12_BARRIER_LAYOUT_UNORDERED_ACCESS);
-					}
-				}
-				++i;
-			}
+			append_shader_layouts(get_draw_info(info), layout_requirements);
+			return layout_requirements;
+		case CommandType::eDispatch:
+		case CommandType::eDispatchIndirect:
+			append_shader_layouts(get_dispatch_info(info), layout_requirements);
+			return layout_requirements;
+		case CommandType::eTraceRays:
+			append_shader_layouts(get_trace_rays_info(info), layout_requirements);
+			return layout_requirements;
+		case CommandType::eCopyTexture:
+		{
+			const auto& copy_info = get_copy_texture_info(info);
+			layout_requirements.emplace_back(copy_info.src, D3D12_BARRIER_LAYOUT_COPY_SOURCE);
+			layout_requirements.emplace_back(copy_info.dst, D3D12_BARRIER_LAYOUT_COPY_DEST);
+			return layout_requirements;
+		}
+		case CommandType::eCopyBuffer:
+			// buffers have no layout
 			return layout_requirements;
 		default:
-			//assert_log(0, "cannot get barrier info from unkown command type");
-			assert(0 && "cannot get barrier info from unknown command type");
+			assert_log(0, "cannot get layout requirements from unknown command type");
 			return layout_requirements;
 		}
+	}
+
+	auto CommandRecorder::get_preferred_queue(const CommandInfo& info) const -> QueueType {
+		// textures stay on the general queue, the async queues only support a subset of layouts
+		const auto is_buffer = [](Handle res) { return !is_texture_type(get_res_state(res).type); };
+		if (!std::ranges::all_of(info.reads, is_buffer) || !std::ranges::all_of(info.writes, is_buffer)) return QueueType::GENERAL;
 
+		switch (info.type) {
+		case CommandType::eCopyBuffer:
+			return QueueType::ASYNC_TRANSFER;
+		case CommandType::eDispatch:
+		case CommandType::eDispatchIndirect:
+		case CommandType::eTraceRays:
+			return QueueType::ASYNC_COMPUTE;
+		default:
+			return QueueType::GENERAL;
+		}
 	}
 
 	auto CommandRecorder::do_command(CommandList& list, const CommandInfo& info) const {
@@ -188,169 +590,931 @@ namespace d {
 			draw_info.do_command(list);
 			break;
 		}
+		case CommandType::eDispatch:
+		case CommandType::eDispatchIndirect:
+			get_dispatch_info(info).do_command(list);
+			break;
+		case CommandType::eTraceRays:
+			get_trace_rays_info(info).do_command(list);
+			break;
+		case CommandType::eCopyBuffer:
+		{
+			const auto& copy_info = get_copy_buffer_info(info);
+			list.copy_buffer_region(copy_info.src, copy_info.dst, copy_info.num_bytes, copy_info.src_offset, copy_info.dst_offset);
+			break;
+		}
+		case CommandType::eCopyTexture:
+		{
+			const auto& copy_info = get_copy_texture_info(info);
+			list.copy_image(copy_info.src, copy_info.dst);
+			break;
+		}
 		default:
 			assert_log(0, "trying to decode unknown command with unknown type");
 			return;
 		}
 	}
 
-	auto CommandGraph::get_barrier_dependencies(const CommandInfo& c0, const CommandInfo& c1) const -> std::vector<Barrier> {
-		std::vector<Barrier> barriers;
+	auto CommandRecorder::resolve_views() -> void {
+		for (auto& draw_info : draw_infos) draw_info.resolve_targets(arena);
+	}
 
-		// read write connections
-		{
-			std::vector<Handle> connected_resources;
-			std::ranges::set_intersection(c0.reads, c1.writes, std::back_inserter(connected_resources));
-			for (const auto& res : connected_resources) {
-				const auto [sync0, access0] = recorder.get_barrier_info(c0, res, false);
-				const auto [sync1, access1] = recorder.get_barrier_info(c1, res, true);
-				const auto res_type = get_res_state(res).type;
-				const auto is_texture = !(res_type == ResourceType::Buffer || res_type == ResourceType::AccelStructure);
-				barriers.emplace_back(sync0, sync1, access0, access1, res, is_texture);
+	auto CommandRecorder::build_topology_key() -> void {
+		// everything barriers and layouts are derived from, push constants and draw arguments are left out
+		// so they can change without recompiling the graph
+		topology_key.clear();
+		topology_key.emplace_back(command_stream.size());
+		for (const auto& command : command_stream) {
+			topology_key.emplace_back(static_cast<u64>(command.type) << 48 | static_cast<u64>(command.reads.size()) << 24 | command.writes.size());
+			for (const auto res : command.reads) topology_key.emplace_back(res);
+			for (const auto res : command.writes) topology_key.emplace_back(res);
+			for (const auto& meta_data : get_meta_data(command)) topology_key.emplace_back(static_cast<u64>(meta_data.type) << 8 | static_cast<u64>(meta_data.domain));
+		}
+		topology_key.emplace_back(outputs.size());
+		for (const auto res : outputs) topology_key.emplace_back(res);
+		// native barriers bake in the resource pointers and initial layouts of everything touched
+		// except for transients, which only get their native resources while compiling
+		const auto key_native = [&](Handle res) {
+			if (const auto& hot = get_hot_res(res); !hot.state.transient) {
+				topology_key.emplace_back(reinterpret_cast<uintptr_t>(hot.native));
+				topology_key.emplace_back(hot.state.layout);
 			}
+		};
+		for (const auto& command : command_stream) {
+			std::ranges::for_each(command.reads, key_native);
+			std::ranges::for_each(command.writes, key_native);
 		}
+	}
 
-		// write read connections
-		{
-			std::vector<Handle> connected_resources;
-			std::ranges::set_intersection(c0.writes, c1.reads, std::back_inserter(connected_resources));
-			for (const auto& res : connected_resources) {
-				const auto [sync0, access0] = recorder.get_barrier_info(c0, res, true);
-				const auto [sync1, access1] = recorder.get_barrier_info(c1, res, false);
-				const auto is_texture = get_res_state(res).type == ResourceType::D2;
-				barriers.emplace_back(sync0, sync1, access0, access1, res, is_texture);
+	auto CommandRecorder::topology_hash() const -> u64 {
+		u64 h = topology_key.size();
+		for (const auto word : topology_key) h = hash::mix64(h ^ word);
+		return h;
+	}
+
+	auto CommandRecorder::reset() -> void {
+		draw_infos.clear();
+		copy_buffer_infos.clear();
+		dispatch_infos.clear();
+		trace_rays_infos.clear();
+		copy_texture_infos.clear();
+		command_stream.clear();
+		outputs.clear();
+		futures.clear();
+		arena.reset();
+		heap_allocations_at_reset = get_num_heap_allocations();
+		reset_time = std::chrono::high_resolution_clock::now();
+	}
+
+	auto CommandRecorder::finish_recording() -> void {
+		stats = Stats{
+			.num_commands = static_cast<u32>(command_stream.size()),
+			.num_allocations = static_cast<u32>(get_num_heap_allocations() - heap_allocations_at_reset),
+			.arena_bytes = arena.num_used_bytes,
+			.record_ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - reset_time).count(),
+		};
+	}
+
+	auto CommandGraph::make_barrier(const CommandInfo& c0, const CommandAccess& a0, const CommandInfo& c1, const CommandAccess& a1, Handle res) const -> Barrier {
+		const auto [sync0, access0] = recorder.get_barrier_info(c0, a0.index, a0.write);
+		const auto [sync1, access1] = recorder.get_barrier_info(c1, a1.index, a1.write);
+		const auto res_type = get_res_state(res).type;
+		return Barrier{ sync0, sync1, access0, access1, res, is_texture_type(res_type) };
+	}
+
+	auto CommandGraph::cull(Compiled& out) const -> void {
+		const auto& stream = recorder.command_stream;
+		out.live_commands.assign(stream.size(), true);
+		out.stats.num_culled_commands = 0;
+		if (recorder.outputs.empty()) return;
+
+		// walking the stream backwards, a command is live if it writes something a live command after it or an output
+		// still needs. every write is treated as depending on the previous contents, so earlier writers stay live as well
+		std::vector<bool> needed;
+		const auto mark = [&](Handle res) {
+			const u32 slot = get_handle_index(res);
+			if (slot >= needed.size()) needed.resize(slot + 1);
+			needed[slot] = true;
+		};
+		std::ranges::for_each(recorder.outputs, mark);
+		for (u32 ci = static_cast<u32>(stream.size()); ci-- > 0;) {
+			const auto& command = stream[ci];
+			const bool live = std::ranges::any_of(command.writes, [&](Handle res) {
+				const u32 slot = get_handle_index(res);
+				return slot < needed.size() && needed[slot];
+			});
+			out.live_commands[ci] = live;
+			if (!live) {
+				++out.stats.num_culled_commands;
+				continue;
 			}
+			std::ranges::for_each(command.reads, mark);
 		}
-		return barriers;
 	}
 
-	auto CommandGraph::graphify() -> void {
-		std::unordered_map<Handle, D3D12_BARRIER_LAYOUT> last_layout;
+	auto CommandGraph::graphify(Compiled& out) const -> void {
+		const auto t0 = std::chrono::high_resolution_clock::now();
 		const auto& stream = recorder.command_stream;
 
 		// build adjacency list
-		command_adj_list.resize(stream.size());
-		required_layouts.resize(stream.size());
+		out.command_adj_list.clear();
+		out.command_adj_list.resize(stream.size());
+		out.required_layouts.clear();
+		out.required_layouts.resize(stream.size());
 
-		usize ci = 0;
-		for (const auto& c0 : stream) {
-			usize cii = ci + 1;
-			// fill resource barriers
-			for (const auto& c1 : stream | std::views::drop(ci + 1)) {
-				auto barriers = get_barrier_dependencies(c0, c1);
-				if (!barriers.empty()) command_adj_list[ci].emplace_back(cii, barriers);
-				++cii;
+		// last writer and readers since that write for every handle, a command only ever has to be
+		// linked against these instead of every later command in the stream
+		std::vector<std::optional<CommandAccess>> last_writer;
+		std::vector<std::vector<CommandAccess>> last_readers;
+		const auto track = [&](Handle res) -> u32 {
+			const u32 slot = get_handle_index(res);
+			if (slot >= last_writer.size()) last_writer.resize(slot + 1), last_readers.resize(slot + 1);
+			return slot;
+		};
+
+		// (last consumer linked to a producer, index of that link in the producer's adjacency list)
+		// so several shared resources between the same two commands end up in one edge
+		std::vector<std::pair<u32, u32>> last_link(stream.size(), { ~0u, 0u });
+		const auto link = [&](u32 producer, u32 consumer, const Barrier& barrier) {
+			auto& [linked_consumer, link_index] = last_link[producer];
+			if (linked_consumer != consumer) {
+				linked_consumer = consumer;
+				link_index = static_cast<u32>(out.command_adj_list[producer].size());
+				out.command_adj_list[producer].emplace_back(consumer, std::vector<Barrier>{});
+				++out.stats.num_edges;
+			}
+			out.command_adj_list[producer][link_index].second.emplace_back(barrier);
+		};
+
+		out.stats.num_edges = 0;
+		for (u32 ci = 0; ci < static_cast<u32>(stream.size()); ++ci) {
+			if (!out.live_commands[ci]) continue;
+			const auto& c1 = stream[ci];
+
+			// read after write
+			for (u32 i = 0; i < static_cast<u32>(c1.reads.size()); ++i) {
+				const Handle res = c1.reads[i];
+				const u32 slot = track(res);
+				const auto access = CommandAccess{ .command = ci, .index = i, .write = false };
+				if (const auto& writer = last_writer[slot]; writer.has_value() && writer->command != ci) {
+					link(writer->command, ci, make_barrier(stream[writer->command], *writer, c1, access, res));
+				}
+				last_readers[slot].emplace_back(access);
+			}
+
+			// write after read, write after write when nothing read the previous write
+			for (u32 i = 0; i < static_cast<u32>(c1.writes.size()); ++i) {
+				const Handle res = c1.writes[i];
+				const u32 slot = track(res);
+				const auto access = CommandAccess{ .command = ci, .index = i, .write = true };
+				auto& readers = last_readers[slot];
+				auto& writer = last_writer[slot];
+				if (!readers.empty()) {
+					for (const auto& reader : readers) {
+						if (reader.command != ci) link(reader.command, ci, make_barrier(stream[reader.command], reader, c1, access, res));
+					}
+				}
+				else if (writer.has_value() && writer->command != ci) {
+					link(writer->command, ci, make_barrier(stream[writer->command], *writer, c1, access, res));
+				}
+				writer = access;
+				readers.clear();
 			}
-			required_layouts[ci] = recorder.get_layout_requirements(c0);
-			++ci;
+
+			out.required_layouts[ci] = recorder.get_layout_requirements(c1);
 		}
+
+		out.stats.num_commands = static_cast<u32>(stream.size());
+		out.stats.graphify_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
 	}
 
-	auto CommandGraph::flatten() -> void {
+	auto CommandGraph::flatten(Compiled& out) -> void {
+		const auto t0 = std::chrono::high_resolution_clock::now();
 		const auto& stream = recorder.command_stream;
-		// flatten graph into linear stream of commands and barriers
-		execution_steps.resize(stream.size());
-		std::vector visited(stream.size(), false);
+		const auto num_commands = static_cast<u32>(stream.size());
 
+		// longest path leveling, the command stream already is a topological order of the DAG so a single
+		// forward pass puts every command into the first step all of its dependencies are met in
+		std::vector<u32> command_step(num_commands, 0);
 		u32 num_execution_steps = 0;
+		for (u32 v = 0; v < num_commands; ++v) {
+			if (!out.live_commands[v]) continue;
+			for (const auto& next : out.command_adj_list[v] | std::views::keys)
+				command_step[next] = std::max(command_step[next], command_step[v] + 1);
+			num_execution_steps = std::max(num_execution_steps, command_step[v] + 1);
+		}
+
+		out.execution_steps.clear();
+		out.execution_steps.resize(num_execution_steps);
+		// (producer, barriers of that edge) for every consumer
+		std::vector<std::vector<std::pair<u32, const std::vector<Barrier>*>>> incoming(num_commands);
+		for (u32 v = 0; v < num_commands; ++v) {
+			if (!out.live_commands[v]) continue;
+			out.execution_steps[command_step[v]].first.emplace_back(v);
+			// dependencies are resolved right before the step of the consuming command
+			for (const auto& [next, barriers] : out.command_adj_list[v]) {
+				auto& step_barriers = out.execution_steps[command_step[next]].second;
+				step_barriers.insert(step_barriers.end(), barriers.begin(), barriers.end());
+				incoming[next].emplace_back(v, &barriers);
+			}
+		}
 
-		std::stack<u32> stack;
-		for (usize v = 0; v < visited.size(); ++v) {
-			if (!visited[v]) {
-				// DAG and In-order command list -> has to be a source node
-				stack.push(static_cast<u32>(v));
-				u32 exe_step = 0;
-				while (!stack.empty()) { // standard dfs
-					const u32 node = stack.top();
-					stack.pop();
-					visited[node] = true;
-					auto& step = execution_steps[exe_step];
-					step.first.emplace_back(node);
-					for (const auto& [next, barrier] : command_adj_list[node]) {
-						if (!visited[next])
-							stack.push(next);
-						step.second.reserve(step.second.size() + barrier.size());
-						step.second.insert(step.second.end(), barrier.begin(), barrier.end());
+		// transients live from the first to the last step touching them, placing them has to happen before any
+		// native barrier gets built since that is where their native resources come from
+		{
+			std::vector<std::optional<TransientLifetime>> lifetimes(transients.resources.size());
+			const auto touch = [&](Handle res, u32 step) {
+				const auto it = transients.resource_indices.find(res);
+				if (it == transients.resource_indices.end()) return;
+				auto& lifetime = lifetimes[it->second];
+				if (!lifetime.has_value()) lifetime = TransientLifetime{ .first_step = step, .last_step = step };
+				lifetime->first_step = std::min(lifetime->first_step, step);
+				lifetime->last_step = std::max(lifetime->last_step, step);
+			};
+			for (u32 v = 0; v < num_commands; ++v) {
+				if (!out.live_commands[v]) continue;
+				for (const auto res : stream[v].reads) touch(res, command_step[v]);
+				for (const auto res : stream[v].writes) touch(res, command_step[v]);
+			}
+			transients.place(lifetimes);
+		}
+
+		// commands only leave the general queue when something else runs on the general queue in the same step,
+		// otherwise the general queue would just sit there waiting on them. aliasing barriers only order work on
+		// one queue, so anything touching a transient stays on the general queue as well
+		const auto get_queue = [&](u32 v) {
+			const auto is_transient = [&](Handle res) { return transients.find(res) != nullptr; };
+			if (std::ranges::any_of(stream[v].reads, is_transient) || std::ranges::any_of(stream[v].writes, is_transient)) return QueueType::GENERAL;
+			return recorder.get_preferred_queue(stream[v]);
+		};
+		out.command_queues.assign(num_commands, QueueType::GENERAL);
+		out.stats.num_async_commands = 0;
+		for (const auto& commands : out.execution_steps | std::views::keys) {
+			const bool step_has_general = std::ranges::any_of(commands, [&](u32 v) { return get_queue(v) == QueueType::GENERAL; });
+			if (!step_has_general) continue;
+			for (const auto v : commands) {
+				out.command_queues[v] = get_queue(v);
+				out.stats.num_async_commands += out.command_queues[v] != QueueType::GENERAL;
+			}
+		}
+
+		std::array<std::vector<QueueStep>, num_queue_types> queue_steps;
+		// producer side of a cross queue dependency has to signal after the step, the consumer side waits before it
+		std::vector<std::array<bool, num_queue_types>> signal_after(num_execution_steps);
+		std::vector<std::array<std::vector<std::pair<QueueType, u32>>, num_queue_types>> wait_before(num_execution_steps);
+
+		// every handle gets at most one merged barrier per step and queue
+		std::vector<ResourceTrack> tracks;
+		std::vector<Handle> step_resources;
+		std::vector<Handle> touched_resources;
+		std::vector<u32> commands;
+		for (u32 s = 0; s < num_execution_steps; ++s) {
+			for (usize q = 0; q < num_queue_types; ++q) {
+				const auto queue = static_cast<QueueType>(q);
+				commands.clear();
+				std::ranges::copy_if(out.execution_steps[s].first, std::back_inserter(commands), [&](u32 v) { return out.command_queues[v] == queue; });
+				if (commands.empty()) continue;
+
+				const u32 stamp = static_cast<u32>(s * num_queue_types + q + 1);
+				auto& queue_step = queue_steps[q].emplace_back(QueueStep{ .step = s, .commands = commands });
+
+				step_resources.clear();
+				const auto use = [&](Handle res, D3D12_BARRIER_SYNC sync, D3D12_BARRIER_ACCESS access) {
+					const u32 slot = get_handle_index(res);
+					if (slot >= tracks.size()) tracks.resize(slot + 1);
+					auto& track = tracks[slot];
+					if (track.step_stamp == 0) {
+						// one hot registry entry has everything needed, the transient map is only asked about actual transients
+						const auto& hot = get_hot_res(res);
+						const auto& state = hot.state;
+						track.native = hot.native;
+						track.is_texture = is_texture_type(state.type);
+						track.initial_layout = state.layout;
+						track.last = ResourceUsage{ .layout = state.layout };
+						touched_resources.emplace_back(res);
+						// the first use of a transient discards whatever the transients placed in the same memory before left behind
+						if (const auto* transient = state.transient ? transients.find(res) : nullptr) {
+							track.transient = true;
+							track.discard = true;
+							track.last = ResourceUsage{ .layout = D3D12_BARRIER_LAYOUT_UNDEFINED };
+							for (const auto alias : transient->aliases) track.last.sync |= tracks[get_handle_index(alias)].last.sync;
+						}
+					}
+					if (track.step_stamp != stamp) {
+						track.step_stamp = stamp;
+						track.step = ResourceUsage{ .layout = D3D12_BARRIER_LAYOUT_UNDEFINED };
+						step_resources.emplace_back(res);
+					}
+					track.step.sync |= sync;
+					track.step.access |= access;
+				};
+
+				for (const auto command_index : commands) {
+					const auto& command = stream[command_index];
+					for (u32 i = 0; i < static_cast<u32>(command.reads.size()); ++i) {
+						const auto [sync, access] = recorder.get_barrier_info(command, i, false);
+						use(command.reads[i], sync, access);
+					}
+					for (u32 i = 0; i < static_cast<u32>(command.writes.size()); ++i) {
+						const auto [sync, access] = recorder.get_barrier_info(command, i, true);
+						use(command.writes[i], sync, access);
+					}
+					for (const auto& [res, layout] : out.required_layouts[command_index]) {
+						auto& step_layout = tracks[get_handle_index(res)].step.layout;
+						step_layout = step_layout == D3D12_BARRIER_LAYOUT_UNDEFINED ? layout : merge_layouts(step_layout, layout);
 					}
 
-					++exe_step;
+					for (const auto& [producer, barriers] : incoming[command_index]) {
+						const auto producer_queue = out.command_queues[producer];
+						// the fence wait already orders and flushes everything the producer did
+						if (producer_queue != queue) {
+							signal_after[command_step[producer]][static_cast<usize>(producer_queue)] = true;
+							wait_before[s][q].emplace_back(producer_queue, command_step[producer]);
+							continue;
+						}
+						for (const auto& barrier : *barriers) {
+							auto& track = tracks[get_handle_index(barrier.res)];
+							if (track.edge_stamp != stamp) {
+								track.edge_stamp = stamp;
+								track.edge_sync = D3D12_BARRIER_SYNC_NONE;
+								track.edge_access = D3D12_BARRIER_ACCESS_NO_ACCESS;
+							}
+							track.edge_sync |= barrier.sync_before;
+							track.edge_access |= barrier.access_before;
+						}
+					}
 				}
-				num_execution_steps = std::max(num_execution_steps, exe_step);
-			}
-		}
-		execution_steps.resize(num_execution_steps);
-
-		native_buffer_barriers.resize(num_execution_steps);
-		native_texture_barriers.resize(num_execution_steps);
-		native_command_level_transitions.resize(stream.size());
-
-		std::unordered_map<Handle, D3D12_BARRIER_LAYOUT> prev_texture_layout;
-		for (const auto& step : execution_steps) {
-			std::vector<D3D12_BUFFER_BARRIER> buffer_barriers;
-			std::vector<D3D12_TEXTURE_BARRIER> texture_barriers;
-
-			std::unordered_map<Handle, D3D12_BARRIER_LAYOUT> first_texture_requirement;
-			std::unordered_map<Handle, D3D12_BARRIER_LAYOUT> prev_prev_texture_requirement;
-			std::unordered_set<Handle> first_texture_requirement_with_dependency;
-			for (const auto& s : step.first)
-				for (const auto& requirement : required_layouts[s]) {
-					if (!first_texture_requirement.contains(requirement.first))
-						first_texture_requirement[requirement.first] = requirement.second, prev_prev_texture_requirement[requirement.first] = get_res_state(requirement.first).layout, prev_texture_layout[requirement.first] =
-						requirement.second;
-
-					if (prev_texture_layout[requirement.first] != requirement.second)
-						native_command_level_transitions[s].emplace_back(D3D12_BARRIER_SYNC_NONE, D3D12_BARRIER_SYNC_NONE,
-							D3D12_BARRIER_ACCESS_NO_ACCESS,
-							D3D12_BARRIER_ACCESS_NO_ACCESS,
-							prev_prev_texture_requirement[requirement.first], requirement.second,
-							get_native_res(requirement.first)), prev_texture_layout[
-								requirement.first] = requirement.second;
+
+				for (const auto res : step_resources) {
+					auto& track = tracks[get_handle_index(res)];
+					const auto layout_after = track.step.layout == D3D12_BARRIER_LAYOUT_UNDEFINED ? track.last.layout : track.step.layout;
+					const bool has_edge = track.edge_stamp == stamp;
+					const bool needs_transition = track.is_texture && layout_after != track.last.layout;
+					const bool needs_aliasing = track.discard && track.last.sync != D3D12_BARRIER_SYNC_NONE;
+					if (has_edge || needs_transition || needs_aliasing) {
+						// without a dependency edge the transition only has to wait on whatever touched the texture last
+						const auto sync_before = has_edge ? track.edge_sync : track.last.sync;
+						const auto access_before = has_edge ? track.edge_access : track.last.access;
+						if (track.is_texture) {
+							queue_step.texture_barriers.emplace_back(D3D12_TEXTURE_BARRIER{
+								.SyncBefore = sync_before,
+								.SyncAfter = track.step.sync,
+								.AccessBefore = access_before,
+								.AccessAfter = track.step.access,
+								.LayoutBefore = track.last.layout,
+								.LayoutAfter = layout_after,
+								.pResource = track.native,
+								.Subresources = { .IndexOrFirstMipLevel = 0xffffffff },
+								.Flags = track.discard ? D3D12_TEXTURE_BARRIER_FLAG_DISCARD : D3D12_TEXTURE_BARRIER_FLAG_NONE,
+								});
+							queue_step.texture_barrier_handles.emplace_back(res);
+						}
+						else {
+							queue_step.buffer_barriers.emplace_back(D3D12_BUFFER_BARRIER{
+								.SyncBefore = sync_before,
+								.SyncAfter = track.step.sync,
+								.AccessBefore = access_before,
+								.AccessAfter = track.step.access,
+								.pResource = track.native,
+								.Offset = 0,
+								.Size = UINT64_MAX,
+								});
+							queue_step.buffer_barrier_handles.emplace_back(res);
+						}
+					}
+					track.last = ResourceUsage{ .sync = track.step.sync, .access = track.step.access, .layout = layout_after };
+					track.discard = false;
 				}
+			}
+		}
+
+		// hand textures back in the layout they were in before the graph so it can be replayed every frame
+		out.native_exit_barriers.clear();
+		for (const auto res : touched_resources) {
+			const auto& track = tracks[get_handle_index(res)];
+			if (track.is_texture && !track.transient && track.last.layout != track.initial_layout) {
+				out.native_exit_barriers.emplace_back(D3D12_TEXTURE_BARRIER{
+					.SyncBefore = track.last.sync,
+					.SyncAfter = D3D12_BARRIER_SYNC_NONE,
+					.AccessBefore = track.last.access,
+					.AccessAfter = D3D12_BARRIER_ACCESS_NO_ACCESS,
+					.LayoutBefore = track.last.layout,
+					.LayoutAfter = track.initial_layout,
+					.pResource = track.native,
+					.Subresources = { .IndexOrFirstMipLevel = 0xffffffff },
+					.Flags = D3D12_TEXTURE_BARRIER_FLAG_NONE,
+					});
+			}
+		}
+
+		// cut every queue's steps into submissions, a submission ends after a step something on another queue depends on
+		// and starts at a step that has to wait. known[q][src] is the number of signals of src that q is already ordered
+		// after, including everything src itself waited on before those signals, so transitively covered waits are dropped
+		using Clock = std::array<u32, num_queue_types>;
+		std::array<Clock, num_queue_types> known{};
+		std::array<std::vector<Clock>, num_queue_types> signal_clocks;
+		std::vector<std::array<u32, num_queue_types>> step_signal(num_execution_steps);
+		std::array<std::optional<usize>, num_queue_types> open_submission;
+		std::array<usize, num_queue_types> next_queue_step{};
+
+		out.submissions.clear();
+		out.exit_waits.clear();
+		out.stats.num_queue_waits = 0;
+		out.stats.num_skipped_waits = 0;
+		const auto add_signal = [&](usize q, Submission& submission) {
+			const auto index = static_cast<u32>(signal_clocks[q].size());
+			submission.signal = index;
+			known[q][q] = index + 1;
+			signal_clocks[q].emplace_back(known[q]);
+			return index;
+		};
+		const auto add_wait = [&](usize q, QueueType src, u32 signal, std::vector<std::pair<QueueType, u32>>& waits) {
+			const auto src_q = static_cast<usize>(src);
+			if (known[q][src_q] > signal) {
+				++out.stats.num_skipped_waits;
+				return;
+			}
+			waits.emplace_back(src, signal);
+			++out.stats.num_queue_waits;
+			for (usize i = 0; i < num_queue_types; ++i) known[q][i] = std::max(known[q][i], signal_clocks[src_q][signal][i]);
+		};
+
+		for (u32 s = 0; s < num_execution_steps; ++s) {
+			for (usize q = 0; q < num_queue_types; ++q) {
+				auto& steps = queue_steps[q];
+				if (next_queue_step[q] >= steps.size() || steps[next_queue_step[q]].step != s) continue;
 
-			for (const auto& barrier : step.second) {
-				if (barrier.is_texture) {
-					texture_barriers.emplace_back(barrier.sync_before, barrier.sync_after, barrier.access_before,
-						barrier.access_after, prev_prev_texture_requirement[barrier.res],
-						first_texture_requirement.contains(barrier.res)
-						? first_texture_requirement[barrier.res]
-						: D3D12_BARRIER_LAYOUT_COMMON, get_native_res(barrier.res));
-					if (first_texture_requirement.contains(barrier.res)) first_texture_requirement_with_dependency.insert(barrier.res);
+				const auto& waits = wait_before[s][q];
+				if (!open_submission[q] || !waits.empty()) {
+					open_submission[q] = out.submissions.size();
+					auto& submission = out.submissions.emplace_back(Submission{ .queue = static_cast<QueueType>(q) });
+					for (const auto& [src, src_step] : waits) {
+						add_wait(q, src, step_signal[src_step][static_cast<usize>(src)], submission.waits);
+					}
 				}
-				else {
-					buffer_barriers.emplace_back(barrier.sync_before, barrier.sync_after, barrier.access_before, barrier.access_after, get_native_res(barrier.res), 0, 0);
+				auto& submission = out.submissions[*open_submission[q]];
+				submission.steps.emplace_back(std::move(steps[next_queue_step[q]++]));
+				if (signal_after[s][q]) {
+					step_signal[s][q] = add_signal(q, submission);
+					open_submission[q].reset();
 				}
 			}
-			for (const auto& requirement : first_texture_requirement) {
-				if (!first_texture_requirement_with_dependency.contains(requirement.first)) {
-					texture_barriers.emplace_back(D3D12_BARRIER_SYNC_NONE, D3D12_BARRIER_SYNC_NONE,
-						D3D12_BARRIER_ACCESS_NO_ACCESS,
-						D3D12_BARRIER_ACCESS_NO_ACCESS,
-						prev_prev_texture_requirement[requirement.first], requirement.second,
-						get_native_res(requirement.first));
+		}
+
+		// a barrier whose resource was last touched more than one step earlier on the same queue is split, the begin half
+		// goes right after that last use so the transition overlaps the steps in between. both halves have to be in the same
+		// command list, so splits stay within a submission and the recording chunks never cut through an open split
+		out.stats.num_split_barriers = 0;
+		// keyed by handle slot, native pointers are all null headless and can be reused by transients placed again
+		std::unordered_map<u32, u32> last_touch;
+		for (auto& submission : out.submissions) {
+			last_touch.clear();
+			auto& steps = submission.steps;
+			const auto split = [&](auto& barrier, Handle res, u32 j, auto get_split_barriers) {
+				const auto it = last_touch.find(c.resource_registry.get_slot(res));
+				if (it == last_touch.end() || it->second + 1 >= j) return;
+				auto begin = barrier;
+				begin.SyncAfter = D3D12_BARRIER_SYNC_SPLIT;
+				barrier.SyncBefore = D3D12_BARRIER_SYNC_SPLIT;
+				get_split_barriers(steps[it->second]).emplace_back(begin);
+				for (u32 k = it->second; k < j; ++k) steps[k].split_pending = true;
+				++out.stats.num_split_barriers;
+			};
+			for (u32 j = 0; j < static_cast<u32>(steps.size()); ++j) {
+				auto& step = steps[j];
+				for (usize b = 0; b < step.buffer_barriers.size(); ++b) {
+					split(step.buffer_barriers[b], step.buffer_barrier_handles[b], j, [](QueueStep& target) -> auto& { return target.split_buffer_barriers; });
+				}
+				for (usize b = 0; b < step.texture_barriers.size(); ++b) {
+					// discards only make sense on the first use of an aliased transient
+					if (step.texture_barriers[b].Flags & D3D12_TEXTURE_BARRIER_FLAG_DISCARD) continue;
+					split(step.texture_barriers[b], step.texture_barrier_handles[b], j, [](QueueStep& target) -> auto& { return target.split_texture_barriers; });
+				}
+				for (const auto command_index : step.commands) {
+					for (const auto res : stream[command_index].reads) last_touch[c.resource_registry.get_slot(res)] = j;
+					for (const auto res : stream[command_index].writes) last_touch[c.resource_registry.get_slot(res)] = j;
 				}
 			}
+		}
 
-			native_buffer_barriers.emplace_back(buffer_barriers);
-			native_texture_barriers.emplace_back(texture_barriers);
+		// everything after the graph only ever waits on the general queue
+		constexpr auto general_q = static_cast<usize>(QueueType::GENERAL);
+		for (usize q = 0; q < num_queue_types; ++q) {
+			if (q == general_q) continue;
+			const auto last = std::ranges::find_if(out.submissions | std::views::reverse, [&](const Submission& submission) { return static_cast<usize>(submission.queue) == q; });
+			if (last == (out.submissions | std::views::reverse).end()) continue;
+			const auto signal = last->signal.has_value() ? *last->signal : add_signal(q, *last);
+			add_wait(general_q, static_cast<QueueType>(q), signal, out.exit_waits);
+		}
 
+		out.stats.num_steps = num_execution_steps;
+		out.stats.num_submissions = static_cast<u32>(out.submissions.size());
+		out.stats.num_barriers = static_cast<u32>(out.native_exit_barriers.size());
+		out.stats.num_barrier_batches = out.native_exit_barriers.empty() ? 0 : 1;
+		for (const auto& submission : out.submissions) {
+			for (const auto& step : submission.steps) {
+				const auto num_step_barriers = static_cast<u32>(step.buffer_barriers.size() + step.texture_barriers.size());
+				out.stats.num_barriers += num_step_barriers;
+				out.stats.num_barrier_batches += num_step_barriers ? 1 : 0;
+				out.stats.num_barrier_batches += step.split_buffer_barriers.empty() && step.split_texture_barriers.empty() ? 0 : 1;
+			}
 		}
+		out.stats.flatten_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
 	}
 
-	auto CommandGraph::do_commands(CommandList& list) const {
-		const auto& linear_command_list = recorder.command_stream;
+	auto CommandGraph::compile() -> void {
+		recorder.finish_recording();
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		recorder.build_topology_key();
+		const u64 hash = recorder.topology_hash();
+		if (const auto it = compiled_cache.find(hash); it != compiled_cache.end()) {
+			if (it->second.topology_key == recorder.topology_key) {
+				compiled = &it->second;
+				++cache_stats.hits;
+				cache_stats.hit_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+				return;
+			}
+			// another topology with the same hash, compiled again below and takes the entry over
+			++cache_stats.collisions;
+			warn_log("CommandGraph cache: topology hash collision on {:#018x}, recompiling", hash);
+		}
 
-		usize step_i = 0;
-		for (const auto& steps : execution_steps | std::views::keys) {
-			const auto& barrier_groups = { CD3DX12_BARRIER_GROUP(static_cast<UINT32>(native_buffer_barriers.size()), native_buffer_barriers[step_i].data()),
-																																					CD3DX12_BARRIER_GROUP(static_cast<UINT32>(native_texture_barriers.size()), native_texture_barriers[step_i].data()) };
-			list.handle->Barrier(static_cast<UINT32>(barrier_groups.size()), data(barrier_groups));
-			for (const auto& command_index : steps) {
-				const auto& transition_barrier_group = { CD3DX12_BARRIER_GROUP(static_cast<UINT32>(native_command_level_transitions.size()), native_command_level_transitions[command_index].data())};
-				list.handle->Barrier(static_cast<UINT32>(transition_barrier_group.size()), data(barrier_groups));
-				recorder.do_command(list, linear_command_list[command_index]);
+		Compiled out;
+		out.topology_key = recorder.topology_key;
+		const auto num_replans = transients.stats.num_replans;
+		cull(out);
+		graphify(out);
+		flatten(out);
+		// other cached graphs baked in the native resources transients had before they were placed again
+		if (compiled_cache.size() >= max_cached_graphs || transients.stats.num_replans != num_replans) compiled_cache.clear();
+		compiled = &compiled_cache.insert_or_assign(hash, std::move(out)).first->second;
+		++cache_stats.misses;
+		cache_stats.miss_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+	}
+
+	auto CommandGraph::execute() -> void {
+		assert_log(compiled, "command graph has to be compiled before executing it");
+		assert_log(last_executed_frame != c.frame_number, "command graph executed twice in one frame, its lists are still being recorded or in flight");
+		last_executed_frame = c.frame_number;
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		const u64 heap_allocations_before = get_num_heap_allocations();
+		const auto& stream = recorder.command_stream;
+		// the view caches aren't thread safe, so everything recording looks up is resolved up front
+		recorder.resolve_views();
+		// views created since the last flush reach the shader visible heap before any list binds it
+		c.resource_registry.storage.flush();
+
+		const Submission* last_general = nullptr;
+		for (const auto& submission : compiled->submissions) {
+			if (submission.queue == QueueType::GENERAL) last_general = &submission;
+		}
+
+		const auto get_weight = [&](u32 command_index) -> u32 {
+			const auto& command = stream[command_index];
+			return command.type == CommandType::eDraw ? static_cast<u32>(recorder.draw_infos[command.index].commands.size()) + 1 : 1;
+		};
+		u32 total_weight = 0;
+		for (const auto& submission : compiled->submissions) {
+			for (const auto& step : submission.steps) {
+				for (const auto command_index : step.commands) total_weight += get_weight(command_index);
+			}
+		}
+		const u32 num_threads = std::clamp(max_recording_threads, 1u, c.workers->num_workers() + 1);
+		const u32 chunk_weight = std::max(min_recording_chunk_weight, (total_weight + num_threads - 1) / num_threads);
+
+		chunks.clear();
+		chunk_ranges.clear();
+		submission_chunks.clear();
+		const auto add_chunk = [&](const Submission& submission) {
+			const auto first_range = static_cast<u32>(chunk_ranges.size());
+			chunks.emplace_back(RecordChunk{ .submission = &submission, .first_range = first_range, .end_range = first_range });
+		};
+		const auto add_range = [&](const QueueStep& step, u32 begin, u32 end) {
+			chunk_ranges.emplace_back(ChunkRange{ .step = &step, .begin = begin, .end = end });
+			chunks.back().end_range = static_cast<u32>(chunk_ranges.size());
+		};
+		for (const auto& submission : compiled->submissions) {
+			const usize first_chunk = chunks.size();
+			add_chunk(submission);
+			u32 weight = 0;
+			for (const auto& step : submission.steps) {
+				u32 begin = 0;
+				for (u32 i = 0; i < static_cast<u32>(step.commands.size()); ++i) {
+					weight += get_weight(step.commands[i]);
+					if (weight < chunk_weight || step.split_pending) continue;
+					add_range(step, begin, i + 1);
+					add_chunk(submission);
+					begin = i + 1;
+					weight = 0;
+				}
+				if (begin < step.commands.size()) add_range(step, begin, static_cast<u32>(step.commands.size()));
+			}
+			if (chunks.back().first_range == chunks.back().end_range && chunks.size() - first_chunk > 1) chunks.pop_back();
+			submission_chunks.emplace_back(first_chunk, chunks.size());
+		}
+
+		// lists are handed out in submission order so the lists of one submission sit next to each other
+		if (frame_lists.size() < c.frames.size()) frame_lists.resize(c.frames.size());
+		auto& queue_lists = frame_lists[c.get_frame_index()];
+		std::array<usize, num_queue_types> num_lists{};
+		for (const auto& chunk : chunks) ++num_lists[static_cast<usize>(chunk.submission->queue)];
+		for (usize q = 0; q < num_queue_types; ++q) {
+			while (queue_lists[q].size() < num_lists[q]) queue_lists[q].emplace_back(c.get_queue(static_cast<QueueType>(q)).get_command_list());
+			num_lists[q] = 0;
+		}
+		for (auto& chunk : chunks) {
+			const auto q = static_cast<usize>(chunk.submission->queue);
+			chunk.list = &queue_lists[q][num_lists[q]++];
+		}
+		const RecordChunk* exit_chunk = nullptr;
+		for (const auto& chunk : chunks) {
+			if (chunk.submission == last_general) exit_chunk = &chunk;
+		}
+
+		const auto record_chunk = [&](const RecordChunk& chunk) {
+			auto& list = chunk.list->record();
+			for (u32 r = chunk.first_range; r < chunk.end_range; ++r) {
+				const auto& [step, begin, end] = chunk_ranges[r];
+				if (begin == 0) list.barrier(step->buffer_barriers, step->texture_barriers);
+				for (u32 i = begin; i < end; ++i) {
+					recorder.do_command(list, stream[step->commands[i]]);
+				}
+				if (end == step->commands.size()) list.barrier(step->split_buffer_barriers, step->split_texture_barriers);
+			}
+			if (&chunk == exit_chunk) list.barrier({}, compiled->native_exit_barriers);
+			list.finish();
+		};
+		// chunks are forced at every submission boundary, so there can be more of them than threads. the context's workers
+		// and this thread pull the next one until none are left
+		std::atomic<usize> next_chunk{ 0 };
+		c.workers->run(static_cast<u32>(std::min<usize>(num_threads, chunks.size())), [&](u32) {
+			for (usize i = next_chunk++; i < chunks.size(); i = next_chunk++) record_chunk(chunks[i]);
+		});
+
+		// futures still in flight are waited on by the first submission of every queue that touches their resource, reads
+		// on different queues aren't ordered against each other. per queue and submission the highest fence value is enough,
+		// a submission on the future's own queue is ordered behind it already
+		future_waits.clear();
+		bool any_pending = false;
+		if (!recorder.futures.empty()) {
+			if (++execute_stamp == 0) {
+				for (auto& pending : pending_futures) pending.stamp = 0;
+				execute_stamp = 1;
+			}
+			next_pending_future.assign(recorder.futures.size(), ~0u);
+			for (u32 f = 0; f < static_cast<u32>(recorder.futures.size()); ++f) {
+				const auto& future = recorder.futures[f];
+				if (future.ready()) continue;
+				const u32 slot = get_handle_index(future.res);
+				if (slot >= pending_futures.size()) pending_futures.resize(slot + 1);
+				auto& pending = pending_futures[slot];
+				if (pending.stamp == execute_stamp) {
+					next_pending_future[f] = pending.first_future;
+				} else {
+					pending.stamp = execute_stamp;
+					pending.covered = {};
+				}
+				pending.first_future = f;
+				any_pending = true;
+			}
+		}
+		if (any_pending) {
+			future_waits.assign(compiled->submissions.size(), QueueFences{});
+			const auto touch = [&](usize submission, Handle res) {
+				const u32 slot = get_handle_index(res);
+				if (slot >= pending_futures.size() || pending_futures[slot].stamp != execute_stamp) return;
+				auto& pending = pending_futures[slot];
+				const auto queue = compiled->submissions[submission].queue;
+				if (std::exchange(pending.covered[static_cast<usize>(queue)], true)) return;
+				for (u32 f = pending.first_future; f != ~0u; f = next_pending_future[f]) {
+					const auto& future = recorder.futures[f];
+					if (future.work_queue == queue) continue;
+					auto& value = future_waits[submission][static_cast<usize>(future.work_queue)];
+					value = std::max(value, future.fence_value);
+				}
+			};
+			for (usize i = 0; i < compiled->submissions.size(); ++i) {
+				for (const auto& step : compiled->submissions[i].steps) {
+					for (const auto command_index : step.commands) {
+						std::ranges::for_each(stream[command_index].reads, [&](Handle res) { touch(i, res); });
+						std::ranges::for_each(stream[command_index].writes, [&](Handle res) { touch(i, res); });
+					}
+				}
+			}
+		}
+		record_stats.num_future_waits = 0;
+
+		for (auto& values : signal_values) values.clear();
+		for (usize i = 0; i < compiled->submissions.size(); ++i) {
+			const auto& submission = compiled->submissions[i];
+			const auto q = static_cast<usize>(submission.queue);
+			auto& queue = c.get_queue(submission.queue);
+			const auto [first_chunk, end_chunk] = submission_chunks[i];
+
+			for (const auto& [src, signal] : submission.waits) {
+				queue.wait(c.get_queue(src), signal_values[static_cast<usize>(src)][signal]);
+			}
+			if (!future_waits.empty()) {
+				for (usize src = 0; src < num_queue_types; ++src) {
+					if (!future_waits[i][src]) continue;
+					queue.wait(c.get_queue(static_cast<QueueType>(src)), future_waits[i][src]);
+					++record_stats.num_future_waits;
+				}
+			}
+			queue.execute_lists(std::span(chunks[first_chunk].list, end_chunk - first_chunk));
+			if (submission.signal.has_value()) signal_values[q].emplace_back(queue.signal());
+		}
+
+		for (const auto& [src, signal] : compiled->exit_waits) {
+			c.general_queue.wait(c.get_queue(src), signal_values[static_cast<usize>(src)][signal]);
+		}
+
+		record_stats.num_lists = static_cast<u32>(chunks.size());
+		record_stats.num_allocations = static_cast<u32>(get_num_heap_allocations() - heap_allocations_before);
+		record_stats.execute_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+	}
+
+	auto CommandGraph::report_stats() const -> void {
+		if (compiled) {
+			const auto& stats = compiled->stats;
+			info_log("CommandGraph: {} commands ({} culled), {} edges -> {} steps, {} barriers ({} split) in {} Barrier() calls | graphify {:.3f} ms, flatten {:.3f} ms",
+				stats.num_commands, stats.num_culled_commands, stats.num_edges, stats.num_steps, stats.num_barriers, stats.num_split_barriers, stats.num_barrier_batches,
+				stats.graphify_ms, stats.flatten_ms);
+			info_log("CommandGraph queues: {} async commands, {} submissions, {} cross queue waits ({} redundant ones dropped)",
+				stats.num_async_commands, stats.num_submissions, stats.num_queue_waits, stats.num_skipped_waits);
+		}
+		if (const auto& stats = transients.stats; stats.num_placed) {
+			const auto saved = stats.dedicated_bytes - std::min(stats.heap_bytes, stats.dedicated_bytes);
+			info_log("CommandGraph transients: {} placed in {:.2f} MB instead of {:.2f} MB dedicated, {:.2f} MB ({:.1f}%) saved, placed {} times",
+				stats.num_placed, stats.heap_bytes / 1048576., stats.dedicated_bytes / 1048576., saved / 1048576.,
+				100. * saved / stats.dedicated_bytes, stats.num_replans);
+		}
+		if (const auto& stats = recorder.stats; stats.num_commands) {
+			info_log("CommandGraph recorder: {} commands in {:.0f} ns ({:.1f} ns per command), {} heap allocations, {:.1f} KB of {:.1f} KB arena used",
+				stats.num_commands, stats.record_ns, stats.record_ns / stats.num_commands, stats.num_allocations,
+				stats.arena_bytes / 1024., recorder.arena.capacity() / 1024.);
+		}
+		if (record_stats.num_lists) {
+			info_log("CommandGraph recording: {} lists recorded in parallel, {:.3f} ms to record and submit, {} waits on uploads in flight, {} heap allocations",
+				record_stats.num_lists, record_stats.execute_ms, record_stats.num_future_waits, record_stats.num_allocations);
+		}
+		const u32 lookups = cache_stats.hits + cache_stats.misses;
+		if (lookups) {
+			const double hit_ms = cache_stats.hits ? cache_stats.hit_ms / cache_stats.hits : 0.;
+			const double miss_ms = cache_stats.misses ? cache_stats.miss_ms / cache_stats.misses : 0.;
+			info_log("CommandGraph cache: {:.1f}% hit rate ({} / {}), {:.3f} ms per hit vs {:.3f} ms per compile, saves {:.3f} ms per cached frame, {} hash collisions",
+				100. * cache_stats.hits / lookups, cache_stats.hits, lookups, hit_ms, miss_ms, cache_stats.misses ? miss_ms - hit_ms : 0., cache_stats.collisions);
+		}
+	}
+
+	auto CommandGraph::estimate_command_costs() const -> std::vector<double> {
+		const auto& stream = recorder.command_stream;
+		std::vector<double> costs(stream.size(), 1.);
+		for (usize v = 0; v < stream.size(); ++v) {
+			if (stream[v].type == CommandType::eDraw) costs[v] += static_cast<double>(recorder.get_draw_info(stream[v]).commands.size());
+		}
+		return costs;
+	}
+
+	auto CommandGraph::find_critical_path(std::span<const double> costs) const -> CriticalPath {
+		assert_log(compiled, "command graph has to be compiled before looking for its critical path");
+		const auto num_commands = static_cast<u32>(recorder.command_stream.size());
+		assert_log(costs.size() == num_commands, "every recorded command needs a cost");
+
+		// the command stream is a topological order, so earliest finish times only need a single forward pass
+		std::vector<double> start(num_commands, 0.);
+		std::vector<double> finish(num_commands, 0.);
+		std::vector<u32> previous(num_commands, ~0u);
+		std::optional<u32> last;
+		for (u32 v = 0; v < num_commands; ++v) {
+			if (!compiled->live_commands[v]) continue;
+			finish[v] = start[v] + costs[v];
+			for (const auto& next : compiled->command_adj_list[v] | std::views::keys) {
+				if (finish[v] <= start[next]) continue;
+				start[next] = finish[v];
+				previous[next] = v;
+			}
+			if (!last || finish[v] > finish[*last]) last = v;
+		}
+
+		CriticalPath path;
+		for (auto v = last.value_or(~0u); v != ~0u; v = previous[v]) path.commands.emplace_back(v);
+		std::ranges::reverse(path.commands);
+		path.cost_us = last ? finish[*last] : 0.;
+		path.frame_us = simulate(*compiled, costs).end;
+		return path;
+	}
+
+	auto CommandGraph::export_trace(const char* path, std::span<const double> costs) const -> void {
+		assert_log(compiled, "command graph has to be compiled before exporting it");
+		const auto& stream = recorder.command_stream;
+		const bool estimated = costs.empty();
+		const auto estimated_costs = estimated ? estimate_command_costs() : std::vector<double>{};
+		if (estimated) costs = estimated_costs;
+
+		const auto timeline = simulate(*compiled, costs);
+		const auto critical_path = find_critical_path(costs);
+
+		// barriers only know their native resources
+		std::unordered_map<ID3D12Resource*, Handle> handles;
+		for (const auto& command : stream) {
+			for (const auto res : command.reads) handles.emplace(get_native_res(res), res);
+			for (const auto res : command.writes) handles.emplace(get_native_res(res), res);
+		}
+
+		std::ofstream out(path, std::ofstream::out | std::ofstream::trunc);
+		out << std::fixed << std::setprecision(3);
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+		bool first_event = true;
+		const auto event = [&]() -> std::ofstream& {
+			out << (first_event ? "" : ",\n");
+			first_event = false;
+			return out;
+		};
+
+		constexpr usize critical_path_lane = num_queue_types;
+		event() << R"({"name":"process_name","ph":"M","pid":0,"args":{"name":"CommandGraph"}})";
+		for (usize q = 0; q < num_queue_types; ++q) {
+			event() << R"({"name":"thread_name","ph":"M","pid":0,"tid":)" << q << R"(,"args":{"name":")" << queue_type_to_string(static_cast<QueueType>(q)) << "\"}}";
+		}
+		event() << R"({"name":"thread_name","ph":"M","pid":0,"tid":)" << critical_path_lane << R"(,"args":{"name":"critical path"}})";
+
+		const auto write_barriers = [&](const char* name, usize q, double ts, std::span<const D3D12_BUFFER_BARRIER> buffer_barriers,
+			std::span<const D3D12_TEXTURE_BARRIER> texture_barriers) {
+			if (buffer_barriers.empty() && texture_barriers.empty()) return;
+			event() << R"({"name":")" << name << R"(","cat":"barrier","ph":"i","s":"t","pid":0,"tid":)" << q << R"(,"ts":)" << ts << R"(,"args":{"barriers":[)";
+			bool first = true;
+			const auto write_common = [&](const auto& barrier) {
+				const auto it = handles.find(barrier.pResource);
+				out << (first ? "" : ",") << R"({"resource":)" << (it == handles.end() ? -1 : static_cast<long long>(it->second))
+					<< R"(,"sync_before":")" << sync_to_string(barrier.SyncBefore) << R"(","sync_after":")" << sync_to_string(barrier.SyncAfter)
+					<< R"(","access_before":")" << access_to_string(barrier.AccessBefore) << R"(","access_after":")" << access_to_string(barrier.AccessAfter) << "\"";
+				first = false;
+			};
+			for (const auto& barrier : buffer_barriers) {
+				write_common(barrier);
+				out << "}";
+			}
+			for (const auto& barrier : texture_barriers) {
+				write_common(barrier);
+				out << R"(,"layout_before":")" << layout_to_string(barrier.LayoutBefore) << R"(","layout_after":")" << layout_to_string(barrier.LayoutAfter)
+					<< R"(","discard":)" << ((barrier.Flags & D3D12_TEXTURE_BARRIER_FLAG_DISCARD) ? "true" : "false") << "}";
+			}
+			out << "]}}";
+		};
+
+		const Submission* last_general = nullptr;
+		double last_general_end = 0.;
+		u32 flow_id = 0;
+		for (usize i = 0; i < compiled->submissions.size(); ++i) {
+			const auto& submission = compiled->submissions[i];
+			const auto q = static_cast<usize>(submission.queue);
+
+			// cross queue waits as flow arrows from the signal to the waiting submission
+			for (const auto& [src, signal] : submission.waits) {
+				const auto src_q = static_cast<usize>(src);
+				event() << R"({"name":"wait","cat":"queue","ph":"s","id":)" << flow_id << R"(,"pid":0,"tid":)" << src_q << R"(,"ts":)" << timeline.signal_time[src_q][signal] << "}";
+				event() << R"({"name":"wait","cat":"queue","ph":"f","bp":"e","id":)" << flow_id << R"(,"pid":0,"tid":)" << q << R"(,"ts":)" << timeline.submission_start[i] << "}";
+				++flow_id;
+			}
+
+			for (usize j = 0; j < submission.steps.size(); ++j) {
+				const auto& step = submission.steps[j];
+				write_barriers("barriers", q, timeline.step_start[i][j], step.buffer_barriers, step.texture_barriers);
+				for (const auto v : step.commands) {
+					const auto& command = stream[v];
+					event() << R"({"name":")" << json_escape(recorder.get_debug_name(command)) << R"(","cat":")" << command_type_to_string(command.type)
+						<< R"(","ph":"X","pid":0,"tid":)" << q << R"(,"ts":)" << timeline.command_start[v] << R"(,"dur":)" << costs[v]
+						<< R"(,"args":{"command":)" << v << R"(,"step":)" << step.step << R"(,"reads":)" << command.reads.size()
+						<< R"(,"writes":)" << command.writes.size() << R"(,"estimated_cost":)" << (estimated ? "true" : "false") << "}}";
+				}
+				write_barriers("split barriers begin", q, timeline.step_end[i][j], step.split_buffer_barriers, step.split_texture_barriers);
 			}
-			++step_i;
+			if (submission.queue == QueueType::GENERAL) {
+				last_general = &submission;
+				last_general_end = timeline.step_end[i].back();
+			}
+		}
+		if (last_general) write_barriers("exit barriers", static_cast<usize>(QueueType::GENERAL), last_general_end, {}, compiled->native_exit_barriers);
+
+		double t = 0.;
+		for (const auto v : critical_path.commands) {
+			event() << R"({"name":")" << json_escape(recorder.get_debug_name(stream[v])) << R"(","cat":"critical path","ph":"X","pid":0,"tid":)" << critical_path_lane
+				<< R"(,"ts":)" << t << R"(,"dur":)" << costs[v] << R"(,"args":{"command":)" << v << "}}";
+			t += costs[v];
+		}
+		out << "\n]}\n";
+
+		std::string names;
+		for (const auto v : critical_path.commands) {
+			if (!names.empty()) names += " -> ";
+			names += recorder.get_debug_name(stream[v]);
 		}
+		// whatever the frame takes beyond its critical path is commands waiting on their queue, not on their inputs
+		info_log("CommandGraph critical path: {:.3f} us over {} commands, the submitted frame takes {:.3f} us ({:.1f}% queue serialization){}: {}",
+			critical_path.cost_us, critical_path.commands.size(), critical_path.frame_us,
+			critical_path.frame_us > 0. ? 100. * (critical_path.frame_us - critical_path.cost_us) / critical_path.frame_us : 0.,
+			estimated ? ", estimated costs" : "", names);
 	}
 
 	auto CommandGraph::visualize_graph_to_image(const char* name) -> void {
@@ -359,15 +1523,14 @@ namespace d {
 		out.open(name, std::ofstream::out | std::ofstream::app);
 		out << "digraph G { \n";
 
+		assert_log(compiled, "command graph has to be compiled before visualizing it");
 		usize v0 = 0;
-		for (const auto& links : command_adj_list) {
+		for (const auto& links : compiled->command_adj_list) {
 			auto& c0 = recorder.command_stream[v0];
-			std::string_view name0;
-			if (c0.type == CommandType::eDraw) name0 = recorder.get_draw_info(c0).debug_name;
+			const auto name0 = recorder.get_debug_name(c0);
 			for (const auto& v1 : links | std::views::keys) {
 				auto& c1 = recorder.command_stream[v1];
-				std::string_view name1;
-				if (c1.type == CommandType::eDraw) name1 = recorder.get_draw_info(c1).debug_name;
+				const auto name1 = recorder.get_debug_name(c1);
 
 				out << name0 << " -> " << name1 << "\n";
 			}
@@ -2,27 +2,192 @@
 #include "d/Context.h"
 #include "d/Logging.h"
 
+#include <array>
+
 namespace d {
+	auto CommandListStats::operator+=(const CommandListStats& o) -> CommandListStats& {
+		num_draws += o.num_draws;
+		num_dispatches += o.num_dispatches;
+		num_copies += o.num_copies;
+		num_barrier_calls += o.num_barrier_calls;
+		num_barriers += o.num_barriers;
+		num_state_changes += o.num_state_changes;
+		copy_bytes += o.copy_bytes;
+		push_constant_bytes += o.push_constant_bytes;
+		return *this;
+	}
+
 	auto CommandList::record() -> CommandList& {
+		stats = {};
+		if (null) return *this;
 		DX_CHECK(allocator->Reset());
 		DX_CHECK(handle->Reset(allocator.Get(), nullptr));
 		return *this;
 	}
 
 	auto CommandList::finish() -> CommandList& {
+		if (null) return *this;
 		DX_CHECK(handle->Close());
 		return *this;
 	}
 
-	auto CommandList::copy_buffer_region(Resource<Buffer> src, Resource<Buffer> dst, usize size, u32 src_offset, u32 dst_offset) -> CommandList& {
+	auto CommandList::set_viewport(u32 width, u32 height) -> CommandList& {
+		++stats.num_state_changes;
+		if (null) return *this;
+		const auto viewport = D3D12_VIEWPORT{
+				.TopLeftX = 0.,
+				.TopLeftY = 0.,
+				.Width = static_cast<float>(width),
+				.Height = static_cast<float>(height),
+				.MinDepth = 0.f,
+				.MaxDepth = 1.f,
+		};
+		const auto scissor = D3D12_RECT{
+				.left = 0,
+				.top = 0,
+				.right = static_cast<long>(width),
+				.bottom = static_cast<long>(height),
+		};
+		handle->RSSetViewports(1, &viewport);
+		handle->RSSetScissorRects(1, &scissor);
+		return *this;
+	}
+
+	auto CommandList::copy_buffer_region(Resource<Buffer> src, Resource<Buffer> dst, usize size, u64 src_offset, u64 dst_offset) -> CommandList& {
+		++stats.num_copies;
+		stats.copy_bytes += size;
+		if (null) return *this;
 		handle->CopyBufferRegion(d::get_native_res(dst), dst_offset, d::get_native_res(src), src_offset, size);
 		return *this;
 	}
 
-	//auto CommandList::copy_image(Resource<D2> src, Resource<D2> dst)-> CommandList& {
-	//	handle->CopyResource(get_native_res(dst), get_native_res(src));
-	//	return *this;
-	//}
+	auto CommandList::copy_image(Resource<D2> src, Resource<D2> dst)-> CommandList& {
+		++stats.num_copies;
+		if (null) return *this;
+		handle->CopyResource(get_native_res(dst), get_native_res(src));
+		return *this;
+	}
+
+	auto CommandList::copy_texture_region(Resource<Buffer> src, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint, Handle dst, u32 subresource) -> CommandList& {
+		++stats.num_copies;
+		stats.copy_bytes += static_cast<u64>(footprint.Footprint.RowPitch) * footprint.Footprint.Height * footprint.Footprint.Depth;
+		if (null) return *this;
+		const auto src_location = CD3DX12_TEXTURE_COPY_LOCATION(get_native_res(src), footprint);
+		const auto dst_location = CD3DX12_TEXTURE_COPY_LOCATION(get_native_res(dst), subresource);
+		handle->CopyTextureRegion(&dst_location, 0, 0, 0, &src_location, nullptr);
+		return *this;
+	}
+
+	auto CommandList::copy_texture_to_buffer(Handle src, u32 subresource, const D3D12_BOX& box, Resource<Buffer> dst, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint) -> CommandList& {
+		++stats.num_copies;
+		stats.copy_bytes += static_cast<u64>(footprint.Footprint.RowPitch) * footprint.Footprint.Height * footprint.Footprint.Depth;
+		if (null) return *this;
+		const auto src_location = CD3DX12_TEXTURE_COPY_LOCATION(get_native_res(src), subresource);
+		const auto dst_location = CD3DX12_TEXTURE_COPY_LOCATION(get_native_res(dst), footprint);
+		handle->CopyTextureRegion(&dst_location, 0, 0, 0, &src_location, &box);
+		return *this;
+	}
+
+	auto CommandList::barrier(std::span<const D3D12_BUFFER_BARRIER> buffer_barriers, std::span<const D3D12_TEXTURE_BARRIER> texture_barriers) -> CommandList& {
+		if (buffer_barriers.empty() && texture_barriers.empty()) return *this;
+		++stats.num_barrier_calls;
+		stats.num_barriers += static_cast<u32>(buffer_barriers.size() + texture_barriers.size());
+		if (null) return *this;
+
+		std::array<D3D12_BARRIER_GROUP, 2> groups{};
+		u32 num_groups = 0;
+		if (!buffer_barriers.empty()) groups[num_groups++] = CD3DX12_BARRIER_GROUP(static_cast<UINT32>(buffer_barriers.size()), buffer_barriers.data());
+		if (!texture_barriers.empty()) groups[num_groups++] = CD3DX12_BARRIER_GROUP(static_cast<UINT32>(texture_barriers.size()), texture_barriers.data());
+		handle->Barrier(num_groups, groups.data());
+		return *this;
+	}
+
+	auto CommandList::set_render_targets(std::span<const D3D12_CPU_DESCRIPTOR_HANDLE> render_targets, const D3D12_CPU_DESCRIPTOR_HANDLE* depth_target) -> CommandList& {
+		++stats.num_state_changes;
+		if (null) return *this;
+		handle->OMSetRenderTargets(static_cast<UINT>(render_targets.size()), render_targets.data(), false, depth_target);
+		return *this;
+	}
+
+	auto CommandList::set_pipeline(const GraphicsPipeline& pl) -> CommandList& {
+		++stats.num_state_changes;
+		if (null) return *this;
+		handle->SetPipelineState(pl.get_native());
+		handle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		handle->SetDescriptorHeaps(1, c.resource_registry.storage.bindless.heap.GetAddressOf());
+		handle->SetGraphicsRootSignature(pl.root_signature.Get());
+		return *this;
+	}
+
+	auto CommandList::set_pipeline(const ComputePipeline& pl) -> CommandList& {
+		++stats.num_state_changes;
+		if (null) return *this;
+		handle->SetPipelineState(pl.get_native());
+		handle->SetDescriptorHeaps(1, c.resource_registry.storage.bindless.heap.GetAddressOf());
+		handle->SetComputeRootSignature(pl.root_signature.Get());
+		return *this;
+	}
+
+	auto CommandList::set_pipeline(const RayTracingPipeline& pl) -> CommandList& {
+		++stats.num_state_changes;
+		if (null) return *this;
+		handle->SetPipelineState1(pl.get_native());
+		handle->SetDescriptorHeaps(1, c.resource_registry.storage.bindless.heap.GetAddressOf());
+		handle->SetComputeRootSignature(pl.global_root_signature.Get());
+		return *this;
+	}
+
+	auto CommandList::set_graphics_push_constants(std::span<const std::byte> push_constants) -> CommandList& {
+		stats.push_constant_bytes += push_constants.size();
+		if (null || push_constants.empty()) return *this;
+		handle->SetGraphicsRoot32BitConstants(0, static_cast<UINT>(push_constants.size() / 4), push_constants.data(), 0);
+		return *this;
+	}
+
+	auto CommandList::set_compute_push_constants(std::span<const std::byte> push_constants) -> CommandList& {
+		stats.push_constant_bytes += push_constants.size();
+		if (null || push_constants.empty()) return *this;
+		handle->SetComputeRoot32BitConstants(0, static_cast<UINT>(push_constants.size() / 4), push_constants.data(), 0);
+		return *this;
+	}
+
+	auto CommandList::draw_indexed(const D3D12_INDEX_BUFFER_VIEW& ibo_view, u32 index_count, u32 instance_count, u32 start_index) -> CommandList& {
+		++stats.num_draws;
+		++stats.num_state_changes;
+		if (null) return *this;
+		handle->IASetIndexBuffer(&ibo_view);
+		handle->DrawIndexedInstanced(index_count, instance_count, start_index, 0, 0);
+		return *this;
+	}
+
+	auto CommandList::dispatch(u32 x, u32 y, u32 z) -> CommandList& {
+		++stats.num_dispatches;
+		if (null) return *this;
+		handle->Dispatch(x, y, z);
+		return *this;
+	}
+
+	auto CommandList::dispatch_indirect(Resource<Buffer> args, u32 offset) -> CommandList& {
+		++stats.num_dispatches;
+		if (null) return *this;
+		handle->ExecuteIndirect(c.dispatch_indirect_signature.Get(), 1, get_native_res(args), offset, nullptr, 0);
+		return *this;
+	}
+
+	auto CommandList::dispatch_rays(const RayTracingPipeline& pl, const TextureExtent& extent) -> CommandList& {
+		++stats.num_dispatches;
+		if (null) return *this;
+		const auto desc = D3D12_DISPATCH_RAYS_DESC{
+			.RayGenerationShaderRecord = pl.sbt.p_ray_gen,
+			.MissShaderTable = pl.sbt.p_miss_group_section,
+			.HitGroupTable = pl.sbt.p_hit_group_section,
+			.Width = extent.width,
+			.Height = extent.height,
+			.Depth = extent.depth,
+		};
+		handle->DispatchRays(&desc);
+		return *this;
+	}
 
 	//auto CommandList::clear_image(Resource<D2> image, float color[4]) -> CommandList& {
 	//	auto h = image.rtv_view({}).desc_handle();
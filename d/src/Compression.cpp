@@ -0,0 +1,180 @@
+#include "d/Compression.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace d {
+
+	namespace {
+		constexpr usize lz4_min_match = 4;
+		// the format wants the last 5 bytes as literals and no match starting in the last 12
+		constexpr usize lz4_last_literals = 5;
+		constexpr usize lz4_match_start_limit = 12;
+		constexpr usize lz4_max_offset = 65535;
+		constexpr u32 lz4_hash_bits = 16;
+
+		auto load_u32(const std::byte* p) -> u32 {
+			u32 v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		auto write_length(std::vector<std::byte>& dst, usize length) -> void {
+			for (length -= 15; length >= 255; length -= 255) dst.emplace_back(std::byte{ 255 });
+			dst.emplace_back(static_cast<std::byte>(length));
+		}
+
+		auto emit_sequence(std::vector<std::byte>& dst, std::span<const std::byte> literals, usize offset, usize match_length) -> void {
+			const usize lit = literals.size();
+			const usize ml = match_length ? match_length - lz4_min_match : 0;
+			dst.emplace_back(static_cast<std::byte>(std::min<usize>(lit, 15) << 4 | std::min<usize>(ml, 15)));
+			if (lit >= 15) write_length(dst, lit);
+			dst.insert(dst.end(), literals.begin(), literals.end());
+			if (!match_length) return;
+			dst.emplace_back(static_cast<std::byte>(offset & 0xff));
+			dst.emplace_back(static_cast<std::byte>(offset >> 8));
+			if (ml >= 15) write_length(dst, ml);
+		}
+
+		// false if the length runs past the end of the input
+		auto read_length(const std::byte*& ip, const std::byte* end, usize& length) -> bool {
+			if (length != 15) return true;
+			u8 b;
+			do {
+				if (ip == end) return false;
+				b = static_cast<u8>(*ip++);
+				length += b;
+			} while (b == 255);
+			return true;
+		}
+	}
+
+	auto lz4_compress_block(std::span<const std::byte> src, std::vector<std::byte>& dst) -> void {
+		const usize n = src.size();
+		const std::byte* data = src.data();
+		usize anchor = 0;
+		if (n > lz4_match_start_limit) {
+			// last position seen per hashed 4 byte sequence, offsets are +1 so 0 is empty
+			std::vector<u32> table(1u << lz4_hash_bits, 0);
+			const usize match_start_limit = n - lz4_match_start_limit;
+			const usize match_end_limit = n - lz4_last_literals;
+			for (usize i = 0; i < match_start_limit;) {
+				const u32 seq = load_u32(data + i);
+				auto& slot = table[(seq * 2654435761u) >> (32 - lz4_hash_bits)];
+				const usize candidate = slot;
+				slot = static_cast<u32>(i + 1);
+				if (candidate == 0 || i - (candidate - 1) > lz4_max_offset || load_u32(data + candidate - 1) != seq) {
+					++i;
+					continue;
+				}
+				const usize match = candidate - 1;
+				usize length = lz4_min_match;
+				while (i + length < match_end_limit && data[match + length] == data[i + length]) ++length;
+				emit_sequence(dst, src.subspan(anchor, i - anchor), i - match, length);
+				i += length;
+				anchor = i;
+			}
+		}
+		emit_sequence(dst, src.subspan(anchor), 0, 0);
+	}
+
+	auto lz4_decompress_block(std::span<const std::byte> src, std::span<std::byte> dst) -> bool {
+		const std::byte* ip = src.data();
+		const std::byte* const ip_end = ip + src.size();
+		std::byte* op = dst.data();
+		std::byte* const op_end = op + dst.size();
+		while (ip < ip_end) {
+			const auto token = static_cast<u8>(*ip++);
+			usize literals = token >> 4;
+			if (!read_length(ip, ip_end, literals)) return false;
+			if (literals > static_cast<usize>(ip_end - ip) || literals > static_cast<usize>(op_end - op)) return false;
+			std::memcpy(op, ip, literals);
+			ip += literals;
+			op += literals;
+			// the last sequence has no match
+			if (ip == ip_end) break;
+
+			if (ip_end - ip < 2) return false;
+			const usize offset = static_cast<usize>(ip[0]) | static_cast<usize>(ip[1]) << 8;
+			ip += 2;
+			if (offset == 0 || offset > static_cast<usize>(op - dst.data())) return false;
+			usize length = token & 15;
+			if (!read_length(ip, ip_end, length)) return false;
+			length += lz4_min_match;
+			if (length > static_cast<usize>(op_end - op)) return false;
+			const std::byte* match = op - offset;
+			if (offset >= length) {
+				std::memcpy(op, match, length);
+				op += length;
+			}
+			else {
+				// overlapping, repeats the last offset bytes
+				for (usize i = 0; i < length; ++i) *op++ = match[i];
+			}
+		}
+		return op == op_end;
+	}
+
+	auto parse_payload(std::span<const std::byte> payload) -> std::optional<std::pair<PayloadHeader, std::vector<PayloadChunk>>> {
+		PayloadHeader header;
+		if (payload.size() < sizeof(header)) return std::nullopt;
+		std::memcpy(&header, payload.data(), sizeof(header));
+		if (header.magic != payload_magic || header.chunk_size == 0) return std::nullopt;
+		if (header.num_chunks != (header.size + header.chunk_size - 1) / header.chunk_size) return std::nullopt;
+
+		const usize sizes_offset = sizeof(header);
+		usize offset = sizes_offset + sizeof(u32) * header.num_chunks;
+		if (payload.size() < offset) return std::nullopt;
+		std::vector<PayloadChunk> chunks(header.num_chunks);
+		for (u32 i = 0; i < header.num_chunks; ++i) {
+			u32 compressed_size;
+			std::memcpy(&compressed_size, payload.data() + sizes_offset + sizeof(u32) * i, sizeof(u32));
+			if (payload.size() - offset < compressed_size) return std::nullopt;
+			const u64 dst_offset = static_cast<u64>(i) * header.chunk_size;
+			chunks[i] = PayloadChunk{
+				.src = payload.subspan(offset, compressed_size),
+				.dst_offset = dst_offset,
+				.size = static_cast<u32>(std::min<u64>(header.chunk_size, header.size - dst_offset)),
+			};
+			offset += compressed_size;
+		}
+		return std::make_pair(header, std::move(chunks));
+	}
+
+	auto decompress_chunk(PayloadCodec codec, std::span<const std::byte> src, std::span<std::byte> dst) -> bool {
+		if (codec == PayloadCodec::eStored || src.size() == dst.size()) {
+			if (src.size() != dst.size()) return false;
+			std::memcpy(dst.data(), src.data(), dst.size());
+			return true;
+		}
+		if (codec == PayloadCodec::eLZ4) return lz4_decompress_block(src, dst);
+		return false;
+	}
+
+	auto compress_payload(std::span<const std::byte> data, PayloadCodec codec, u32 chunk_size) -> std::vector<std::byte> {
+		PayloadHeader header{
+			.codec = codec,
+			.chunk_size = chunk_size,
+			.num_chunks = static_cast<u32>((data.size() + chunk_size - 1) / chunk_size),
+			.size = data.size(),
+		};
+		std::vector<u32> sizes(header.num_chunks);
+		std::vector<std::byte> chunks;
+		std::vector<std::byte> compressed;
+		for (u32 i = 0; i < header.num_chunks; ++i) {
+			const auto chunk = data.subspan(static_cast<usize>(i) * chunk_size, std::min<usize>(chunk_size, data.size() - static_cast<usize>(i) * chunk_size));
+			compressed.clear();
+			if (codec == PayloadCodec::eLZ4) lz4_compress_block(chunk, compressed);
+			// chunks that don't shrink are stored, which is also what tells the decompressor apart
+			if (codec == PayloadCodec::eStored || compressed.size() >= chunk.size()) compressed.assign(chunk.begin(), chunk.end());
+			sizes[i] = static_cast<u32>(compressed.size());
+			chunks.insert(chunks.end(), compressed.begin(), compressed.end());
+		}
+
+		std::vector<std::byte> payload(sizeof(header) + sizeof(u32) * sizes.size());
+		std::memcpy(payload.data(), &header, sizeof(header));
+		std::memcpy(payload.data() + sizeof(header), sizes.data(), sizeof(u32) * sizes.size());
+		payload.insert(payload.end(), chunks.begin(), chunks.end());
+		return payload;
+	}
+}
@@ -1,10 +1,6 @@
-#define GLFW_EXPOSE_NATIVE_WIN32
-
 #include "d/Context.h"
 
-#include <GLFW/glfw3.h>
-#include <GLFW/glfw3native.h>
-
+#include <chrono>
 #include <variant>
 
 #include "d/Logging.h"
@@ -13,255 +9,511 @@ namespace d {
 
 	Context c;
 
-	void Context::init(GLFWwindow* window, u32 sc_count) {
-		DX_CHECK(D3D12GetDebugInterface(IID_PPV_ARGS(&debug_interface)));
-		debug_interface->EnableDebugLayer();
-		DX_CHECK(debug_interface->QueryInterface(IID_PPV_ARGS(&debug_interface1)));
-		debug_interface1->SetEnableGPUBasedValidation(true);
-		debug_interface1->SetEnableSynchronizedCommandQueueValidation(true);
-
-		UINT factory_flags = 0u;
-#ifdef _DEBUG
-		factory_flags |= DXGI_CREATE_FACTORY_DEBUG;
-#endif
-		DX_CHECK(CreateDXGIFactory2(factory_flags, IID_PPV_ARGS(&factory)));
-
-		// pick device
-		{
-			SIZE_T max_v_ram = 0u;
-
-			ComPtr<IDXGIAdapter1> adapter;
-			u32 suitable_adapter = 0u;
-			for (UINT i = 0;
-				factory->EnumAdapters1(i, &adapter) != DXGI_ERROR_NOT_FOUND; ++i) {
-				DXGI_ADAPTER_DESC1 adapter_desc;
-				adapter->GetDesc1(&adapter_desc);
-
-				if ((adapter_desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) == 0 &&
-					SUCCEEDED(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0,
-						__uuidof(ID3D12Device), nullptr)) &&
-					adapter_desc.DedicatedVideoMemory > max_v_ram) {
-					max_v_ram = adapter_desc.DedicatedVideoMemory;
-					suitable_adapter = i;
-				}
-				info_log(L"Adapter {}: {}", i, adapter_desc.Description,
-					adapter_desc.DedicatedVideoMemory);
-			}
-			info_log("Picked device: {}", suitable_adapter);
-			factory->EnumAdapters1(suitable_adapter, &adapter);
-			DX_CHECK(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0,
-				IID_PPV_ARGS(&device)));
-
-			auto allocator_desc = D3D12MA::ALLOCATOR_DESC{
-					.pDevice = device.Get(),
-					.pAdapter = adapter.Get(),
-			};
-
-			DX_CHECK(D3D12MA::CreateAllocator(&allocator_desc, &allocator));
-		}
+	auto Context::init_headless(u32 width, u32 height, u32 sc_count, u32 frames_in_flight) -> void {
+		headless = true;
+		headless_stats = {};
+		workers = std::make_unique<WorkerPool>(std::max(std::thread::hardware_concurrency(), 1u) - 1);
 
-		// create command general command queue
 		general_queue.init(QueueType::GENERAL);
-		main_command_list = general_queue.get_command_list();
+		async_compute_queue.init(QueueType::ASYNC_COMPUTE);
+		async_transfer_queue.init(QueueType::ASYNC_TRANSFER);
+		init_frames(frames_in_flight);
 
-		int width, height;
-		glfwGetWindowSize(window, &width, &height);
 		swap_chain.image_index = 0;
 		swap_chain.width = width;
 		swap_chain.height = height;
 		swap_chain.format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		DXGI_SWAP_CHAIN_DESC1 sc_desc = {
-				.Width = swap_chain.width,
-				.Height = swap_chain.height,
-				.Format = swap_chain.format,
-				.Stereo = FALSE,
-				.SampleDesc = {1, 0},
-				.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT,
-				.BufferCount = sc_count,
-				.Scaling = DXGI_SCALING_STRETCH,
-				.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD,
-				.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED,
-				.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING,
-		};
-
-		// create swap_chain and RTV ( render target views);
-		HWND win_handle = glfwGetWin32Window(window);
-		DX_CHECK(factory->CreateSwapChainForHwnd(general_queue.handle.Get(),
-			win_handle, &sc_desc, nullptr,
-			nullptr, &swap_chain.swapchain));
-		DX_CHECK(factory->MakeWindowAssociation(win_handle, DXGI_MWA_NO_ALT_ENTER));
-
-		general_q.init(QueueType::GENERAL);
-
-		asset_lib.init();
 
-		c.resource_registry.storage.init(100);
+		resource_registry.storage.init(4096, 16384, 256);
+		upload_ring.init(default_upload_ring_size);
+		readback_ring.init(default_readback_ring_size);
 
 		swap_chain.images.reserve(sc_count);
 		for (u32 i = 0; i < sc_count; ++i) {
-			ComPtr<ID3D12Resource> image;
-			ComPtr<D3D12MA::Allocation> empty_allocation;
-
-			DX_CHECK(swap_chain.swapchain->GetBuffer(i, IID_PPV_ARGS(&image)));
-			auto res = Resource<D2>(register_resource(image, empty_allocation, ResourceState{ .type = ResourceType::D2, .access_state = D3D12_BARRIER_ACCESS_COMMON}));
+			auto res = Resource<D2>(register_resource(nullptr, nullptr, ResourceState{ .type = ResourceType::D2, .access_state = D3D12_BARRIER_ACCESS_COMMON }));
+			resource_registry.cold[get_handle_index(res)].headless_desc = CD3DX12_RESOURCE_DESC::Tex2D(swap_chain.format, width, height, 1, 1,
+				1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
 			swap_chain.images.push_back(res);
+			auto image_view_handle = res.rtv_view({}).desc_handle();
+		}
+	}
 
-			// initialize cache
-			auto image_view_handle = swap_chain.images[i].rtv_view({})
-				.desc_handle();
+	auto Context::get_queue(QueueType type) -> Queue& {
+		switch (type) {
+		case QueueType::ASYNC_COMPUTE: return async_compute_queue;
+		case QueueType::ASYNC_TRANSFER: return async_transfer_queue;
+		default: return general_queue;
 		}
+	}
+
+	auto Context::init_frames(u32 frames_in_flight) -> void {
+		assert_log(frames_in_flight > 0, "at least one frame has to be in flight");
+		frames.clear();
+		frames.resize(frames_in_flight);
+		for (auto& frame : frames) frame.main_command_list = general_queue.get_command_list();
+		frame_number = 0;
+		frame_stats = {};
+	}
+
+	auto Context::get_fences() -> QueueFences {
+		QueueFences fences{};
+		for (usize q = 0; q < num_queue_types; ++q) {
+			auto& queue = get_queue(static_cast<QueueType>(q));
+			if (queue.unsignaled_work) queue.signal();
+			fences[q] = queue.fence_val;
+		}
+		return fences;
+	}
+
+	auto Context::fences_completed(const QueueFences& fences) -> bool {
+		for (usize q = 0; q < num_queue_types; ++q) {
+			if (get_queue(static_cast<QueueType>(q)).get_completed_value() < fences[q]) return false;
+		}
+		return true;
+	}
 
+	auto Context::wait_for_fences(const QueueFences& fences) -> void {
+		if (fences_completed(fences)) return;
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		for (usize q = 0; q < num_queue_types; ++q) get_queue(static_cast<QueueType>(q)).block_until(fences[q]);
+		++frame_stats.num_cpu_waits;
+		frame_stats.cpu_wait_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+	}
+
+	auto Context::report_stats() -> void {
+		if (frame_stats.num_frames) {
+			info_log("Context frames: {} frames with {} in flight, the cpu waited on the gpu {} times for {:.3f} ms",
+				frame_stats.num_frames, frames.size(), frame_stats.num_cpu_waits, frame_stats.cpu_wait_ms);
+		}
+		resource_registry.report_stats();
+		upload_ring.report_stats();
+		readback_ring.report_stats();
+		if (!headless) return;
+
+		// without a gpu the null queues are the only place that sees what would have been submitted
+		for (const auto type : { QueueType::GENERAL, QueueType::ASYNC_COMPUTE, QueueType::ASYNC_TRANSFER }) {
+			const auto& stats = get_queue(type).stats;
+			if (!stats.num_submissions) continue;
+			const auto& cmds = stats.commands;
+			info_log("Context null {} queue: {} submissions of {} lists, {} signals, {} waits | {} draws, {} dispatches, {} copies ({:.2f} MB), {} barriers in {} calls, {} state changes, {:.1f} KB push constants",
+				queue_type_to_string(type), stats.num_submissions, stats.num_lists, stats.num_signals, stats.num_waits,
+				cmds.num_draws, cmds.num_dispatches, cmds.num_copies, cmds.copy_bytes / 1048576., cmds.num_barriers, cmds.num_barrier_calls,
+				cmds.num_state_changes, cmds.push_constant_bytes / 1024.);
+		}
+		info_log("Context null device: {} resources ({:.2f} MB), {} views, {:.2f} MB mapped",
+			headless_stats.num_resources, headless_stats.resource_bytes / 1048576., headless_stats.num_views, headless_stats.mapped_bytes / 1048576.);
 	}
 
 	[[nodiscard]] std::pair<Resource<D2>, CommandList&>
 		Context::BeginRendering() {
+		auto& frame = frames[get_frame_index()];
+		// only blocks once the ring wrapped onto a frame the gpu is still working on
+		wait_for_fences(frame.fences);
+		resource_registry.collect_releases();
+		resource_registry.storage.bindless.reclaim();
+		upload_ring.reclaim();
+		readback_ring.deliver();
+
 		// start rendering
-		main_command_list.record();
-
-		auto screen_viewport = D3D12_VIEWPORT{
-				.TopLeftX = 0.,
-				.TopLeftY = 0.,
-				.Width = static_cast<float>(swap_chain.width),
-				.Height = static_cast<float>(swap_chain.height),
-				.MinDepth = 0.f,
-				.MaxDepth = 1.f,
-		};
-		auto screen_scissor =
-			D3D12_RECT{ .left = 0,
-								 .top = 0,
-								 .right = static_cast<long>(swap_chain.width),
-								 .bottom = static_cast<long>(swap_chain.height) };
-		main_command_list.handle->RSSetViewports(1, &screen_viewport);
-		main_command_list.handle->RSSetScissorRects(1, &screen_scissor);
+		frame.main_command_list.record()
+			.set_viewport(swap_chain.width, swap_chain.height);
 
 		const u32& image_index = swap_chain.image_index;
 
 		//main_command_list.transition(swap_chain.images[image_index], D3D12_RESOURCE_STATE_RENDER_TARGET);
 
-		return std::make_pair(swap_chain.images[image_index], std::ref(main_command_list));
+		return std::make_pair(swap_chain.images[image_index], std::ref(frame.main_command_list));
 	}
 
 	void Context::EndRendering() {
 		u32& image_index = swap_chain.image_index;
+		auto& frame = frames[get_frame_index()];
 
 		//main_command_list.transition(swap_chain.images[image_index], D3D12_RESOURCE_STATE_PRESENT);
 
-		main_command_list.finish();
-		general_queue.submit_lists({ main_command_list });
+		frame.main_command_list.finish();
+		resource_registry.storage.flush();
+		general_queue.submit_lists({ frame.main_command_list });
+		// behind the frame's work, so the readbacks requested during it see its results
+		readback_ring.submit();
+		resource_registry.storage.bindless.end_frame();
+		frame.fences = get_fences();
 
-		DX_CHECK(swap_chain.swapchain->Present(0, 0));
+		if (!headless) DX_CHECK(swap_chain.swapchain->Present(0, 0));
 		image_index = (image_index + 1u) % swap_chain.images.size();
-
-		// FLUSH COMMAND QUEUE TODO: have in_flight images
-		general_queue.block_until_idle();
+		++frame_number;
+		++frame_stats.num_frames;
 	}
 
-	auto InitContext(GLFWwindow* window, u32 sc_count) -> std::pair<ResourceRegistry&, AssetLibrary&> {
+	auto InitHeadlessContext(u32 width, u32 height, u32 sc_count, u32 frames_in_flight) -> ResourceRegistry& {
 		c = d::Context();
-		c.init(window, 3);
-		return std::make_pair(std::ref(c.resource_registry), std::ref(c.asset_lib));
+		c.init_headless(width, height, sc_count, frames_in_flight);
+		return c.resource_registry;
 	}
 
-	void DescriptorStorage::init(const u32 num_desc) {
-		bindable_desc_heap.init(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, num_desc);
-		render_target_heap.init(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, num_desc);
-		depth_stencil_heap.init(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, num_desc);
+	namespace {
+		auto create_descriptor_heap(D3D12_DESCRIPTOR_HEAP_TYPE type, u32 num_desc, bool shader_visible) -> ComPtr<ID3D12DescriptorHeap> {
+			const D3D12_DESCRIPTOR_HEAP_DESC heap_desc = {
+					.Type = type,
+					.NumDescriptors = num_desc,
+					.Flags = shader_visible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
+			};
+			ComPtr<ID3D12DescriptorHeap> heap;
+			DX_CHECK(c.device->CreateDescriptorHeap(&heap_desc, IID_PPV_ARGS(&heap)));
+			return heap;
+		}
 	}
 
-	void DescriptorHeap::init(D3D12_DESCRIPTOR_HEAP_TYPE type, u32 num_desc) {
-		const D3D12_DESCRIPTOR_HEAP_DESC heap_desc = {
-				.Type = type,
-				.NumDescriptors = num_desc,
-				.Flags = type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV
-										 ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE
-										 : D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
-		};
+	void DescriptorStorage::init(u32 num_bindable, u32 num_frame_bindable, u32 num_targets) {
+		bindable_desc_heap.init(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, num_bindable, max_bindless_descriptors - num_frame_bindable);
+		bindable_desc_heap.shader_index_offset = num_frame_bindable;
+		bindable_desc_heap.track_dirty = true;
+		render_target_heap.init(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, num_targets);
+		depth_stencil_heap.init(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, num_targets);
+		bindless.init(num_frame_bindable);
+		flush();
+	}
+
+	void DescriptorHeap::init(D3D12_DESCRIPTOR_HEAP_TYPE type, u32 num_desc, u32 max_num_desc) {
+		this->type = type;
+		size = 0;
+		capacity = num_desc;
+		max_capacity = std::max(num_desc, max_num_desc);
+		free_indices.clear();
+		owner_slots.clear();
+		dirty_indices.clear();
+		rewritten = false;
+		if (c.headless) {
+			// descriptor handles are plain indices
+			start = D3D12_CPU_DESCRIPTOR_HANDLE{ .ptr = 0 };
+			end = start;
+			stride = 1;
+			return;
+		}
 
-		DX_CHECK(
-			c.device->CreateDescriptorHeap(&heap_desc, IID_PPV_ARGS(&heap)));
+		heap = create_descriptor_heap(type, num_desc, false);
 		start = heap->GetCPUDescriptorHandleForHeapStart();
 		end = start;
 		stride = c.device->GetDescriptorHandleIncrementSize(type);
-		size = 0;
+	}
+
+	auto DescriptorHeap::grow() -> void {
+		const auto old_start = start;
+		const auto old_heap = heap; // cpu only, nothing but the copy below reads it
+		capacity = std::min(capacity * 2, max_capacity);
+		if (!c.headless) {
+			heap = create_descriptor_heap(type, capacity, false);
+			start = heap->GetCPUDescriptorHandleForHeapStart();
+			if (size) c.device->CopyDescriptorsSimple(static_cast<UINT>(size), start, old_start, type);
+		}
+		end.ptr = start.ptr + size * stride;
+		c.resource_registry.rebase_views(*this, old_start);
+		// a grown staging heap gets copied to the shader visible side in whole
+		dirty_indices.clear();
+	}
+
+	auto DescriptorHeap::mark_dirty(D3D12_CPU_DESCRIPTOR_HANDLE handle) -> void {
+		if (track_dirty) dirty_indices.emplace_back(get_index_of(handle));
+	}
+
+	auto DescriptorHeap::mark_rewritten(D3D12_CPU_DESCRIPTOR_HANDLE handle) -> void {
+		mark_dirty(handle);
+		rewritten |= track_dirty;
+	}
+
+	auto DescriptorHeap::set_owner(D3D12_CPU_DESCRIPTOR_HANDLE handle, Handle resource) -> void {
+		const u32 index = get_index_of(handle);
+		if (index >= owner_slots.size()) owner_slots.resize(index + 1, invalid_handle_index);
+		owner_slots[index] = get_handle_index(resource);
 	}
 
 	auto DescriptorHeap::get_index_of(D3D12_CPU_DESCRIPTOR_HANDLE handle) -> u32 {
 		return static_cast<u32>((handle.ptr - start.ptr) / stride);
 	}
 
+	auto DescriptorHeap::allocate() -> D3D12_CPU_DESCRIPTOR_HANDLE {
+		if (!free_indices.empty()) {
+			const u32 index = free_indices.back();
+			free_indices.pop_back();
+			return D3D12_CPU_DESCRIPTOR_HANDLE{ .ptr = start.ptr + static_cast<usize>(index) * stride };
+		}
+		if (size == capacity && capacity < max_capacity) grow();
+		assert_log(size < capacity, "descriptor heap is full");
+		const auto handle = end;
+		end.ptr += stride;
+		++size;
+		return handle;
+	}
+
+	auto DescriptorHeap::free(D3D12_CPU_DESCRIPTOR_HANDLE handle) -> void {
+		const u32 index = get_index_of(handle);
+		if (index < owner_slots.size()) owner_slots[index] = invalid_handle_index;
+		free_indices.emplace_back(index);
+	}
+
 	auto DescriptorHeap::push_back(const AccelerationStructureViewInfo& info) -> u32{
 		auto desc = D3D12_SHADER_RESOURCE_VIEW_DESC{
 			.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE,
 			.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
 			.RaytracingAccelerationStructure = info.native,
 		};
-		c.device->CreateShaderResourceView(nullptr, &desc, end);
-		c.resource_registry.acceleration_structure_cache[info] = end;
-		end.ptr += stride;
-		++size;
-		return static_cast<u32>(size - 1);
+		const auto dst = allocate();
+		if (c.headless) ++c.headless_stats.num_views;
+		else c.device->CreateShaderResourceView(nullptr, &desc, dst);
+		mark_dirty(dst);
+		c.resource_registry.acceleration_structure_cache[info] = dst;
+		c.resource_registry.cold[c.resource_registry.get_slot(info.handle)].views.emplace_back(CachedView{ .info = info, .heap = this, .handle = dst });
+		set_owner(dst, info.handle);
+		return get_shader_index(dst);
 	}
 
-	auto DescriptorHeap::push_back(const ResourceViewInfo& res_info) -> u32{
-		if (res_info.type == ResourceType::Buffer) {
-			auto& info = res_info.views.buffer_view;
-			auto view = info.get_native_view();
-			if (view.index() == 0) {
-				auto& v = std::get<0>(view);
-				c.device->CreateShaderResourceView(
-					get_native_res(info.resource_handle), &v, end);
+	namespace {
+		// calls f with the view cache a cached view lives in and its key there
+		template <typename F>
+		auto with_view_cache(ResourceRegistry& reg, const CachedView& view, F&& f) -> void {
+			std::visit([&](const auto& info) {
+				using T = std::decay_t<decltype(info)>;
+				if constexpr (std::is_same_v<T, BufferViewInfo>) f(reg.buffer_view_cache, info);
+				else if constexpr (std::is_same_v<T, TextureViewInfo>) f(reg.texture_view_cache, info);
+				else f(reg.acceleration_structure_cache, info);
+			}, view.info);
+		}
+
+		auto create_view(const ResourceViewInfo& res_info, D3D12_CPU_DESCRIPTOR_HANDLE dst) -> void {
+			if (c.headless) {
+				++c.headless_stats.num_views;
+				return;
+			}
+			if (res_info.type == ResourceType::Buffer) {
+				auto& info = res_info.views.buffer_view;
+				auto view = info.get_native_view();
+				if (view.index() == 0) {
+					auto& v = std::get<0>(view);
+					c.device->CreateShaderResourceView(
+						get_native_res(info.resource_handle), &v, dst);
+				}
+				else if (view.index() == 1) {
+					auto& v = std::get<1>(view);
+					// no counter
+					c.device->CreateUnorderedAccessView(
+						get_native_res(info.resource_handle), nullptr, &v, dst);
+				}
 			}
-			else if (view.index() == 1) {
-				auto& v = std::get<1>(view);
-				// no counter
-				c.device->CreateUnorderedAccessView(
-					get_native_res(info.resource_handle), nullptr, &v, end);
+			else {  // assumes texture
+				std::variant<D3D12_SHADER_RESOURCE_VIEW_DESC,
+					D3D12_UNORDERED_ACCESS_VIEW_DESC,
+					D3D12_RENDER_TARGET_VIEW_DESC, D3D12_DEPTH_STENCIL_VIEW_DESC>
+					view = res_info.views.texture_view.get_native_view();
+				auto& info = res_info.views.texture_view;
+				if (view.index() == 0) {
+					auto& v = std::get<0>(view);
+					c.device->CreateShaderResourceView(
+						get_native_res(info.resource_handle), &v, dst);
+				}
+				else if (view.index() == 1) {
+					auto& v = std::get<1>(view);
+					// no counter support, TODO possibly?
+					c.device->CreateUnorderedAccessView(
+						get_native_res(info.resource_handle), nullptr, &v, dst);
+				}
+				else if (view.index() == 2) {
+					auto& v = std::get<2>(view);
+					d::c.device->CreateRenderTargetView(get_native_res(info.resource_handle),
+						&v, dst);
+				}
+				else if (view.index() == 3) {
+					auto& v = std::get<3>(view);
+					d::c.device->CreateDepthStencilView(get_native_res(info.resource_handle),
+						&v, dst);
+				}
 			}
-			c.resource_registry.buffer_view_cache[res_info.views.buffer_view] = end;
-			end.ptr += stride;
-			++size;
-			return static_cast<u32>(size - 1);
 		}
-		else {  // assumes texture
-			std::variant<D3D12_SHADER_RESOURCE_VIEW_DESC,
-				D3D12_UNORDERED_ACCESS_VIEW_DESC,
-				D3D12_RENDER_TARGET_VIEW_DESC, D3D12_DEPTH_STENCIL_VIEW_DESC>
-				view = res_info.views.texture_view.get_native_view();
-			auto& info = res_info.views.texture_view;
-			if (view.index() == 0) {
-				auto& v = std::get<0>(view);
-				c.device->CreateShaderResourceView(
-					get_native_res(info.resource_handle), &v, end);
-			}
-			else if (view.index() == 1) {
-				auto& v = std::get<1>(view);
-				// no counter support, TODO possibly?
-				c.device->CreateUnorderedAccessView(
-					get_native_res(info.resource_handle), nullptr, &v, end);
+	}
+
+	auto DescriptorHeap::push_back(const ResourceViewInfo& res_info) -> u32{
+		return get_shader_index(push_back_get_handle(res_info));
+	}
+
+	auto ResourceRegistry::refresh_views(Handle handle) -> void {
+		for (const auto& view : cold[get_slot(handle)].views) {
+			if (const auto* info = std::get_if<BufferViewInfo>(&view.info)) {
+				create_view(ResourceViewInfo{ .views = {.buffer_view = *info }, .type = ResourceType::Buffer }, view.handle);
 			}
-			else if (view.index() == 2) {
-				auto& v = std::get<2>(view);
-				d::c.device->CreateRenderTargetView(get_native_res(info.resource_handle),
-					&v, end);
+			else if (const auto* info = std::get_if<TextureViewInfo>(&view.info)) {
+				create_view(ResourceViewInfo{ .views = {.texture_view = *info }, .type = info->type }, view.handle);
 			}
-			else if (view.index() == 3) {
-				auto& v = std::get<3>(view);
-				d::c.device->CreateDepthStencilView(get_native_res(info.resource_handle),
-					&v, end);
+			view.heap->mark_rewritten(view.handle);
+		}
+	}
+
+	auto ResourceRegistry::release_views(Handle handle, std::vector<std::pair<DescriptorHeap*, D3D12_CPU_DESCRIPTOR_HANDLE>>& descriptors) -> void {
+		auto& views = cold[get_slot(handle)].views;
+		for (const auto& view : views) {
+			with_view_cache(*this, view, [](auto& cache, const auto& info) { cache.erase(info); });
+			descriptors.emplace_back(view.heap, view.handle);
+		}
+		views.clear();
+	}
+
+	auto ResourceRegistry::rebase_views(const DescriptorHeap& heap, D3D12_CPU_DESCRIPTOR_HANDLE old_start) -> void {
+		if (heap.start.ptr == old_start.ptr) return;
+		for (u32 index = 0; index < heap.owner_slots.size(); ++index) {
+			const u32 slot = heap.owner_slots[index];
+			if (slot == invalid_handle_index) continue;
+			// a resource can have several views in the heap, only the one at this index moves now
+			const usize old_ptr = old_start.ptr + static_cast<usize>(index) * heap.stride;
+			for (auto& view : cold[slot].views) {
+				if (view.heap != &heap || view.handle.ptr != old_ptr) continue;
+				view.handle.ptr = heap.start.ptr + static_cast<usize>(index) * heap.stride;
+				with_view_cache(*this, view, [&](auto& cache, const auto& info) { cache[info] = view.handle; });
 			}
-			c.resource_registry.texture_view_cache[res_info.views.texture_view] = end;
-			end.ptr += stride;
-			++size;
-			return static_cast<u32>(size - 1);
 		}
 	}
 
 	D3D12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::push_back_get_handle(
 		const ResourceViewInfo& res_info) {
-		push_back(res_info);
-		D3D12_CPU_DESCRIPTOR_HANDLE _end = end;
-		_end.ptr -= stride;
-		return _end;
+		const auto dst = allocate();
+		create_view(res_info, dst);
+		auto& reg = c.resource_registry;
+		if (res_info.type == ResourceType::Buffer) {
+			const auto& info = res_info.views.buffer_view;
+			reg.buffer_view_cache[info] = dst;
+			reg.cold[reg.get_slot(info.resource_handle)].views.emplace_back(CachedView{ .info = info, .heap = this, .handle = dst });
+			set_owner(dst, info.resource_handle);
+		}
+		else {
+			const auto& info = res_info.views.texture_view;
+			reg.texture_view_cache[info] = dst;
+			reg.cold[reg.get_slot(info.resource_handle)].views.emplace_back(CachedView{ .info = info, .heap = this, .handle = dst });
+			set_owner(dst, info.resource_handle);
+		}
+		mark_dirty(dst);
+		return dst;
+	}
+
+	auto BindlessHeap::init(u32 num_frame_desc) -> void {
+		heap = nullptr;
+		start = D3D12_CPU_DESCRIPTOR_HANDLE{ .ptr = 0 };
+		stride = c.headless ? 1 : c.device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		ring_capacity = num_frame_desc;
+		persistent_capacity = 0;
+		ring_staging.init(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, num_frame_desc);
+		ring_head = ring_tail = ring_flushed = 0;
+		ring_frames.clear();
+		retired_heaps.clear();
+		stats = {};
+	}
+
+	auto BindlessHeap::allocate_frame(u32 count) -> u32 {
+		assert_log(count <= ring_capacity, "more per frame descriptors than the ring holds");
+		// ranges never wrap, the tail end of the ring is skipped instead
+		const u64 index = ring_head % ring_capacity;
+		if (index + count > ring_capacity) ring_head += ring_capacity - index;
+		if (ring_head + count - ring_tail > ring_capacity) reclaim();
+		assert_log(ring_head + count - ring_tail <= ring_capacity, "descriptor ring is full, the frames in flight use too many per frame descriptors");
+
+		const auto first = static_cast<u32>(ring_head % ring_capacity);
+		ring_head += count;
+		stats.num_frame_descriptors += count;
+		return first;
+	}
+
+	auto BindlessHeap::get_frame_staging_handle(u32 ring_index) const -> D3D12_CPU_DESCRIPTOR_HANDLE {
+		return D3D12_CPU_DESCRIPTOR_HANDLE{ .ptr = ring_staging.start.ptr + static_cast<usize>(ring_index) * ring_staging.stride };
+	}
+
+	auto BindlessHeap::push_frame_view(const ResourceViewInfo& info) -> u32 {
+		const u32 index = allocate_frame(1);
+		create_view(info, get_frame_staging_handle(index));
+		return index;
+	}
+
+	auto BindlessHeap::flush(DescriptorHeap& persistent) -> void {
+		// (shader visible index, staging handle, count), contiguous runs on both sides merge into one range
+		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> dst_starts;
+		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> src_starts;
+		std::vector<UINT> sizes;
+		const auto add_range = [&](u32 dst_index, D3D12_CPU_DESCRIPTOR_HANDLE src, u32 count) {
+			const auto dst = D3D12_CPU_DESCRIPTOR_HANDLE{ .ptr = start.ptr + static_cast<usize>(dst_index) * stride };
+			if (!sizes.empty() && dst_starts.back().ptr + sizes.back() * stride == dst.ptr && src_starts.back().ptr + sizes.back() * stride == src.ptr) {
+				sizes.back() += count;
+				return;
+			}
+			dst_starts.emplace_back(dst);
+			src_starts.emplace_back(src);
+			sizes.emplace_back(count);
+		};
+		const auto add_ring = [&](u64 from, u64 to) {
+			while (from < to) {
+				const auto index = static_cast<u32>(from % ring_capacity);
+				const auto count = static_cast<u32>(std::min<u64>(to - from, ring_capacity - index));
+				add_range(index, get_frame_staging_handle(index), count);
+				from += count;
+			}
+		};
+		const auto add_persistent = [&](u32 index, u32 count) {
+			add_range(persistent.shader_index_offset + index, D3D12_CPU_DESCRIPTOR_HANDLE{ .ptr = persistent.start.ptr + static_cast<usize>(index) * persistent.stride }, count);
+		};
+
+		// the persistent staging heap grew, or descriptors a frame still in flight may read were rewritten. copying those
+		// in place would change what that frame sees, so it keeps reading the old heap until it retires
+		const bool grew = persistent.capacity != persistent_capacity;
+		const bool rewrote_in_flight = persistent.rewritten && std::ranges::any_of(ring_frames, [](const auto& frame) { return !c.fences_completed(frame.first); });
+		persistent.rewritten = false;
+		if (grew || rewrote_in_flight) {
+			const u32 num_desc = ring_capacity + persistent.capacity;
+			assert_log(num_desc <= max_bindless_descriptors, "bindless descriptors exceed what a shader visible heap can hold");
+			if (persistent_capacity != 0) {
+				retired_heaps.emplace_back(c.get_fences(), heap);
+				++(grew ? stats.num_grows : stats.num_rewrite_retires);
+			}
+			if (!c.headless) {
+				heap = create_descriptor_heap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, num_desc, true);
+				start = heap->GetCPUDescriptorHandleForHeapStart();
+			}
+			persistent_capacity = persistent.capacity;
+			persistent.dirty_indices.clear();
+			add_ring(ring_tail, ring_head);
+			if (persistent.size) add_persistent(0, static_cast<u32>(persistent.size));
+		}
+		else {
+			add_ring(ring_flushed, ring_head);
+			auto& dirty = persistent.dirty_indices;
+			std::ranges::sort(dirty);
+			const auto [first, last] = std::ranges::unique(dirty);
+			dirty.erase(first, last);
+			for (const auto index : dirty) add_persistent(index, 1);
+			dirty.clear();
+		}
+		ring_flushed = ring_head;
+
+		if (sizes.empty()) return;
+		++stats.num_copy_calls;
+		stats.num_copied_ranges += static_cast<u32>(sizes.size());
+		for (const auto size : sizes) stats.num_copied_descriptors += size;
+		if (c.headless) return;
+		const auto num_ranges = static_cast<UINT>(sizes.size());
+		c.device->CopyDescriptors(num_ranges, dst_starts.data(), sizes.data(), num_ranges, src_starts.data(), sizes.data(),
+			D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	}
+
+	auto BindlessHeap::report_stats(const DescriptorHeap& persistent) const -> void {
+		if (!stats.num_copy_calls) return;
+		info_log("BindlessHeap: {} persistent of {} ({} free), {} per frame, {} descriptors copied in {} ranges by {} calls, heap grew {} times, replaced {} times for rewrites",
+			persistent.size - persistent.free_indices.size(), persistent.capacity, persistent.free_indices.size(), stats.num_frame_descriptors,
+			stats.num_copied_descriptors, stats.num_copied_ranges, stats.num_copy_calls, stats.num_grows, stats.num_rewrite_retires);
+	}
+
+	auto BindlessHeap::end_frame() -> void {
+		ring_frames.emplace_back(c.get_fences(), ring_head);
+	}
+
+	auto BindlessHeap::reclaim() -> void {
+		while (!ring_frames.empty() && c.fences_completed(ring_frames.front().first)) {
+			ring_tail = ring_frames.front().second;
+			ring_frames.pop_front();
+		}
+		while (!retired_heaps.empty() && c.fences_completed(retired_heaps.front().first)) retired_heaps.pop_front();
 	}
 
 }  // namespace d
\ No newline at end of file
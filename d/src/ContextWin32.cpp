@@ -0,0 +1,130 @@
+#define GLFW_EXPOSE_NATIVE_WIN32
+
+#include "d/Context.h"
+
+#include <GLFW/glfw3.h>
+#include <GLFW/glfw3native.h>
+
+#include "d/Logging.h"
+
+// windowed init needs dxgi and a win32 window, the rest of Context.cpp also runs headless
+namespace d {
+
+	void Context::init(GLFWwindow* window, u32 sc_count, u32 frames_in_flight) {
+		DX_CHECK(D3D12GetDebugInterface(IID_PPV_ARGS(&debug_interface)));
+		debug_interface->EnableDebugLayer();
+		DX_CHECK(debug_interface->QueryInterface(IID_PPV_ARGS(&debug_interface1)));
+		debug_interface1->SetEnableGPUBasedValidation(true);
+		debug_interface1->SetEnableSynchronizedCommandQueueValidation(true);
+
+		UINT factory_flags = 0u;
+#ifdef _DEBUG
+		factory_flags |= DXGI_CREATE_FACTORY_DEBUG;
+#endif
+		DX_CHECK(CreateDXGIFactory2(factory_flags, IID_PPV_ARGS(&factory)));
+
+		// pick device
+		{
+			SIZE_T max_v_ram = 0u;
+
+			ComPtr<IDXGIAdapter1> adapter;
+			u32 suitable_adapter = 0u;
+			for (UINT i = 0;
+				factory->EnumAdapters1(i, &adapter) != DXGI_ERROR_NOT_FOUND; ++i) {
+				DXGI_ADAPTER_DESC1 adapter_desc;
+				adapter->GetDesc1(&adapter_desc);
+
+				if ((adapter_desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) == 0 &&
+					SUCCEEDED(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0,
+						__uuidof(ID3D12Device), nullptr)) &&
+					adapter_desc.DedicatedVideoMemory > max_v_ram) {
+					max_v_ram = adapter_desc.DedicatedVideoMemory;
+					suitable_adapter = i;
+				}
+				info_log(L"Adapter {}: {}", i, adapter_desc.Description,
+					adapter_desc.DedicatedVideoMemory);
+			}
+			info_log("Picked device: {}", suitable_adapter);
+			factory->EnumAdapters1(suitable_adapter, &adapter);
+			DX_CHECK(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0,
+				IID_PPV_ARGS(&device)));
+
+			auto allocator_desc = D3D12MA::ALLOCATOR_DESC{
+					.pDevice = device.Get(),
+					.pAdapter = adapter.Get(),
+			};
+
+			DX_CHECK(D3D12MA::CreateAllocator(&allocator_desc, &allocator));
+		}
+
+		workers = std::make_unique<WorkerPool>(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+		// create command queues, the async ones are only fed by the command graph
+		general_queue.init(QueueType::GENERAL);
+		async_compute_queue.init(QueueType::ASYNC_COMPUTE);
+		async_transfer_queue.init(QueueType::ASYNC_TRANSFER);
+		init_frames(frames_in_flight);
+
+		const auto dispatch_argument = D3D12_INDIRECT_ARGUMENT_DESC{ .Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH };
+		const auto dispatch_signature_desc = D3D12_COMMAND_SIGNATURE_DESC{
+			.ByteStride = sizeof(D3D12_DISPATCH_ARGUMENTS),
+			.NumArgumentDescs = 1,
+			.pArgumentDescs = &dispatch_argument,
+		};
+		DX_CHECK(device->CreateCommandSignature(&dispatch_signature_desc, nullptr, IID_PPV_ARGS(&dispatch_indirect_signature)));
+
+		int width, height;
+		glfwGetWindowSize(window, &width, &height);
+		swap_chain.image_index = 0;
+		swap_chain.width = width;
+		swap_chain.height = height;
+		swap_chain.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		DXGI_SWAP_CHAIN_DESC1 sc_desc = {
+				.Width = swap_chain.width,
+				.Height = swap_chain.height,
+				.Format = swap_chain.format,
+				.Stereo = FALSE,
+				.SampleDesc = {1, 0},
+				.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT,
+				.BufferCount = sc_count,
+				.Scaling = DXGI_SCALING_STRETCH,
+				.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD,
+				.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED,
+				.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING,
+		};
+
+		// create swap_chain and RTV ( render target views);
+		HWND win_handle = glfwGetWin32Window(window);
+		DX_CHECK(factory->CreateSwapChainForHwnd(general_queue.handle.Get(),
+			win_handle, &sc_desc, nullptr,
+			nullptr, &swap_chain.swapchain));
+		DX_CHECK(factory->MakeWindowAssociation(win_handle, DXGI_MWA_NO_ALT_ENTER));
+
+		asset_lib.init();
+
+		c.resource_registry.storage.init(4096, 16384, 256);
+		upload_ring.init(default_upload_ring_size);
+		readback_ring.init(default_readback_ring_size);
+
+		swap_chain.images.reserve(sc_count);
+		for (u32 i = 0; i < sc_count; ++i) {
+			ComPtr<ID3D12Resource> image;
+			ComPtr<D3D12MA::Allocation> empty_allocation;
+
+			DX_CHECK(swap_chain.swapchain->GetBuffer(i, IID_PPV_ARGS(&image)));
+			auto res = Resource<D2>(register_resource(image, empty_allocation, ResourceState{ .type = ResourceType::D2, .access_state = D3D12_BARRIER_ACCESS_COMMON}));
+			swap_chain.images.push_back(res);
+
+			// initialize cache
+			auto image_view_handle = swap_chain.images[i].rtv_view({})
+				.desc_handle();
+		}
+
+	}
+
+	auto InitContext(GLFWwindow* window, u32 sc_count, u32 frames_in_flight) -> std::pair<ResourceRegistry&, AssetLibrary&> {
+		c = d::Context();
+		c.init(window, 3, frames_in_flight);
+		return std::make_pair(std::ref(c.resource_registry), std::ref(c.asset_lib));
+	}
+}
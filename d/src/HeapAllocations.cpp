@@ -0,0 +1,69 @@
+#include "d/HeapAllocations.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace d {
+	namespace {
+		std::atomic<u64> num_heap_allocations{ 0 };
+
+		auto allocate(std::size_t size) noexcept -> void* {
+			num_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+			return std::malloc(size ? size : 1);
+		}
+
+		auto allocate_aligned(std::size_t size, std::align_val_t alignment) noexcept -> void* {
+			num_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+			const auto align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+			return _aligned_malloc(size ? size : 1, align);
+#else
+			// aligned_alloc wants a multiple of the alignment
+			return std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align);
+#endif
+		}
+
+		auto free_aligned(void* ptr) noexcept -> void {
+#ifdef _WIN32
+			_aligned_free(ptr);
+#else
+			std::free(ptr);
+#endif
+		}
+	}
+
+	auto get_num_heap_allocations() -> u64 {
+		return num_heap_allocations.load(std::memory_order_relaxed);
+	}
+}
+
+// every replaceable form, so nothing falls back to the runtime's own heap and gets freed by the wrong one
+auto operator new(std::size_t size) -> void* {
+	if (auto* ptr = d::allocate(size)) return ptr;
+	throw std::bad_alloc();
+}
+auto operator new[](std::size_t size) -> void* { return operator new(size); }
+auto operator new(std::size_t size, const std::nothrow_t&) noexcept -> void* { return d::allocate(size); }
+auto operator new[](std::size_t size, const std::nothrow_t&) noexcept -> void* { return d::allocate(size); }
+auto operator new(std::size_t size, std::align_val_t alignment) -> void* {
+	if (auto* ptr = d::allocate_aligned(size, alignment)) return ptr;
+	throw std::bad_alloc();
+}
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void* { return operator new(size, alignment); }
+auto operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept -> void* { return d::allocate_aligned(size, alignment); }
+auto operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept -> void* { return d::allocate_aligned(size, alignment); }
+
+auto operator delete(void* ptr) noexcept -> void { std::free(ptr); }
+auto operator delete[](void* ptr) noexcept -> void { std::free(ptr); }
+auto operator delete(void* ptr, std::size_t) noexcept -> void { std::free(ptr); }
+auto operator delete[](void* ptr, std::size_t) noexcept -> void { std::free(ptr); }
+auto operator delete(void* ptr, const std::nothrow_t&) noexcept -> void { std::free(ptr); }
+auto operator delete[](void* ptr, const std::nothrow_t&) noexcept -> void { std::free(ptr); }
+auto operator delete(void* ptr, std::align_val_t) noexcept -> void { d::free_aligned(ptr); }
+auto operator delete[](void* ptr, std::align_val_t) noexcept -> void { d::free_aligned(ptr); }
+auto operator delete(void* ptr, std::size_t, std::align_val_t) noexcept -> void { d::free_aligned(ptr); }
+auto operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept -> void { d::free_aligned(ptr); }
+auto operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept -> void { d::free_aligned(ptr); }
+auto operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept -> void { d::free_aligned(ptr); }
@@ -0,0 +1,35 @@
+#include "d/LinearArena.h"
+
+namespace d {
+
+	auto LinearArena::allocate(usize size, usize alignment) -> void* {
+		// everything stored is trivially copyable and at most as aligned as new[] guarantees
+		for (; block_index < blocks.size(); ++block_index, offset = 0) {
+			const auto& block = blocks[block_index];
+			const usize begin = (offset + alignment - 1) / alignment * alignment;
+			if (begin + size > block.size) continue;
+			offset = begin + size;
+			num_used_bytes += size;
+			return block.data.get() + begin;
+		}
+
+		const usize block_size = std::max(size, min_block_size);
+		blocks.emplace_back(Block{ .data = std::make_unique_for_overwrite<std::byte[]>(block_size), .size = block_size });
+		++num_block_allocations;
+		offset = size;
+		num_used_bytes += size;
+		return blocks.back().data.get();
+	}
+
+	auto LinearArena::capacity() const -> usize {
+		usize bytes = 0;
+		for (const auto& block : blocks) bytes += block.size;
+		return bytes;
+	}
+
+	auto LinearArena::reset() -> void {
+		block_index = 0;
+		offset = 0;
+		num_used_bytes = 0;
+	}
+}
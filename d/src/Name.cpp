@@ -0,0 +1,44 @@
+#include "d/Name.h"
+#include "d/Logging.h"
+
+namespace d {
+
+	auto NameTable::intern(std::string_view name) -> NameId {
+		auto id = make_name_id(name);
+		assert_log(id.valid(), "name hashes to the reserved empty id");
+		if (const auto* existing = interned.find(id.value)) {
+			assert_log(*existing == name, "two different names hash to the same id");
+#ifdef _DEBUG
+			id.debug_str = *existing;
+#endif
+			return id;
+		}
+
+		const std::string_view stored = strings.emplace_back(name);
+		interned[id.value] = stored;
+#ifdef _DEBUG
+		id.debug_str = stored;
+		debug_names[id.value] = stored;
+#endif
+		return id;
+	}
+
+	auto NameTable::note([[maybe_unused]] const NameId& id) -> void {
+#ifdef _DEBUG
+		if (id.debug_str.empty()) return;
+		if (const auto* existing = debug_names.find(id.value)) {
+			assert_log(*existing == id.debug_str, "two different names hash to the same id");
+			return;
+		}
+		debug_names[id.value] = id.debug_str;
+#endif
+	}
+
+	auto NameTable::get_string(const NameId& id) const -> std::string_view {
+		if (const auto* str = interned.find(id.value)) return *str;
+#ifdef _DEBUG
+		if (const auto* str = debug_names.find(id.value)) return *str;
+#endif
+		return {};
+	}
+}
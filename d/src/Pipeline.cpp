@@ -46,39 +46,56 @@ namespace d {
 		return *this;
 	}
 
+	namespace {
+		// bindless root signature with an optional block of root constants, shared by graphics and compute pipelines
+		auto create_root_signature(bool include_root_constants, std::optional<u32> num_constants, ComPtr<ID3DBlob>& blob,
+			ComPtr<ID3DBlob>& error_blob) -> ComPtr<ID3D12RootSignature> {
+			auto root_sign_desc = CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC{};
+			const auto param = D3D12_ROOT_PARAMETER1{
+					.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
+					.Constants =
+							D3D12_ROOT_CONSTANTS{
+									.ShaderRegister = 0,
+									.RegisterSpace = 0,
+									.Num32BitValues = num_constants.value_or(0),
+							},
+					.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
+			};
+			const D3D12_ROOT_PARAMETER1 params[1]{ param };
+			root_sign_desc.Init_1_1(include_root_constants ? 1 : 0, include_root_constants ? params : nullptr, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_SAMPLER_HEAP_DIRECTLY_INDEXED |
+				D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED);
+			DX_CHECK(D3DX12SerializeVersionedRootSignature(&root_sign_desc,
+				D3D_ROOT_SIGNATURE_VERSION_1_1, &blob,
+				&error_blob));
+			ComPtr<ID3D12RootSignature> root_signature;
+			DX_CHECK(
+				c.device->CreateRootSignature(0, blob->GetBufferPointer(), blob->GetBufferSize(),
+					IID_PPV_ARGS(&root_signature)));
+			return root_signature;
+		}
+	}
+
 	auto GraphicsPipelineStream::build(bool include_root_constants, std::optional<u32> num_constants) -> GraphicsPipeline {
 		GraphicsPipeline pl{};
-		auto root_sign_desc = CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC{};
-		const auto param = D3D12_ROOT_PARAMETER1{
-				.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
-				.Constants =
-						D3D12_ROOT_CONSTANTS{
-								.ShaderRegister = 0,
-								.RegisterSpace = 0,
-								.Num32BitValues = num_constants.value_or(0),
-						},
-				.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL,
-		};
-		const D3D12_ROOT_PARAMETER1 params[1]{ param };
-		root_sign_desc.Init_1_1(include_root_constants ? 1 : 0, include_root_constants ? params : nullptr, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_SAMPLER_HEAP_DIRECTLY_INDEXED |
-			D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED);
-		DX_CHECK(D3DX12SerializeVersionedRootSignature(&root_sign_desc,
-			D3D_ROOT_SIGNATURE_VERSION_1_1, &pl.rootSignatureBlob,
-			&pl.errorBlob));
-		DX_CHECK(
-			c.device->CreateRootSignature(0, pl.rootSignatureBlob->GetBufferPointer(), pl.rootSignatureBlob->GetBufferSize(),
-				IID_PPV_ARGS(&pl.root_signature)));
+		pl.root_signature = create_root_signature(include_root_constants, num_constants, pl.rootSignatureBlob, pl.errorBlob);
 		desc.pRootSignature = pl.root_signature.Get();
 		DX_CHECK(d::c.device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pl.pso)));
 		return std::move(pl);
 	}
 
-	auto GraphicsPipeline::get_native() const -> ID3D12PipelineState* {
-		return pso.Get();
+	auto ComputePipelineStream::set_compute_shader(const char* label) -> ComputePipelineStream& {
+		const ShaderEntry& cs = c.asset_lib.get_shader_asset(label);
+		desc.CS.pShaderBytecode = cs.code->GetBufferPointer();
+		desc.CS.BytecodeLength = cs.code->GetBufferSize();
+		return *this;
 	}
 
-	auto RayTracingPipeline::get_native() const -> ID3D12StateObject* {
-		return pso.Get();
+	auto ComputePipelineStream::build(bool include_root_constants, std::optional<u32> num_constants) -> ComputePipeline {
+		ComputePipeline pl{};
+		pl.root_signature = create_root_signature(include_root_constants, num_constants, pl.rootSignatureBlob, pl.errorBlob);
+		desc.pRootSignature = pl.root_signature.Get();
+		DX_CHECK(d::c.device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pl.pso)));
+		return std::move(pl);
 	}
 
 	auto RayTracingPipelineStream::set_library(const char* label, std::initializer_list<std::wstring> _exported_symbols) -> RayTracingPipelineStream {
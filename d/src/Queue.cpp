@@ -4,67 +4,88 @@
 namespace d {
 
 	Queue::Queue(QueueType type) {
-		auto queue_desc = D3D12_COMMAND_QUEUE_DESC{
-			.Type = D3D12_COMMAND_LIST_TYPE_DIRECT,
-			.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL,
-			.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE,
-			.NodeMask = 0x0,
-		};
-		if (type == QueueType::GENERAL) queue_desc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-		else if (type == QueueType::ASYNC_TRANSFER) queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
-		else if (type == QueueType::ASYNC_COMPUTE) queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
-
-		DX_CHECK(c.device->CreateCommandQueue(&queue_desc, IID_PPV_ARGS(&handle)));
-		DX_CHECK(c.device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&idle_fence)));
-
-		idle_event = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
-		assert(idle_event && "Queue::submit_lists: could not could create event handle");
-
-		fence_val = 0;
+		init(type);
 	}
 
 	auto Queue::submit_lists(std::initializer_list<CommandList> lists) -> void {
+		execute_lists(std::span(lists.begin(), lists.size()));
+		signal();
+	}
+
+	auto Queue::execute_lists(std::span<const CommandList> lists) -> void {
+		++stats.num_submissions;
+		stats.num_lists += static_cast<u32>(lists.size());
+		for (const auto& list : lists) stats.commands += list.stats;
+		unsignaled_work = true;
+		if (null) return;
+
 		std::vector<ID3D12CommandList*> _lists(lists.size());
 		std::ranges::transform(lists, _lists.begin(), [](const CommandList& l) { return l.handle.Get(); });
-
-		++fence_val;
-		assert(idle_event && "Queue::submit_lists: could not could create event handle");
 		handle->ExecuteCommandLists(static_cast<u32>(lists.size()), _lists.data());
-		DX_CHECK(handle->Signal(idle_fence.Get(), fence_val));
-		DX_CHECK(idle_fence->SetEventOnCompletion(fence_val, idle_event));
 	}
 
-	auto Queue::block_until_idle(u32 timeout) -> void {
+	auto Queue::signal() -> u64 {
+		++stats.num_signals;
+		unsignaled_work = false;
+		if (null) return ++fence_val;
+		DX_CHECK(handle->Signal(idle_fence.Get(), ++fence_val));
+		return fence_val;
+	}
+
+	auto Queue::wait(const Queue& other, u64 value) -> void {
+		++stats.num_waits;
+		if (null) return;
+		DX_CHECK(handle->Wait(other.idle_fence.Get(), value));
+	}
+
+	auto Queue::block_until(u64 value, u32 timeout) -> void {
+		if (null) return;
+		if (idle_fence->GetCompletedValue() >= value) return;
+		assert(idle_event && "Queue::block_until: could not could create event handle");
+		DX_CHECK(idle_fence->SetEventOnCompletion(value, idle_event));
 		WaitForSingleObject(idle_event, timeout);
 	}
 
+	auto Queue::block_until_idle(u32 timeout) -> void {
+		block_until(fence_val, timeout);
+	}
+
+	auto Queue::get_completed_value() const -> u64 {
+		return null ? fence_val : idle_fence->GetCompletedValue();
+	}
+
 	auto Queue::get_command_list() -> d::CommandList {
 		d::CommandList list;
+		list.type = get_command_list_type(type);
+		list.null = null;
+		if (null) return list;
 
-		DX_CHECK(c.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&list.allocator)));
-		DX_CHECK(c.device->CreateCommandList(0x0, D3D12_COMMAND_LIST_TYPE_DIRECT, list.allocator.Get(), nullptr, IID_PPV_ARGS(&list.handle)));
+		DX_CHECK(c.device->CreateCommandAllocator(get_command_list_type(type), IID_PPV_ARGS(&list.allocator)));
+		DX_CHECK(c.device->CreateCommandList(0x0, get_command_list_type(type), list.allocator.Get(), nullptr, IID_PPV_ARGS(&list.handle)));
 
 		DX_CHECK(list.handle->Close());
 		return list;
 	}
 
 	auto Queue::init(QueueType type) -> void {
+		this->type = type;
+		fence_val = 0;
+		unsignaled_work = false;
+		stats = {};
+		null = c.headless;
+		if (null) return;
+
 		auto queue_desc = D3D12_COMMAND_QUEUE_DESC{
-			.Type = D3D12_COMMAND_LIST_TYPE_DIRECT,
+			.Type = get_command_list_type(type),
 			.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL,
 			.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE,
 			.NodeMask = 0x0,
 		};
-		if (type == QueueType::GENERAL) queue_desc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-		else if (type == QueueType::ASYNC_TRANSFER) queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
-		else if (type == QueueType::ASYNC_COMPUTE) queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
 
 		DX_CHECK(c.device->CreateCommandQueue(&queue_desc, IID_PPV_ARGS(&handle)));
 		DX_CHECK(c.device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&idle_fence)));
 
 		idle_event = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
 		assert(idle_event && "Queue::submit_lists: could not could create event handle");
-
-		fence_val = 0;
 	}
 }
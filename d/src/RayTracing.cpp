@@ -96,6 +96,8 @@ namespace d {
 		uavBarrier.UAV.pResource = get_native_res(result);
 		uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
 		cl.handle->ResourceBarrier(1, &uavBarrier);
+		// only the build reads scratch, it goes away once the list got submitted and finished
+		c.release_resource(scratch, get_queue_type(cl.type));
 
 		return Resource<AccelStructure>(static_cast<u32>(result.handle));
 
@@ -166,6 +168,9 @@ namespace d {
 		uavBarrier.UAV.pResource = get_native_res(result);
 		uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
 		list.handle->ResourceBarrier(1, &uavBarrier);
+		// only the build reads scratch and the instances, they go away once the list got submitted and finished
+		c.release_resource(scratch, get_queue_type(list.type));
+		c.release_resource(instance_buffer, get_queue_type(list.type));
 		return Resource<AccelStructure>(static_cast<u32>(result));
 	}
 }
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#include "d/Context.h"
+
+namespace d {
+	namespace {
+		// copies into readback heaps have no alignment requirement, this keeps results aligned for reading them as structs
+		constexpr u64 buffer_readback_alignment = 16;
+
+		auto needs_copy_layout(D3D12_BARRIER_LAYOUT layout) -> bool {
+			// common textures can be copied from on the general queue without a transition
+			return layout != D3D12_BARRIER_LAYOUT_COMMON && layout != D3D12_BARRIER_LAYOUT_COPY_SOURCE;
+		}
+	}
+
+	auto ReadbackRing::init(u64 size) -> void {
+		head = tail = 0;
+		requests.clear();
+		lists.clear();
+		num_requested = num_delivered = 0;
+		stats = {};
+		create_ring_buffer(size);
+	}
+
+	auto ReadbackRing::create_ring_buffer(u64 size) -> void {
+		capacity = size;
+		buffer = c.resource_registry.create_buffer(BufferCreateInfo{ .size = size, .usage = MemoryUsage::CPU_Readable });
+		if (c.headless) {
+			host_memory.assign(size, std::byte{ 0 });
+			mapped = host_memory.data();
+			return;
+		}
+		// readback heaps can stay mapped as well, the gpu is done with whatever gets read once its fence passed
+		void* data;
+		DX_CHECK(get_native_res(buffer)->Map(0, nullptr, &data));
+		mapped = static_cast<const std::byte*>(data);
+	}
+
+	auto ReadbackRing::allocate(u64 size, u64 alignment) -> u64 {
+		auto begin = fit_ring_allocation(head, tail, capacity, size, alignment);
+		if (!begin) ++stats.num_full_waits;
+		while (!begin) {
+			if (requests.empty() || !requests.front().fence_value) {
+				// whatever is left belongs to the current frame. submitting it early would copy before the frame ran
+				grow(size, alignment);
+			}
+			else {
+				// delivering the oldest request frees its space, and the front of the ring once nothing is left
+				c.general_queue.block_until(requests.front().fence_value);
+				deliver();
+			}
+			begin = fit_ring_allocation(head, tail, capacity, size, alignment);
+		}
+		head = *begin + size;
+		return *begin;
+	}
+
+	auto ReadbackRing::grow(u64 size, u64 alignment) -> void {
+		// nothing is in flight, so the old buffer can go and the requests not submitted yet move to the front of the new one
+		const auto get_alignment = [](const ReadbackRequest& request) { return request.footprint ? D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT : buffer_readback_alignment; };
+		u64 needed = size + alignment;
+		for (const auto& request : requests) needed += request.size + get_alignment(request);
+		c.release_resource(buffer);
+		create_ring_buffer(std::bit_ceil(std::max(capacity * 2, needed)));
+
+		head = tail = 0;
+		for (auto& request : requests) {
+			const u64 a = get_alignment(request);
+			request.begin = (head + a - 1) / a * a;
+			request.end = head = request.begin + request.size;
+			if (request.footprint) request.footprint->layout.Offset = request.begin;
+		}
+		++stats.num_grows;
+	}
+
+	auto ReadbackRing::acquire_list() -> CommandList& {
+		const u64 completed = c.general_queue.get_completed_value();
+		auto it = std::ranges::find_if(lists, [&](const auto& list) { return list.second <= completed; });
+		if (it == lists.end()) {
+			lists.emplace_back(c.general_queue.get_command_list(), 0);
+			it = std::prev(lists.end());
+		}
+		it->second = std::numeric_limits<u64>::max();
+		return it->first.record();
+	}
+
+	auto ReadbackRing::request_readback(Resource<Buffer> src, u64 offset, u64 size, ReadbackCallback callback) -> ReadbackFuture {
+		const u64 begin = allocate(size, buffer_readback_alignment);
+		requests.emplace_back(ReadbackRequest{
+			.src = src,
+			.src_offset = offset,
+			.begin = begin,
+			.end = head,
+			.size = size,
+			.fence_value = 0,
+			.frame_number = c.frame_number,
+			.callback = std::move(callback),
+		});
+		++stats.num_requests;
+		stats.num_bytes += size;
+		return ReadbackFuture{ .id = num_requested++ };
+	}
+
+	auto ReadbackRing::request_readback(Handle src, const TextureReadbackRange& range, ReadbackCallback callback) -> ReadbackFuture {
+		auto desc = c.resource_registry.get_desc(src);
+		assert_log(desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER, "buffers are read back with an offset and size");
+		const bool is_3d = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+		const u32 mip = range.subresource % desc.MipLevels;
+		const auto width = static_cast<u32>(std::max<u64>(desc.Width >> mip, 1));
+		const u32 height = std::max(desc.Height >> mip, 1u);
+		const u32 depth = is_3d ? std::max<u32>(desc.DepthOrArraySize >> mip, 1) : 1;
+		const auto box = range.box.value_or(D3D12_BOX{ .left = 0, .top = 0, .front = 0, .right = width, .bottom = height, .back = depth });
+		assert_log(box.left < box.right && box.top < box.bottom && box.front < box.back && box.right <= width && box.bottom <= height && box.back <= depth,
+			"readback box outside of the subresource");
+
+		// the region laid out as if it was a texture of its own
+		desc.Width = box.right - box.left;
+		desc.Height = box.bottom - box.top;
+		desc.DepthOrArraySize = static_cast<UINT16>(box.back - box.front);
+		desc.MipLevels = 1;
+		auto footprint = get_copyable_footprints(desc)[0];
+		const u64 size = static_cast<u64>(footprint.layout.Footprint.RowPitch) * footprint.num_rows * footprint.layout.Footprint.Depth;
+		const u64 begin = allocate(size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+		footprint.layout.Offset = begin % capacity;
+
+		requests.emplace_back(ReadbackRequest{
+			.src = src,
+			.subresource = range.subresource,
+			.box = box,
+			.footprint = footprint,
+			.begin = begin,
+			.end = head,
+			.size = size,
+			.fence_value = 0,
+			.frame_number = c.frame_number,
+			.callback = std::move(callback),
+		});
+		++stats.num_requests;
+		stats.num_bytes += size;
+		return ReadbackFuture{ .id = num_requested++ };
+	}
+
+	auto ReadbackRing::submit() -> void {
+		// everything not submitted yet sits at the back
+		const auto first = std::ranges::find_if(requests, [](const auto& request) { return request.fence_value == 0; });
+		if (first == requests.end()) return;
+		const auto pending = std::ranges::subrange(first, requests.end());
+
+		// a texture read several times is only transitioned once, into copy source and back to its resting layout.
+		// nothing syncs with earlier work: this list is submitted on its own after the frame's lists, the graph's exit
+		// barriers end with SyncAfter NONE and work across ExecuteCommandLists calls on a queue is ordered anyway. that
+		// is also why a texture resting in COMMON is read without any barrier
+		std::vector<D3D12_TEXTURE_BARRIER> to_copy, to_rest;
+		for (const auto& request : pending) {
+			if (!request.footprint) continue;
+			const auto layout = get_res_state(request.src).layout;
+			auto* native = get_native_res(request.src);
+			if (!needs_copy_layout(layout) || std::ranges::any_of(to_copy, [&](const auto& barrier) { return barrier.pResource == native; })) continue;
+			to_copy.emplace_back(D3D12_TEXTURE_BARRIER{
+				.SyncBefore = D3D12_BARRIER_SYNC_NONE,
+				.SyncAfter = D3D12_BARRIER_SYNC_COPY,
+				.AccessBefore = D3D12_BARRIER_ACCESS_NO_ACCESS,
+				.AccessAfter = D3D12_BARRIER_ACCESS_COPY_SOURCE,
+				.LayoutBefore = layout,
+				.LayoutAfter = D3D12_BARRIER_LAYOUT_COPY_SOURCE,
+				.pResource = native,
+				.Subresources = { .IndexOrFirstMipLevel = 0xffffffff },
+				.Flags = D3D12_TEXTURE_BARRIER_FLAG_NONE,
+				});
+			to_rest.emplace_back(D3D12_TEXTURE_BARRIER{
+				.SyncBefore = D3D12_BARRIER_SYNC_COPY,
+				.SyncAfter = D3D12_BARRIER_SYNC_NONE,
+				.AccessBefore = D3D12_BARRIER_ACCESS_COPY_SOURCE,
+				.AccessAfter = D3D12_BARRIER_ACCESS_NO_ACCESS,
+				.LayoutBefore = D3D12_BARRIER_LAYOUT_COPY_SOURCE,
+				.LayoutAfter = layout,
+				.pResource = native,
+				.Subresources = { .IndexOrFirstMipLevel = 0xffffffff },
+				.Flags = D3D12_TEXTURE_BARRIER_FLAG_NONE,
+				});
+		}
+
+		auto& list = acquire_list();
+		list.barrier({}, to_copy);
+		for (const auto& request : pending) {
+			if (request.footprint) list.copy_texture_to_buffer(request.src, request.subresource, request.box, buffer, request.footprint->layout);
+			else list.copy_buffer_region(Resource<Buffer>(request.src), buffer, request.size, request.src_offset, request.begin % capacity);
+		}
+		list.barrier({}, to_rest);
+		list.finish();
+
+		auto& queue = c.general_queue;
+		queue.submit_lists({ list });
+		++stats.num_batches;
+		for (auto& request : pending) request.fence_value = queue.fence_val;
+		for (auto& [l, fence] : lists) {
+			if (&l == &list) fence = queue.fence_val;
+		}
+	}
+
+	auto ReadbackRing::deliver() -> void {
+		const u64 completed = c.general_queue.get_completed_value();
+		while (!requests.empty() && requests.front().fence_value && requests.front().fence_value <= completed) {
+			// popped first, a callback is free to request the next readback
+			auto request = std::move(requests.front());
+			requests.pop_front();
+			auto footprint = request.footprint;
+			if (footprint) footprint->layout.Offset = 0;
+			request.callback(ReadbackResult{
+				.data = std::span(mapped + request.begin % capacity, request.size),
+				.footprint = footprint,
+			});
+			// the space is only handed back once the callback is done reading it
+			tail = request.end;
+			++num_delivered;
+			++stats.num_delivered;
+			stats.latency_frames += c.frame_number - request.frame_number;
+		}
+		if (requests.empty() && tail == head) head = tail = 0;
+	}
+
+	auto ReadbackRing::wait(u64 id) -> void {
+		assert_log(id < num_requested, "waiting on a readback that was never requested");
+		while (num_delivered <= id) {
+			if (!requests.front().fence_value) submit();
+			c.general_queue.block_until(requests.front().fence_value);
+			deliver();
+		}
+	}
+
+	auto ReadbackRing::report_stats() const -> void {
+		if (!stats.num_requests) return;
+		info_log("ReadbackRing: {} requested ({:.2f} MB) in {} batches, {} delivered {:.2f} frames later on average, the {:.2f} MB ring ran full {} times and grew {} times",
+			stats.num_requests, stats.num_bytes / 1048576., stats.num_batches, stats.num_delivered,
+			stats.num_delivered ? static_cast<double>(stats.latency_frames) / stats.num_delivered : 0., capacity / 1048576., stats.num_full_waits, stats.num_grows);
+	}
+
+	auto ReadbackFuture::ready() const -> bool {
+		return id < c.readback_ring.num_delivered;
+	}
+
+	auto ReadbackFuture::wait() const -> void {
+		c.readback_ring.wait(id);
+	}
+}
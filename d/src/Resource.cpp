@@ -9,36 +9,98 @@
 
 namespace d {
 
+	namespace {
+		// headless resources live at address 0, textures always do
+		auto make_hot(const ComPtr<ID3D12Resource>& resource, ResourceState state) -> HotResource {
+			return HotResource{
+				.native = resource.Get(),
+				.gpu_addr = resource ? resource->GetGPUVirtualAddress() : 0,
+				.state = state,
+			};
+		}
+	}
+
 	u32 Context::register_resource(const ComPtr<ID3D12Resource>& resource,
 		const ComPtr<D3D12MA::Allocation>& allocation, ResourceState initial_state) {
-		bool found_spot = false;
-		usize spot = 0;
-		for (const auto& res : resource_registry.resources) {
-			if (res == nullptr) {
-				found_spot = true;
-				break;
-			}
-			++spot;
+		auto& reg = resource_registry;
+		u32 index = reg.free_head;
+		if (index != invalid_handle_index) {
+			reg.free_head = reg.slots[index].next_free;
+			reg.hot[index] = make_hot(resource, initial_state);
+			reg.cold[index] = ColdResource{ .resource = resource, .allocation = allocation };
+		}
+		else {
+			index = static_cast<u32>(reg.hot.size());
+			assert_log(index < invalid_handle_index, "ran out of resource handles");
+			reg.hot.emplace_back(make_hot(resource, initial_state));
+			reg.cold.emplace_back(ColdResource{ .resource = resource, .allocation = allocation });
+			reg.slots.emplace_back();
 		}
-		const u32 handle = found_spot ? static_cast<u32>(spot)
-			: static_cast<u32>(resource_registry.resources.size());
+		return make_handle(index, reg.slots[index].generation);
+	}
 
+	auto Context::release_resource(Handle handle) -> void {
+		release_resource(handle, get_fences());
+	}
 
-		if (!found_spot)
-			resource_registry.resources.push_back(resource),
-			resource_registry.allocations.push_back(allocation),
-			resource_registry.resource_states.push_back(initial_state);
-		else
-			resource_registry.resources[spot] = resource, resource_registry.allocations[spot] = allocation,
-			resource_registry.resource_states[spot] = initial_state;
+	auto Context::release_resource(Handle handle, QueueType pending_on) -> void {
+		auto fences = get_fences();
+		fences[static_cast<usize>(pending_on)] = get_queue(pending_on).fence_val + 1;
+		release_resource(handle, fences);
+	}
 
-		return handle;
+	auto Context::release_resource(Handle handle, const QueueFences& fences) -> void {
+		auto& reg = resource_registry;
+		const u32 index = reg.get_slot(handle);
+		auto release = DeferredRelease{
+			.fences = fences,
+			.resource = std::move(reg.cold[index].resource),
+			.allocation = std::move(reg.cold[index].allocation),
+		};
+		reg.release_views(handle, release.descriptors);
+		reg.defer_release(std::move(release));
+		// the name might already belong to a newer resource
+		if (const auto name = reg.cold[index].name; name.valid()) {
+			if (const auto* named = reg.named_resource_map.find(name.value); named && *named == handle) reg.named_resource_map.erase(name.value);
+		}
+		reg.cold[index] = ColdResource{};
+		reg.hot[index] = HotResource{};
+
+		// a slot that ran out of generations is retired, reusing it would bring its oldest handles back to life
+		auto& slot = reg.slots[index];
+		if (++slot.generation > max_handle_generation) return;
+		slot.next_free = reg.free_head;
+		reg.free_head = index;
 	}
 
-	// only release staging resources! resources that have views need to flush their view cache which is not implemented yet :)
-	auto Context::release_resource(Handle handle)-> void {
-		resource_registry.allocations[handle] = nullptr;
-		resource_registry.resources[handle] = nullptr;
+	auto ResourceRegistry::set_native(Handle handle, const ComPtr<ID3D12Resource>& resource) -> void {
+		const u32 index = get_slot(handle);
+		if (cold[index].resource) defer_release(DeferredRelease{ .fences = c.get_fences(), .resource = std::move(cold[index].resource) });
+		cold[index].resource = resource;
+		hot[index] = make_hot(resource, hot[index].state);
+	}
+
+	auto ResourceRegistry::defer_release(DeferredRelease&& release) -> void {
+		deferred_releases.emplace_back(std::move(release));
+		++deferred_stats.num_deferred;
+		deferred_stats.max_pending = std::max(deferred_stats.max_pending, static_cast<u32>(deferred_releases.size()));
+	}
+
+	auto ResourceRegistry::collect_releases() -> void {
+		const auto num_collected = std::erase_if(deferred_releases, [](const DeferredRelease& release) {
+			if (!c.fences_completed(release.fences)) return false;
+			for (const auto& [heap, handle] : release.descriptors) heap->free(handle);
+			return true;
+		});
+		deferred_stats.num_collected += static_cast<u32>(num_collected);
+	}
+
+	auto ResourceRegistry::report_stats() const -> void {
+		if (deferred_stats.num_deferred) {
+			info_log("ResourceRegistry deferred releases: {} released, {} freed once their fences passed, {} pending (at most {})",
+				deferred_stats.num_deferred, deferred_stats.num_collected, deferred_releases.size(), deferred_stats.max_pending);
+		}
+		storage.bindless.report_stats(storage.bindable_desc_heap);
 	}
 
 	std::variant<D3D12_SHADER_RESOURCE_VIEW_DESC, D3D12_UNORDERED_ACCESS_VIEW_DESC>
@@ -237,15 +299,15 @@ namespace d {
 
 	[[nodiscard]] auto Resource<D2>::rtv_view(std::optional<u32> mip_slice) const
 		-> ResourceViewInfo {
+		// headless textures don't know their format, their views are never created anyway
+		auto* native = get_native_res(static_cast<Handle>(handle));
 		return ResourceViewInfo{
 				.views =
 						{
 								.texture_view =
 										{
 												.resource_handle = static_cast<Handle>(handle),
-												.format = get_native_res(static_cast<Handle>(handle))
-																			->GetDesc()
-																			.Format,
+												.format = native ? native->GetDesc().Format : DXGI_FORMAT_UNKNOWN,
 												.texture_usage = TextureUsage::RENDER_TARGET,
 												.mip_slice = mip_slice.value_or(0u),
 												.type = ResourceType::D2,
@@ -258,18 +320,16 @@ namespace d {
 	[[nodiscard]] auto AccelerationStructureViewInfo::desc_index() const->u32 {
 		auto& heap = c.resource_registry.storage.bindable_desc_heap;
 		auto& lib = c.resource_registry;
-		return lib.acceleration_structure_cache.contains(*this)
-			? heap.get_index_of(lib.acceleration_structure_cache[*this])
-			: heap.push_back(*this);
+		const auto* cached = lib.acceleration_structure_cache.find(*this);
+		return cached ? heap.get_shader_index(*cached) : heap.push_back(*this);
 	};
 
 	[[nodiscard]] auto ResourceViewInfo::desc_index() const -> u32 {
 		auto* heap = &c.resource_registry.storage.bindable_desc_heap;
 		auto& lib = c.resource_registry;
 		if (type == ResourceType::Buffer) {
-			return lib.buffer_view_cache.contains(views.buffer_view)
-				? heap->get_index_of(lib.buffer_view_cache[views.buffer_view])
-				: heap->push_back(*this);
+			const auto* cached = lib.buffer_view_cache.find(views.buffer_view);
+			return cached ? heap->get_shader_index(*cached) : heap->push_back(*this);
 		}
 		const auto usage = views.texture_view.texture_usage;
 		if (usage == TextureUsage::RENDER_TARGET) {
@@ -278,9 +338,14 @@ namespace d {
 		else if (usage == TextureUsage::DEPTH_STENCIL) {
 			heap = &c.resource_registry.storage.depth_stencil_heap;
 		}
-		return lib.texture_view_cache.contains(views.texture_view)
-			? heap->get_index_of(lib.texture_view_cache[views.texture_view])
-			: heap->push_back(*this);
+		const auto* cached = lib.texture_view_cache.find(views.texture_view);
+		return cached ? heap->get_shader_index(*cached) : heap->push_back(*this);
+	}
+
+	[[nodiscard]] auto ResourceViewInfo::frame_desc_index() const -> u32 {
+		assert_log(type == ResourceType::Buffer || (views.texture_view.texture_usage != TextureUsage::RENDER_TARGET && views.texture_view.texture_usage != TextureUsage::DEPTH_STENCIL),
+			"only shader visible views can live in the descriptor ring");
+		return c.resource_registry.storage.bindless.push_frame_view(*this);
 	}
 
 	[[nodiscard]] auto ResourceViewInfo::desc_handle() const
@@ -288,9 +353,8 @@ namespace d {
 		auto* heap = &c.resource_registry.storage.bindable_desc_heap;
 		auto& lib = c.resource_registry;
 		if (type == ResourceType::Buffer) {
-			return lib.buffer_view_cache.contains(views.buffer_view)
-				? lib.buffer_view_cache[views.buffer_view]
-				: heap->push_back_get_handle(*this);
+			const auto* cached = lib.buffer_view_cache.find(views.buffer_view);
+			return cached ? *cached : heap->push_back_get_handle(*this);
 		}
 		const auto usage = views.texture_view.texture_usage;
 		if (usage == TextureUsage::RENDER_TARGET) {
@@ -299,9 +363,8 @@ namespace d {
 		else if (usage == TextureUsage::DEPTH_STENCIL) {
 			heap = &c.resource_registry.storage.depth_stencil_heap;
 		}
-		return lib.texture_view_cache.contains(views.texture_view)
-			? lib.texture_view_cache[views.texture_view]
-			: heap->push_back_get_handle(*this);
+		const auto* cached = lib.texture_view_cache.find(views.texture_view);
+		return cached ? *cached : heap->push_back_get_handle(*this);
 	}
 
 	[[nodiscard]] auto TextureExtent::full_swap_chain() -> TextureExtent {
@@ -312,15 +375,26 @@ namespace d {
 	}
 
 	[[nodiscard]] auto Resource<AccelStructure>::gpu_addr() const -> D3D12_GPU_VIRTUAL_ADDRESS {
-		return get_native_res(*this)->GetGPUVirtualAddress();
+		return get_hot_res(static_cast<u32>(handle)).gpu_addr;
 	}
 
-	Resource<Buffer> Resource<Buffer>::operator>>(const std::string_view& name) const {
-		c.resource_registry.named_resource_map[name] = static_cast<u32>(this->handle);
+	Resource<Buffer> Resource<Buffer>::operator>>(const NameId& name) const {
+		auto& reg = c.resource_registry;
+		reg.names.note(name);
+		reg.named_resource_map[name.value] = static_cast<u32>(this->handle);
+		reg.cold[reg.get_slot(static_cast<u32>(this->handle))].name = name;
 		return *this;
 	}
 
+	Resource<Buffer> Resource<Buffer>::operator>>(const std::string_view& name) const {
+		return *this >> intern_name(name);
+	}
+
 	auto Resource<Buffer>::map_and_copy(ByteSpan data, usize offset) const -> void {
+		if (c.headless) {
+			c.headless_stats.mapped_bytes += data.size();
+			return;
+		}
 		void* mapped;
 		auto res = d::get_native_res(static_cast<u32>(handle));
 		DX_CHECK(res->Map(0, nullptr, &mapped));
@@ -329,12 +403,12 @@ namespace d {
 	}
 
 	[[nodiscard]] auto Resource<Buffer>::gpu_addr() const -> D3D12_GPU_VIRTUAL_ADDRESS {
-		return get_native_res(*this)->GetGPUVirtualAddress();
+		return get_hot_res(static_cast<u32>(handle)).gpu_addr;
 	}
 
 	[[nodiscard]] auto Resource<Buffer>::gpu_strided_addr(usize stride) const -> D3D12_GPU_VIRTUAL_ADDRESS_AND_STRIDE {
 		return D3D12_GPU_VIRTUAL_ADDRESS_AND_STRIDE{
-			.StartAddress = get_native_res(*this)->GetGPUVirtualAddress(),
+			.StartAddress = get_hot_res(static_cast<u32>(handle)).gpu_addr,
 			.StrideInBytes = stride,
 		};
 	}
@@ -358,7 +432,7 @@ namespace d {
 		u32 num_indices) const
 		-> D3D12_INDEX_BUFFER_VIEW {
 		return D3D12_INDEX_BUFFER_VIEW{
-				.BufferLocation = get_native_res(*this)->GetGPUVirtualAddress() +
+				.BufferLocation = get_hot_res(static_cast<u32>(handle)).gpu_addr +
 													index_offset.value_or(0u) * sizeof(u32),
 				.SizeInBytes = num_indices * static_cast<UINT>(sizeof(u32)),
 				.Format = DXGI_FORMAT_R32_UINT,
@@ -1,9 +1,13 @@
 #include "d/ResourceCreator.h"
 #include "d/Context.h"
 
+#include <DirectXTex.h>
+
+#include <bit>
+
 namespace d {
 
-	auto ResourceRegistry::create_buffer(const BufferCreateInfo& create_info) const -> Resource<Buffer> {
+	auto get_resource_desc(const BufferCreateInfo& create_info) -> D3D12_RESOURCE_DESC {
 		auto resource_desc = D3D12_RESOURCE_DESC{
 				.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
 				.Width = create_info.size,
@@ -16,20 +20,113 @@ namespace d {
 		};
 		resource_desc.SampleDesc.Count = 1;
 		resource_desc.SampleDesc.Quality = 0;
+		if (create_info.usage == MemoryUsage::GPU_Writable) resource_desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+		return resource_desc;
+	}
+
+	auto get_resource_desc(const TextureCreateInfo& texture_info) -> D3D12_RESOURCE_DESC {
+		D3D12_RESOURCE_FLAGS res_flags = D3D12_RESOURCE_FLAG_NONE;
+		if (texture_info.usage == TextureUsage::RENDER_TARGET) {
+			res_flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+		}
+		else if (texture_info.usage == TextureUsage::DEPTH_STENCIL) {
+			res_flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+		}
+		if (texture_info.usage == TextureUsage::SHADER_READ_WRITE_ATOMIC) {
+			res_flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+		}
+		return CD3DX12_RESOURCE_DESC::Tex2D(
+			texture_info.format, texture_info.extent.width,
+			texture_info.extent.height, static_cast<UINT16>(texture_info.extent.array_size), static_cast<UINT16>(texture_info.num_mips), 1, 0,
+			res_flags);
+	}
+
+	auto get_headless_allocation_info(const D3D12_RESOURCE_DESC& desc) -> D3D12_RESOURCE_ALLOCATION_INFO {
+		constexpr u64 alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		u64 size = desc.Width;
+		if (desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER) {
+			const u64 bits_per_texel = DirectX::BitsPerPixel(desc.Format);
+			size = 0;
+			// 0 mips is a full chain, same as the device resolves it
+			const u32 num_mips = desc.MipLevels ? desc.MipLevels : std::bit_width(std::max<u64>(desc.Width, desc.Height));
+			for (u32 mip = 0; mip < num_mips; ++mip) {
+				const u64 width = std::max<u64>(desc.Width >> mip, 1);
+				const u64 height = std::max<u64>(desc.Height >> mip, 1);
+				size += (width * height * bits_per_texel + 7) / 8;
+			}
+			size *= desc.DepthOrArraySize;
+		}
+		return D3D12_RESOURCE_ALLOCATION_INFO{
+			.SizeInBytes = (size + alignment - 1) / alignment * alignment,
+			.Alignment = alignment,
+		};
+	}
+
+	auto get_copyable_footprints(const D3D12_RESOURCE_DESC& desc) -> std::vector<SubresourceFootprint> {
+		assert_log(desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER, "buffers have no subresource footprints");
+		const bool is_3d = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+		// 0 mips is a full chain, the created resource has it resolved already
+		const u32 num_mips = desc.MipLevels ? desc.MipLevels : std::bit_width(std::max<u64>(desc.Width, desc.Height));
+		const u32 num_subresources = num_mips * (is_3d ? 1u : desc.DepthOrArraySize);
+		std::vector<SubresourceFootprint> footprints(num_subresources);
+
+		if (!c.headless) {
+			std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(num_subresources);
+			std::vector<UINT> num_rows(num_subresources);
+			std::vector<UINT64> row_sizes(num_subresources);
+			c.device->GetCopyableFootprints(&desc, 0, num_subresources, 0, layouts.data(), num_rows.data(), row_sizes.data(), nullptr);
+			for (u32 i = 0; i < num_subresources; ++i) footprints[i] = SubresourceFootprint{ .layout = layouts[i], .num_rows = num_rows[i], .row_size = row_sizes[i] };
+			return footprints;
+		}
+
+		u64 offset = 0;
+		for (u32 i = 0; i < num_subresources; ++i) {
+			const u32 mip = i % num_mips;
+			const auto width = static_cast<u32>(std::max<u64>(desc.Width >> mip, 1));
+			const u32 height = std::max(desc.Height >> mip, 1u);
+			const u32 depth = is_3d ? std::max<u32>(desc.DepthOrArraySize >> mip, 1) : 1;
+			usize row_pitch, slice_pitch;
+			DX_CHECK(DirectX::ComputePitch(desc.Format, width, height, row_pitch, slice_pitch));
+			const u64 aligned_pitch = (row_pitch + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) / D3D12_TEXTURE_DATA_PITCH_ALIGNMENT * D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+			const auto rows = static_cast<u32>(slice_pitch / row_pitch);
+			footprints[i] = SubresourceFootprint{
+				.layout = {
+					.Offset = offset,
+					.Footprint = {.Format = desc.Format, .Width = width, .Height = height, .Depth = depth, .RowPitch = static_cast<UINT>(aligned_pitch) },
+				},
+				.num_rows = rows,
+				.row_size = row_pitch,
+			};
+			offset += aligned_pitch * rows * depth;
+			offset = (offset + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) / D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT * D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+		}
+		return footprints;
+	}
+
+	namespace {
+		auto register_headless(const D3D12_RESOURCE_DESC& desc, ResourceType type) -> Handle {
+			++c.headless_stats.num_resources;
+			c.headless_stats.resource_bytes += get_headless_allocation_info(desc).SizeInBytes;
+			const Handle handle = c.register_resource(nullptr, nullptr, ResourceState{ .type = type, .access_state = D3D12_BARRIER_ACCESS_COMMON });
+			c.resource_registry.cold[get_handle_index(handle)].headless_desc = desc;
+			return handle;
+		}
+	}
+
+	auto ResourceRegistry::create_buffer(const BufferCreateInfo& create_info) const -> Resource<Buffer> {
+		const auto resource_desc = get_resource_desc(create_info);
+		if (c.headless) return Resource<Buffer>(register_headless(resource_desc, ResourceType::Buffer));
 
 		D3D12MA::ALLOCATION_DESC allocation_desc = {};
 		D3D12_BARRIER_ACCESS access_state = D3D12_BARRIER_ACCESS_COMMON;
 		switch (create_info.usage) {
 		case MemoryUsage::GPU:
+		case MemoryUsage::GPU_Writable:
 			allocation_desc.HeapType = D3D12_HEAP_TYPE_DEFAULT;
 			break;
 		case MemoryUsage::Mappable:
 			allocation_desc.HeapType = D3D12_HEAP_TYPE_UPLOAD;
 			break;
-		case MemoryUsage::GPU_Writable:
-			allocation_desc.HeapType = D3D12_HEAP_TYPE_DEFAULT;
-			resource_desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-			break;
 		case MemoryUsage::CPU_Readable:
 			allocation_desc.HeapType = D3D12_HEAP_TYPE_READBACK;
 			break;
@@ -47,28 +144,15 @@ namespace d {
 		return Resource<Buffer>(handle);
 	}
 
-	auto create_texture_2d(const TextureCreateInfo& texture_info) -> Resource<D2> {
-		D3D12_RESOURCE_FLAGS res_flags = D3D12_RESOURCE_FLAG_NONE;
-		if (texture_info.usage == TextureUsage::RENDER_TARGET) {
-			res_flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
-		}
-		else if (texture_info.usage == TextureUsage::DEPTH_STENCIL) {
-			res_flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
-		}
-		if (texture_info.usage == TextureUsage::SHADER_READ_WRITE_ATOMIC) {
-			res_flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-		}
-		// TODO: mip levels hard coded right now :(
-		auto desc = CD3DX12_RESOURCE_DESC::Tex2D(
-			texture_info.format, texture_info.extent.width,
-			texture_info.extent.height, 1, 1, 1, 0,
-			res_flags);
-		
+	auto ResourceRegistry::create_texture_2d(const TextureCreateInfo& texture_info) const -> Resource<D2> {
+		const auto desc = get_resource_desc(texture_info);
+		const auto type = texture_info.extent.array_size > 1 ? ResourceType::D2Array : ResourceType::D2;
+		if (c.headless) return Resource<D2>(register_headless(desc, type));
 
 		ComPtr<D3D12MA::Allocation> allocation;
 		ComPtr<ID3D12Resource> resource;
 
-		// TODO: add readback functionality
+		// read back through ReadbackRing, textures never live in readback heaps themselves
 		const D3D12MA::ALLOCATION_DESC allocation_desc = {
 			.HeapType = D3D12_HEAP_TYPE_DEFAULT,
 		};
@@ -76,9 +160,21 @@ namespace d {
 		DX_CHECK(c.allocator->CreateResource(&allocation_desc, &desc, D3D12_RESOURCE_STATE_COMMON, nullptr,
 			&allocation, IID_PPV_ARGS(&resource)));
 
-		const u32 handle = c.register_resource(resource, allocation, ResourceState {.type = ResourceType::D2, .access_state = D3D12_BARRIER_ACCESS_COMMON });
+		const u32 handle = c.register_resource(resource, allocation, ResourceState {.type = type, .access_state = D3D12_BARRIER_ACCESS_COMMON });
 		return Resource<D2>(handle);
 	}
+
+	auto ResourceRegistry::get_desc(Handle handle) const -> D3D12_RESOURCE_DESC {
+		const u32 index = get_slot(handle);
+		if (cold[index].resource) return cold[index].resource->GetDesc();
+		assert_log(cold[index].headless_desc.has_value(), "resource has neither a native resource nor a headless desc");
+		auto desc = *cold[index].headless_desc;
+		// resolved like the device would have on creation
+		if (desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER && desc.MipLevels == 0) {
+			desc.MipLevels = static_cast<UINT16>(std::bit_width(std::max<u64>(desc.Width, desc.Height)));
+		}
+		return desc;
+	}
 	
 }
 
@@ -3,7 +3,11 @@
 //
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <limits>
+#include <stdexcept>
 #define NOMINMAX
 #include "DirectXTex.h"
 
@@ -11,60 +15,184 @@
 #include "d/Context.h"
 
 namespace d {
-	Stager::Stager() {
-		async_transfer.init(QueueType::GENERAL);
-		list = async_transfer.get_command_list();
-		max_stage_size = 0u;
-	}
-
-	//Resource<D2> Stager::stage_texture_from_file(const char* path) {
-	//	using namespace DirectX;
-	//	const std::filesystem::path texture_path(path);
-	//	TexMetadata metadata;
-	//	ScratchImage scratch_image;
-
-	//	if (!std::filesystem::exists(texture_path)) {
-	//		err_log("Cannot find texture file: {} ", path);
-	//		throw std::exception("File not found.");
-	//	}
-	//	if (texture_path.extension() == ".dds") {
-	//		DX_CHECK(LoadFromDDSFile(texture_path.c_str(), DDS_FLAGS_FORCE_RGB,
-	//			&metadata, scratch_image));
-	//	}
-	//	else if (texture_path.extension() == ".hdr") {
-	//		DX_CHECK(LoadFromHDRFile(texture_path.c_str(), &metadata, scratch_image));
-	//	}
-	//	else if (texture_path.extension() == ".tga") {
-	//		DX_CHECK(LoadFromTGAFile(texture_path.c_str(), &metadata, scratch_image));
-	//	}
-	//	else {
-	//		DX_CHECK(LoadFromWICFile(texture_path.c_str(), WIC_FLAGS_FORCE_RGB,
-	//			&metadata, scratch_image));
-	//	}
-	//	Resource<D2> texture = c.create_texture_2d(TextureCreateInfo{
-	//			.format = DXGI_FORMAT_R8G8B8A8_UNORM,
-	//			.dim = TextureDimension::D2,
-	//			.extent = TextureExtent{.width = static_cast<u32>(metadata.width),
-	//															.height = static_cast<u32>(metadata.height)},
-	//			.usage = TextureUsage::SHADER_READ,
-	//		});
-	//	texture_entries.emplace_back(TextureStageEntry{
-	//		.texture = texture,
-	//		.metadata = std::move(metadata),
-	//		.scratch = std::move(scratch_image),
-	//		});
-	//	std::vector<D3D12_SUBRESOURCE_DATA> subresources;
-
-	//	//PrepareUpload(c.device, scratch_image.GetImages(), scratch_image.GetImageCount(), metadata,
-	//	//	  subresources);
-
-	//	u32 stage_size = static_cast<u32>(GetRequiredIntermediateSize(get_native_res(texture),
-	//		0, static_cast<unsigned int>(subresources.size())));
-	//	return texture;
-	//}
+	auto UploadRing::init(u64 size) -> void {
+		capacity = size;
+		head = tail = 0;
+		batches.clear();
+		lists.clear();
+		stats = {};
+		buffer = c.resource_registry.create_buffer(BufferCreateInfo{ .size = size, .usage = MemoryUsage::Mappable });
+		write_combined = !c.headless;
+		if (c.headless) {
+			host_memory.resize(size);
+			mapped = host_memory.data();
+			return;
+		}
+		// upload heaps can stay mapped for as long as the resource lives, the cpu never reads them back
+		const auto no_read = D3D12_RANGE{ .Begin = 0, .End = 0 };
+		void* data;
+		DX_CHECK(get_native_res(buffer)->Map(0, &no_read, &data));
+		mapped = static_cast<std::byte*>(data);
+	}
+
+	auto fit_ring_allocation(u64 head, u64 tail, u64 capacity, u64 size, u64 alignment) -> std::optional<u64> {
+		u64 begin = (head + alignment - 1) / alignment * alignment;
+		if (begin % capacity + size > capacity) begin += capacity - begin % capacity;
+		if (begin + size - tail > capacity) return std::nullopt;
+		return begin;
+	}
+
+	auto UploadRing::allocate(u64 size, u64 alignment) -> std::optional<u64> {
+		// waiting on older batches can't make room for it either
+		if (size > capacity) return std::nullopt;
+		// reclaiming can move head back to the front, so the fit has to be redone after it
+		auto begin = fit_ring_allocation(head, tail, capacity, size, alignment);
+		if (!begin) {
+			reclaim();
+			begin = fit_ring_allocation(head, tail, capacity, size, alignment);
+		}
+		if (!begin) return std::nullopt;
+		head = *begin + size;
+		return *begin % capacity;
+	}
+
+	auto UploadRing::acquire_list() -> CommandList& {
+		const u64 completed = c.async_transfer_queue.get_completed_value();
+		auto it = std::ranges::find_if(lists, [&](const auto& list) { return list.second <= completed; });
+		if (it == lists.end()) {
+			lists.emplace_back(c.async_transfer_queue.get_command_list(), 0);
+			it = std::prev(lists.end());
+		}
+		// handed out, not reusable until it got submitted and that submission finished
+		it->second = std::numeric_limits<u64>::max();
+		return it->first.record();
+	}
+
+	auto UploadRing::submit(CommandList& list) -> u64 {
+		auto& queue = c.async_transfer_queue;
+		list.finish();
+		queue.submit_lists({ list });
+		batches.emplace_back(queue.fence_val, head);
+		++stats.num_batches;
+		for (auto& [l, fence] : lists) {
+			if (&l == &list) fence = queue.fence_val;
+		}
+		return queue.fence_val;
+	}
+
+	auto UploadRing::wait_oldest() -> void {
+		assert_log(!batches.empty(), "upload ring is full without anything in flight");
+		c.async_transfer_queue.block_until(batches.front().first);
+		reclaim();
+	}
+
+	auto UploadRing::reclaim() -> void {
+		const u64 completed = c.async_transfer_queue.get_completed_value();
+		while (!batches.empty() && batches.front().first <= completed) {
+			tail = batches.front().second;
+			batches.pop_front();
+		}
+		// nothing in flight or being packed, start over at the front so a ring sized upload fits again
+		if (batches.empty() && tail == head) head = tail = 0;
+	}
+
+	auto UploadRing::report_stats() const -> void {
+		if (!stats.num_copies) return;
+		info_log("UploadRing: {} copies ({:.2f} MB) in {} copy queue batches, the {:.2f} MB ring ran full {} times",
+			stats.num_copies, stats.num_bytes / 1048576., stats.num_batches, capacity / 1048576., stats.num_full_waits);
+		if (stats.num_decompressed_bytes) {
+			info_log("UploadRing: {:.2f} MB decompressed from {:.2f} MB in {:.3f} ms ({:.1f} MB/s)",
+				stats.num_decompressed_bytes / 1048576., stats.num_compressed_bytes / 1048576., stats.decompress_ms,
+				stats.num_decompressed_bytes / 1048576. / (stats.decompress_ms / 1e3));
+		}
+	}
+
+	auto ResourceFuture::ready() const -> bool {
+		return c.get_queue(work_queue).get_completed_value() >= fence_value;
+	}
+
+	auto ResourceFuture::wait() const -> void {
+		c.get_queue(work_queue).block_until(fence_value);
+	}
+
+	namespace {
+		auto get_texture_desc(const DirectX::TexMetadata& metadata) -> D3D12_RESOURCE_DESC {
+			return CD3DX12_RESOURCE_DESC::Tex2D(metadata.format, metadata.width, static_cast<UINT>(metadata.height),
+				static_cast<UINT16>(metadata.arraySize), static_cast<UINT16>(metadata.mipLevels));
+		}
+
+		// the source rows are tightly packed, so they're copied one by one into the padded rows of the footprint at dst
+		auto write_subresource(const SubresourceFootprint& footprint, const DirectX::ScratchImage& image, u32 subresource, std::byte* dst) -> void {
+			const auto& [layout, num_rows, row_size] = footprint;
+			const auto num_mips = static_cast<u32>(image.GetMetadata().mipLevels);
+			const u64 slice_size = static_cast<u64>(layout.Footprint.RowPitch) * num_rows;
+			for (u32 z = 0; z < layout.Footprint.Depth; ++z) {
+				const auto* src = image.GetImage(subresource % num_mips, subresource / num_mips, z);
+				const usize copy_size = std::min<usize>(row_size, src->rowPitch);
+				for (u32 row = 0; row < num_rows; ++row) {
+					memcpy(dst + z * slice_size + static_cast<usize>(row) * layout.Footprint.RowPitch, src->pixels + row * src->rowPitch, copy_size);
+				}
+			}
+		}
+	}
+
+	auto Stager::stage_texture_from_file(const char* path, bool generate_mips) -> Resource<D2> {
+		using namespace DirectX;
+		const std::filesystem::path texture_path(path);
+		TexMetadata metadata;
+		ScratchImage scratch_image;
+
+		if (!std::filesystem::exists(texture_path)) {
+			err_log("Cannot find texture file: {} ", path);
+			throw std::runtime_error("File not found.");
+		}
+		if (texture_path.extension() == ".dds") {
+			DX_CHECK(LoadFromDDSFile(texture_path.c_str(), DDS_FLAGS_FORCE_RGB,
+				&metadata, scratch_image));
+		}
+		else if (texture_path.extension() == ".hdr") {
+			DX_CHECK(LoadFromHDRFile(texture_path.c_str(), &metadata, scratch_image));
+		}
+		else if (texture_path.extension() == ".tga") {
+			DX_CHECK(LoadFromTGAFile(texture_path.c_str(), &metadata, scratch_image));
+		}
+		else {
+			DX_CHECK(LoadFromWICFile(texture_path.c_str(), WIC_FLAGS_FORCE_RGB,
+				&metadata, scratch_image));
+		}
+		assert_log(metadata.dimension == TEX_DIMENSION_TEXTURE2D && !metadata.IsCubemap(), "only 2d textures and texture arrays can be staged");
+
+		// dds files bring their own chain, everything else gets one down to 1x1. block compressed data can't be filtered
+		if (generate_mips && metadata.mipLevels == 1 && !IsCompressed(metadata.format) && (metadata.width > 1 || metadata.height > 1)) {
+			ScratchImage mip_chain;
+			DX_CHECK(GenerateMipMaps(scratch_image.GetImages(), scratch_image.GetImageCount(), metadata, TEX_FILTER_DEFAULT, 0, mip_chain));
+			scratch_image = std::move(mip_chain);
+			metadata = scratch_image.GetMetadata();
+		}
+
+		const auto texture = c.resource_registry.create_texture_2d(TextureCreateInfo{
+				.format = metadata.format,
+				.dim = TextureDimension::D2,
+				.extent = TextureExtent{.width = static_cast<u32>(metadata.width),
+																.height = static_cast<u32>(metadata.height),
+																.array_size = static_cast<u32>(metadata.arraySize)},
+				.usage = TextureUsage::SHADER_READ,
+				.num_mips = static_cast<u32>(metadata.mipLevels),
+			});
+		stage_texture(texture, std::move(scratch_image));
+		return texture;
+	}
+
+	auto Stager::stage_texture(Resource<D2> dst, DirectX::ScratchImage&& image) -> void {
+		const auto metadata = image.GetMetadata();
+		texture_entries.emplace_back(TextureStageEntry{
+			.texture = dst,
+			.metadata = metadata,
+			.scratch = std::move(image),
+			});
+	}
 
 	auto Stager::stage_buffer(Resource<Buffer> dst, ByteSpan data) -> void {
-		max_stage_size = std::max(static_cast<u32>(data.size()), max_stage_size);
 		buffer_entries.emplace_back(BufferStageEntry{
 				.data = data,
 				.buffer = dst,
@@ -72,23 +200,213 @@ namespace d {
 		//return *this;
 	}
 
-	auto Stager::stage_block_until_over() -> void {
-		Resource<Buffer> stage = c.resource_registry.create_buffer(BufferCreateInfo{
-				.size = max_stage_size,
-				.usage = MemoryUsage::Mappable,
+	auto Stager::stage_compressed_buffer(Resource<Buffer> dst, ByteSpan payload) -> void {
+		compressed_entries.emplace_back(CompressedStageEntry{ .payload = payload, .dst = dst });
+	}
+
+	auto Stager::stage_compressed_texture(Resource<D2> dst, const DirectX::TexMetadata& metadata, ByteSpan payload) -> void {
+		compressed_entries.emplace_back(CompressedStageEntry{ .payload = payload, .dst = dst, .texture = metadata });
+	}
+
+	auto Stager::pack_texture_upload(const DirectX::ScratchImage& image) -> std::vector<std::byte> {
+		const auto footprints = get_copyable_footprints(get_texture_desc(image.GetMetadata()));
+		const auto& last = footprints.back();
+		std::vector<std::byte> packed(last.layout.Offset + static_cast<u64>(last.layout.Footprint.RowPitch) * last.num_rows * last.layout.Footprint.Depth);
+		for (u32 subresource = 0; subresource < static_cast<u32>(footprints.size()); ++subresource) {
+			write_subresource(footprints[subresource], image, subresource, packed.data() + footprints[subresource].layout.Offset);
+		}
+		return packed;
+	}
+
+	auto Stager::flush() -> std::span<const ResourceFuture> {
+		futures.clear();
+		if (buffer_entries.empty() && texture_entries.empty() && compressed_entries.empty()) return futures;
+		auto& ring = c.upload_ring;
+		auto* list = &ring.acquire_list();
+
+		// chunks of compressed payloads and where they go in the ring, decompressed by workers before the batch using
+		// them gets submitted. lz4 reads back what it wrote, which write combined memory is terrible at, so there every
+		// worker decompresses into its chunk sized bounce buffer that stays in its cache and streams that into the ring
+		struct DecompressJob {
+			PayloadCodec codec;
+			PayloadChunk chunk;
+			usize payload; // into pending_payloads
+			bool ok;
+		};
+		// compressed entries of the batch being packed, their copies are only recorded once every chunk decompressed fine
+		struct PendingPayload {
+			const CompressedStageEntry* entry;
+			u64 offset;
+			u64 size;
+			usize future;
+			bool ok;
+		};
+		std::vector<DecompressJob> decompress_jobs;
+		std::vector<PendingPayload> pending_payloads;
+		const auto count_copy = [&](u64 size) {
+			if (c.headless) c.headless_stats.mapped_bytes += size;
+			++ring.stats.num_copies;
+			ring.stats.num_bytes += size;
+		};
+		const auto decompress = [&] {
+			if (decompress_jobs.empty()) return;
+			const auto t0 = std::chrono::high_resolution_clock::now();
+			const u32 num_threads = static_cast<u32>(std::clamp<usize>(max_decompression_threads, 1,
+				std::min<usize>(c.workers->num_workers() + 1, decompress_jobs.size())));
+			if (bounce_buffers.size() < num_threads) bounce_buffers.resize(num_threads);
+			if (ring.write_combined) {
+				u32 max_chunk_size = 0;
+				for (const auto& job : decompress_jobs) max_chunk_size = std::max(max_chunk_size, job.chunk.size);
+				for (auto& bounce : std::span(bounce_buffers).first(num_threads)) {
+					if (bounce.size() < max_chunk_size) bounce.resize(max_chunk_size);
+				}
+			}
+			std::atomic<usize> next_job{ 0 };
+			c.workers->run(num_threads, [&](u32 thread_index) {
+				const auto bounce = std::span(bounce_buffers[thread_index]);
+				for (usize i = next_job++; i < decompress_jobs.size(); i = next_job++) {
+					auto& [codec, chunk, payload, ok] = decompress_jobs[i];
+					const auto dst = std::span(ring.mapped + chunk.dst_offset, chunk.size);
+					if (!ring.write_combined || chunk.src.size() == chunk.size) {
+						ok = decompress_chunk(codec, chunk.src, dst);
+						continue;
+					}
+					ok = decompress_chunk(codec, chunk.src, bounce.first(chunk.size));
+					if (ok) memcpy(dst.data(), bounce.data(), chunk.size);
+				}
 			});
-		// super dumb, but it works for now lmao
-		for (auto const entry : buffer_entries) {
-			list.record()
-				.copy_buffer_region(stage, entry.buffer, entry.data.size())
-				.finish();
-			stage.map_and_copy(entry.data);
-			async_transfer.submit_lists({ list });
-			async_transfer.block_until_idle();
-		}
-		
-		c.release_resource(static_cast<Handle>(stage));
+			for (const auto& job : decompress_jobs) {
+				pending_payloads[job.payload].ok &= job.ok;
+				ring.stats.num_compressed_bytes += job.chunk.src.size();
+				ring.stats.num_decompressed_bytes += job.chunk.size;
+			}
+			ring.stats.decompress_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+			decompress_jobs.clear();
+
+			// a payload decompresses to one range of the ring, textures to all their footprints back to back
+			for (const auto& [entry, offset, size, future, ok] : pending_payloads) {
+				if (!ok) {
+					err_log("corrupt compressed asset payload, its resource is left as it was");
+					futures[future].failed = true;
+					continue;
+				}
+				if (!entry->texture) {
+					list->copy_buffer_region(ring.buffer, Resource<Buffer>(entry->dst), size, offset);
+				}
+				else {
+					const auto footprints = get_copyable_footprints(get_texture_desc(*entry->texture));
+					for (u32 subresource = 0; subresource < static_cast<u32>(footprints.size()); ++subresource) {
+						auto placed = footprints[subresource].layout;
+						placed.Offset += offset;
+						list->copy_texture_region(ring.buffer, placed, entry->dst, subresource);
+					}
+				}
+				count_copy(size);
+			}
+			pending_payloads.clear();
+		};
+
+		// futures of entries whose last copy is in the batch being packed
+		usize first_unsubmitted = 0;
+		const auto submit = [&] {
+			decompress();
+			const u64 fence_value = ring.submit(*list);
+			for (usize i = first_unsubmitted; i < futures.size(); ++i) {
+				if (!futures[i].failed) futures[i].fence_value = fence_value;
+			}
+			first_unsubmitted = futures.size();
+		};
+		// callers check that size fits the ring at all, waiting on older batches can't make room for more than that
+		const auto reserve = [&](u64 size, u64 alignment) -> u64 {
+			auto offset = ring.allocate(size, alignment);
+			if (offset) return *offset;
+			++ring.stats.num_full_waits;
+			submit();
+			list = &ring.acquire_list();
+			while (!(offset = ring.allocate(size, alignment))) ring.wait_oldest();
+			return *offset;
+		};
+		// a staged resource nothing gets uploaded to, its future is ready right away
+		const auto fail = [&](Handle res, const char* reason) {
+			err_log("{}, its resource is left as it was", reason);
+			futures.emplace_back(ResourceFuture{ .work_queue = QueueType::ASYNC_TRANSFER, .res = res, .failed = true });
+		};
+
+		for (const auto& entry : buffer_entries) {
+			for (usize done = 0; done < entry.data.size();) {
+				const u64 size = std::min<u64>(entry.data.size() - done, ring.capacity);
+				const u64 offset = reserve(size, buffer_upload_alignment);
+				memcpy(ring.mapped + offset, entry.data.data() + done, size);
+				list->copy_buffer_region(ring.buffer, entry.buffer, size, offset, done);
+				count_copy(size);
+				done += size;
+			}
+			futures.emplace_back(ResourceFuture{ .work_queue = QueueType::ASYNC_TRANSFER, .res = entry.buffer });
+		}
+
+		// every subresource goes into the ring on its own, placed and pitched the way CopyTextureRegion wants it
+		for (const auto& entry : texture_entries) {
+			const auto footprints = get_copyable_footprints(get_texture_desc(entry.metadata));
+			const auto get_size = [&](u32 subresource) {
+				const auto& layout = footprints[subresource].layout;
+				return static_cast<u64>(layout.Footprint.RowPitch) * footprints[subresource].num_rows * layout.Footprint.Depth;
+			};
+			bool fits = true;
+			for (u32 subresource = 0; subresource < static_cast<u32>(footprints.size()); ++subresource) fits &= get_size(subresource) <= ring.capacity;
+			if (!fits) {
+				fail(entry.texture, "staged texture has a subresource larger than the upload ring");
+				continue;
+			}
+			for (u32 subresource = 0; subresource < static_cast<u32>(footprints.size()); ++subresource) {
+				const u64 size = get_size(subresource);
+				const u64 offset = reserve(size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+				write_subresource(footprints[subresource], entry.scratch, subresource, ring.mapped + offset);
+				auto placed = footprints[subresource].layout;
+				placed.Offset = offset;
+				list->copy_texture_region(ring.buffer, placed, entry.texture, subresource);
+				count_copy(size);
+			}
+			futures.emplace_back(ResourceFuture{ .work_queue = QueueType::ASYNC_TRANSFER, .res = entry.texture });
+		}
+
+		// payloads are checked before they get any ring space, corrupt chunks only show while decompressing though
+		for (const auto& entry : compressed_entries) {
+			auto parsed = parse_payload(entry.payload);
+			if (!parsed) {
+				fail(entry.dst, "staged data is not a compressed asset payload");
+				continue;
+			}
+			auto& [header, chunks] = *parsed;
+			if (header.size > ring.capacity) {
+				fail(entry.dst, "compressed payload decompresses to more than the upload ring holds");
+				continue;
+			}
+			if (entry.texture) {
+				const auto footprints = get_copyable_footprints(get_texture_desc(*entry.texture));
+				const auto& last = footprints.back();
+				if (header.size != last.layout.Offset + static_cast<u64>(last.layout.Footprint.RowPitch) * last.num_rows * last.layout.Footprint.Depth) {
+					fail(entry.dst, "compressed texture payload doesn't match the footprints of its texture");
+					continue;
+				}
+			}
+			// a full ring submits what was packed so far, including the payloads pending in it
+			const u64 offset = reserve(header.size, entry.texture ? D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT : buffer_upload_alignment);
+			pending_payloads.emplace_back(PendingPayload{ .entry = &entry, .offset = offset, .size = header.size, .future = futures.size(), .ok = true });
+			for (auto chunk : chunks) {
+				chunk.dst_offset += offset;
+				decompress_jobs.emplace_back(DecompressJob{ .codec = header.codec, .chunk = chunk, .payload = pending_payloads.size() - 1, .ok = false });
+			}
+			futures.emplace_back(ResourceFuture{ .work_queue = QueueType::ASYNC_TRANSFER, .res = entry.dst });
+		}
+		submit();
 		buffer_entries.clear();
-		//return *this;
+		texture_entries.clear();
+		compressed_entries.clear();
+		return futures;
+	}
+
+	auto Stager::stage_block_until_over() -> void {
+		// the copy queue runs its batches in order, the last one finishing covers all of them
+		if (const auto done = flush(); !done.empty()) done.back().wait();
 	}
 } // namespace d
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "d/TransientResources.h"
+#include "d/Context.h"
+
+#include <algorithm>
+
+namespace d {
+
+	namespace {
+		auto align_up(u64 value, u64 alignment) -> u64 {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		auto get_heap_flags(TransientHeapKind kind) -> D3D12_HEAP_FLAGS {
+			switch (kind) {
+			case TransientHeapKind::eBuffer: return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+			case TransientHeapKind::eTargetTexture: return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+			default: return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+			}
+		}
+	}
+
+	TransientResources::~TransientResources() {
+		for (const auto& res : resources) c.release_resource(res.handle);
+	}
+
+	auto TransientResources::add(const D3D12_RESOURCE_DESC& desc, TransientHeapKind heap_kind, ResourceType type) -> Handle {
+		const auto allocation_info = c.headless ? get_headless_allocation_info(desc) : c.device->GetResourceAllocationInfo(0, 1, &desc);
+		const Handle handle = c.register_resource(nullptr, nullptr, ResourceState{ .type = type, .transient = true });
+		resource_indices[handle] = static_cast<u32>(resources.size());
+		resources.emplace_back(TransientResource{
+			.handle = handle,
+			.desc = desc,
+			.heap_kind = heap_kind,
+			.size = allocation_info.SizeInBytes,
+			.alignment = allocation_info.Alignment,
+			});
+		return handle;
+	}
+
+	auto TransientResources::create_buffer(const BufferCreateInfo& info) -> Resource<Buffer> {
+		assert_log(info.usage == MemoryUsage::GPU || info.usage == MemoryUsage::GPU_Writable, "transient buffers have to live on the gpu");
+		return Resource<Buffer>(add(get_resource_desc(info), TransientHeapKind::eBuffer, ResourceType::Buffer));
+	}
+
+	auto TransientResources::create_texture_2d(const TextureCreateInfo& info) -> Resource<D2> {
+		const bool is_target = info.usage == TextureUsage::RENDER_TARGET || info.usage == TextureUsage::DEPTH_STENCIL;
+		return Resource<D2>(add(get_resource_desc(info), is_target ? TransientHeapKind::eTargetTexture : TransientHeapKind::eTexture, ResourceType::D2));
+	}
+
+	auto TransientResources::find(Handle handle) const -> const TransientResource* {
+		const auto it = resource_indices.find(handle);
+		return it == resource_indices.end() ? nullptr : &resources[it->second];
+	}
+
+	auto TransientResources::place(std::span<const std::optional<TransientLifetime>> lifetimes) -> bool {
+		assert_log(lifetimes.size() == resources.size(), "every transient needs a (possibly empty) lifetime");
+
+		// biggest first, then every transient goes to the lowest offset that doesn't overlap anything alive at the same time
+		std::vector<u32> order;
+		for (u32 i = 0; i < static_cast<u32>(resources.size()); ++i) {
+			resources[i].lifetime = lifetimes[i];
+			resources[i].aliases.clear();
+			if (lifetimes[i].has_value()) order.emplace_back(i);
+		}
+		std::ranges::sort(order, [&](u32 a, u32 b) { return resources[a].size != resources[b].size ? resources[a].size > resources[b].size : a < b; });
+
+		std::vector<std::optional<u64>> offsets(resources.size());
+		std::array<std::vector<u32>, num_transient_heap_kinds> placed;
+		std::array<u64, num_transient_heap_kinds> needed_sizes{};
+		std::vector<std::pair<u64, u64>> taken;
+		for (const auto i : order) {
+			const auto& res = resources[i];
+			const auto kind = static_cast<usize>(res.heap_kind);
+
+			taken.clear();
+			for (const auto j : placed[kind]) {
+				if (resources[j].lifetime->overlaps(*res.lifetime)) taken.emplace_back(*offsets[j], *offsets[j] + resources[j].size);
+			}
+			std::ranges::sort(taken);
+			u64 offset = 0;
+			for (const auto& [begin, end] : taken) {
+				if (offset + res.size <= begin) break;
+				offset = std::max(offset, align_up(end, res.alignment));
+			}
+
+			offsets[i] = offset;
+			placed[kind].emplace_back(i);
+			needed_sizes[kind] = std::max(needed_sizes[kind], offset + res.size);
+		}
+
+		stats.num_placed = static_cast<u32>(order.size());
+		stats.dedicated_bytes = 0;
+		stats.heap_bytes = 0;
+		for (usize kind = 0; kind < num_transient_heap_kinds; ++kind) {
+			for (const auto i : placed[kind]) {
+				auto& res = resources[i];
+				stats.dedicated_bytes += align_up(res.size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+				for (const auto j : placed[kind]) {
+					const auto& prev = resources[j];
+					const bool memory_overlaps = *offsets[i] < *offsets[j] + prev.size && *offsets[j] < *offsets[i] + res.size;
+					if (memory_overlaps && prev.lifetime->last_step < res.lifetime->first_step) res.aliases.emplace_back(prev.handle);
+				}
+			}
+			stats.heap_bytes += needed_sizes[kind];
+		}
+
+		bool replaced = false;
+		for (usize kind = 0; kind < num_transient_heap_kinds; ++kind) {
+			if (needed_sizes[kind] <= heap_sizes[kind]) continue;
+
+			// heaps only grow, everything in the old heap has to be placed again
+			for (auto& res : resources) {
+				if (static_cast<usize>(res.heap_kind) != kind || !res.offset.has_value()) continue;
+				res.offset.reset();
+				c.resource_registry.set_native(res.handle, nullptr);
+			}
+			if (heaps[kind]) c.resource_registry.defer_release(DeferredRelease{ .fences = c.get_fences(), .allocation = std::move(heaps[kind]) });
+			heap_sizes[kind] = align_up(needed_sizes[kind], D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+			const auto allocation_desc = D3D12MA::ALLOCATION_DESC{
+				.HeapType = D3D12_HEAP_TYPE_DEFAULT,
+				.ExtraHeapFlags = get_heap_flags(static_cast<TransientHeapKind>(kind)),
+			};
+			const auto allocation_info = D3D12_RESOURCE_ALLOCATION_INFO{
+				.SizeInBytes = heap_sizes[kind],
+				.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+			};
+			if (!c.headless) DX_CHECK(c.allocator->AllocateMemory(&allocation_desc, &allocation_info, &heaps[kind]));
+			replaced = true;
+		}
+
+		// transients this graph doesn't use keep whatever placement they had
+		for (usize i = 0; i < resources.size(); ++i) {
+			auto& res = resources[i];
+			if (!offsets[i].has_value() || res.offset == offsets[i]) continue;
+
+			ComPtr<ID3D12Resource> native;
+			if (!c.headless) {
+				DX_CHECK(c.allocator->CreateAliasingResource(heaps[static_cast<usize>(res.heap_kind)].Get(), *offsets[i], &res.desc,
+					D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&native)));
+			}
+			c.resource_registry.set_native(res.handle, native);
+			auto& state = get_hot_res(res.handle).state;
+			state.access_state = D3D12_BARRIER_ACCESS_COMMON;
+			state.layout = D3D12_BARRIER_LAYOUT_COMMON;
+			c.resource_registry.refresh_views(res.handle);
+			res.offset = offsets[i];
+			replaced = true;
+		}
+
+		stats.num_replans += replaced ? 1 : 0;
+		return replaced;
+	}
+}
@@ -0,0 +1,49 @@
+#include "d/WorkerPool.h"
+
+#include <algorithm>
+
+namespace d {
+	WorkerPool::WorkerPool(u32 num_workers) {
+		threads.reserve(num_workers);
+		for (u32 i = 0; i < num_workers; ++i) threads.emplace_back([this, i] { work(i + 1); });
+	}
+
+	WorkerPool::~WorkerPool() {
+		stop = true;
+		batch_state.fetch_add(u64{ 1 } << 32);
+		batch_state.notify_all();
+		for (auto& thread : threads) thread.join();
+	}
+
+	auto WorkerPool::run_erased(u32 num_threads, void* data, void (*fn)(void*, u32)) -> void {
+		num_threads = std::min(num_threads, num_workers() + 1);
+		if (num_threads <= 1) {
+			fn(data, 0);
+			return;
+		}
+		job_data = data;
+		job_fn = fn;
+		num_running.store(num_threads - 1, std::memory_order_relaxed);
+		const u64 next_batch = (batch_state.load(std::memory_order_relaxed) >> 32) + 1;
+		batch_state.store(next_batch << 32 | num_threads, std::memory_order_release);
+		batch_state.notify_all();
+
+		fn(data, 0);
+		for (u32 running = num_running.load(std::memory_order_acquire); running != 0; running = num_running.load(std::memory_order_acquire)) {
+			num_running.wait(running, std::memory_order_acquire);
+		}
+	}
+
+	auto WorkerPool::work(u32 thread_index) -> void {
+		u64 seen_state = 0;
+		while (true) {
+			batch_state.wait(seen_state, std::memory_order_acquire);
+			seen_state = batch_state.load(std::memory_order_acquire);
+			if (stop) return;
+			// workers past the batch's thread count sit it out
+			if (thread_index >= static_cast<u32>(seen_state)) continue;
+			job_fn(job_data, thread_index);
+			if (num_running.fetch_sub(1, std::memory_order_acq_rel) == 1) num_running.notify_one();
+		}
+	}
+}
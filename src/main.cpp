@@ -3,11 +3,13 @@
 #include "d/Stager.h"
 #include "d/RayTracing.h"
 #include "d/CommandGraph.h"
+#include "d/HeapAllocations.h"
 #include "d/ResourceCreator.h"
 
 #include <glm/glm.hpp>
 
 #include <glm/ext/matrix_transform.hpp>
+#include <GLFW/glfw3.h>
 
 #include "Camera.h"
 #define TINYOBJLOADER_IMPLEMENTATION // define this in only *one* .cc
@@ -26,7 +28,272 @@ struct Vert {
 
 std::tuple<std::vector<Vert>, std::vector<u32>> load_model(const char* file);
 
-int main() {
+// re-recorded every frame, compiling only hits the graph cache as long as the topology stays the same.
+// uploads still in flight only hold up the draw on the gpu, once they're done the recorder drops them
+auto record_frame(d::CommandGraph& graph, d::Resource<d::Buffer> vbo, d::Resource<d::Buffer> ibo, u32 num_verts, u32 num_indices, const d::GraphicsPipeline& pl,
+	std::span<const d::ResourceFuture> uploads) -> void {
+	struct DrawConsts {
+		u32 vbo_loc;
+	};
+	using namespace d;
+	graph.recorder.reset();
+	auto [recorder] = graph.record();
+	for (const auto& upload : uploads) recorder.wait_for(upload);
+	const auto& output_image = c.swap_chain.images[0];
+	recorder.draw(DrawInfo{
+		.resources = { vbo.ref(AccessDomain::eVertex), output_image.ref(AccessType::eRenderTarget) },
+		.push_constants = {
+			ByteSpan(DrawConsts {
+				.vbo_loc = vbo.read_view(true, 0, num_verts, {})
+											.desc_index(),
+			})
+		},
+		.draw_cmds = {
+			DrawCmd {
+				.ibo_view = ibo.ibo_view(0, num_indices),
+				.index_count_per_instance = num_indices,
+				.instance_count = 1,
+				.start_index_location = 0,
+			},
+		},
+		.pl = &pl,
+		.debug_name = "GBuffer",
+	});
+	recorder.mark_output(output_image);
+	graph.compile();
+}
+
+// same frames against the null backend, no window or gpu needed. the pipeline is never built since there is nothing to bind it on
+auto run_headless(u32 num_frames) -> int {
+	using namespace d;
+	auto& reg = InitHeadlessContext(1280, 720, 3);
+
+	auto [verts, indices] = load_model("assets/models/kitten.obj");
+	const auto vbo = reg.create_buffer(BufferCreateInfo{ .size = ByteSpan(verts).size(), .usage = MemoryUsage::GPU });
+	const auto ibo = reg.create_buffer(BufferCreateInfo{ .size = ByteSpan(indices).size(), .usage = MemoryUsage::GPU });
+	std::vector<ResourceFuture> uploads;
+	{
+		Stager stager;
+		stager.stage_buffer(vbo, ByteSpan(verts));
+		stager.stage_buffer(ibo, ByteSpan(indices));
+		std::ranges::copy(stager.flush(), std::back_inserter(uploads));
+	}
+
+	GraphicsPipeline pl;
+	CommandGraph graph;
+	u32 num_picks = 0;
+	std::optional<ReadbackFuture> last_pick;
+	// the texel in the middle of the swapchain stands in for the one under the cursor
+	const u32 pick_x = c.swap_chain.width / 2;
+	const u32 pick_y = c.swap_chain.height / 2;
+	for (u32 i = 0; i < num_frames; ++i) {
+		const auto [output_image, cl] = c.BeginRendering();
+		record_frame(graph, vbo, ibo, static_cast<u32>(verts.size()), static_cast<u32>(indices.size()), pl, uploads);
+		graph.execute();
+		// picking: the texel under the cursor comes back a few frames later without stalling the frame
+		last_pick = c.readback_ring.request_readback(c.swap_chain.images[0], TextureReadbackRange{
+			.box = D3D12_BOX{ .left = pick_x, .top = pick_y, .front = 0, .right = pick_x + 1, .bottom = pick_y + 1, .back = 1 },
+		}, [&](const ReadbackResult&) { ++num_picks; });
+		c.EndRendering();
+	}
+	const u32 num_picks_in_frame = num_picks;
+	if (last_pick) last_pick->wait();
+	info_log("headless: {} of {} picks delivered within the frame loop, {} after waiting on the last one", num_picks_in_frame, num_frames, num_picks);
+	graph.report_stats();
+	c.report_stats();
+	graph.export_trace("output/graph_trace.json");
+	return 0;
+}
+
+// compiles a graph on the null backend that copies the first half of buffers into the second half and back, so every handle
+// needs a barrier between the two steps. fresh graphs every time so the graph cache never hits. the stats are the last
+// compile's with graphify_ms and flatten_ms averaged over all of them
+auto time_copy_graph(std::span<const d::Resource<d::Buffer>> buffers, u32 num_iterations, bool report) -> d::CommandGraph::Stats {
+	using namespace d;
+	const auto half = static_cast<u32>(buffers.size() / 2);
+	CommandGraph::Stats stats;
+	double graphify_ms = 0.;
+	double flatten_ms = 0.;
+	for (u32 i = 0; i < num_iterations; ++i) {
+		CommandGraph graph;
+		auto [recorder] = graph.record();
+		for (u32 b = 0; b < half; ++b) recorder.copy_buffer(CopyBufferInfo{ .dst = buffers[half + b], .src = buffers[b], .num_bytes = 256 });
+		for (u32 b = 0; b < half; ++b) recorder.copy_buffer(CopyBufferInfo{ .dst = buffers[b], .src = buffers[half + b], .num_bytes = 256 });
+		for (u32 b = 0; b < half; ++b) recorder.mark_output(buffers[b]);
+		graph.compile();
+		graphify_ms += graph.compiled->stats.graphify_ms;
+		flatten_ms += graph.compiled->stats.flatten_ms;
+		stats = graph.compiled->stats;
+		if (report && i + 1 == num_iterations) graph.report_stats();
+	}
+	stats.graphify_ms = graphify_ms / num_iterations;
+	stats.flatten_ms = flatten_ms / num_iterations;
+	return stats;
+}
+
+// barrier building over num_handles buffers, see time_copy_graph
+auto run_barrier_benchmark(u32 num_handles, u32 num_iterations) -> int {
+	using namespace d;
+	auto& reg = InitHeadlessContext(1280, 720, 3);
+	std::vector<Resource<Buffer>> buffers(num_handles);
+	for (auto& buffer : buffers) buffer = reg.create_buffer(BufferCreateInfo{ .size = 256, .usage = MemoryUsage::GPU });
+
+	const auto stats = time_copy_graph(buffers, num_iterations, true);
+	info_log("barrier benchmark: {} handles, {} barriers, {:.3f} ms to graphify and {:.3f} ms to flatten on average over {} compiles",
+		num_handles, stats.num_barriers, stats.graphify_ms, stats.flatten_ms, num_iterations);
+	return 0;
+}
+
+// graphify from 10 to 50k commands with the same copy graph. the hazard table does a constant amount of work per access,
+// so the time per command should stay flat where comparing every pair of commands grew with the size of the graph
+auto run_graphify_benchmark() -> int {
+	using namespace d;
+	constexpr std::array sizes = { 10u, 100u, 1'000u, 10'000u, 50'000u };
+	auto& reg = InitHeadlessContext(1280, 720, 3);
+	std::vector<Resource<Buffer>> buffers(sizes.back());
+	for (auto& buffer : buffers) buffer = reg.create_buffer(BufferCreateInfo{ .size = 256, .usage = MemoryUsage::GPU });
+
+	for (const u32 num_commands : sizes) {
+		// about the same total work for every size, small graphs are too quick to time once
+		const u32 num_iterations = std::max(1'000'000u / num_commands, 3u);
+		const auto stats = time_copy_graph(std::span(buffers).first(num_commands), num_iterations, false);
+		info_log("graphify benchmark: {:>6} commands, {:>6} edges | {:.4f} ms, {:.1f} ns per command over {} compiles",
+			stats.num_commands, stats.num_edges, stats.graphify_ms, stats.graphify_ms * 1e6 / stats.num_commands, num_iterations);
+	}
+	return 0;
+}
+
+// view cache lookups the way desc_index/desc_handle do them every frame: num_views cached texture views with a few mips per
+// texture, looked up in a shuffled order. both maps use the same hash and do a single find, so only the layout differs
+auto run_view_cache_benchmark(u32 num_views, u32 num_iterations) -> int {
+	using namespace d;
+	std::vector<TextureViewInfo> keys;
+	for (u32 i = 0; i < num_views; ++i) {
+		keys.emplace_back(TextureViewInfo{ .resource_handle = make_handle(i / 4, 1), .format = DXGI_FORMAT_R8G8B8A8_UNORM, .mip_slice = i % 4, .type = ResourceType::D2 });
+	}
+
+	std::unordered_map<TextureViewInfo, D3D12_CPU_DESCRIPTOR_HANDLE> node_map;
+	FlatHashMap<TextureViewInfo, D3D12_CPU_DESCRIPTOR_HANDLE> flat_map;
+	for (u32 i = 0; i < num_views; ++i) {
+		node_map[keys[i]] = D3D12_CPU_DESCRIPTOR_HANDLE{ .ptr = i };
+		flat_map[keys[i]] = D3D12_CPU_DESCRIPTOR_HANDLE{ .ptr = i };
+	}
+	std::vector<u32> order(num_views);
+	for (u32 i = 0; i < num_views; ++i) order[i] = static_cast<u32>((i * 2654435761ull) % num_views);
+
+	const auto time_lookups = [&](auto&& lookup) {
+		usize checksum = 0;
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		for (u32 it = 0; it < num_iterations; ++it) {
+			for (const auto i : order) checksum += lookup(keys[i]);
+		}
+		const auto t1 = std::chrono::high_resolution_clock::now();
+		assert_log(checksum != 0 || num_views < 2, "lookups got optimized out");
+		return std::chrono::duration<double, std::nano>(t1 - t0).count() / (static_cast<double>(num_views) * num_iterations);
+	};
+	const double node_ns = time_lookups([&](const TextureViewInfo& key) { const auto it = node_map.find(key); return it != node_map.end() ? it->second.ptr : 0; });
+	const double flat_ns = time_lookups([&](const TextureViewInfo& key) { const auto* handle = flat_map.find(key); return handle ? handle->ptr : 0; });
+	const double hash_ns = time_lookups([](const TextureViewInfo& key) { return std::hash<TextureViewInfo>{}(key); });
+
+	info_log("view cache benchmark: {} views, {} iterations | unordered_map::find {:.1f} ns, FlatHashMap::find {:.1f} ns per lookup ({:.2f}x), {:.1f} ns of that hashing",
+		num_views, num_iterations, node_ns, flat_ns, node_ns / flat_ns, hash_ns);
+	return 0;
+}
+
+// num_meshes copies of the kitten's vertices staged on the null backend, once raw and once as lz4 payloads. the copies never
+// run, so this is the cpu side of a level load: memcpy into the upload ring against decompressing into it on workers
+auto run_upload_benchmark(u32 num_meshes) -> int {
+	using namespace d;
+	auto& reg = InitHeadlessContext(1280, 720, 3);
+	auto [verts, indices] = load_model("assets/models/kitten.obj");
+	const auto vert_bytes = ByteSpan(verts);
+	const auto payload = compress_payload(vert_bytes);
+	std::vector<Resource<Buffer>> vbos(num_meshes);
+	for (auto& vbo : vbos) vbo = reg.create_buffer(BufferCreateInfo{ .size = vert_bytes.size(), .usage = MemoryUsage::GPU });
+
+	const auto time_staging = [&](auto&& stage) {
+		Stager stager;
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		for (const auto& vbo : vbos) stage(stager, vbo);
+		stager.stage_block_until_over();
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+	};
+	const double raw_ms = time_staging([&](Stager& stager, Resource<Buffer> vbo) { stager.stage_buffer(vbo, vert_bytes); });
+	const double compressed_ms = time_staging([&](Stager& stager, Resource<Buffer> vbo) { stager.stage_compressed_buffer(vbo, ByteSpan(payload)); });
+
+	info_log("upload benchmark: {} meshes of {:.1f} KB ({:.1f} KB as payload) | raw {:.3f} ms, compressed {:.3f} ms",
+		num_meshes, vert_bytes.size() / 1024., payload.size() / 1024., raw_ms, compressed_ms);
+	c.report_stats();
+	return 0;
+}
+
+// num_draws draws recorded, compiled (a graph cache hit) and executed every frame on the null backend. after the warm up
+// frames have grown the recorder, the command lists and execute's bookkeeping, a frame shouldn't touch the heap at all
+auto run_record_benchmark(u32 num_draws, u32 num_frames) -> int {
+	using namespace d;
+	auto& reg = InitHeadlessContext(1280, 720, 3);
+	const auto vbo = reg.create_buffer(BufferCreateInfo{ .size = 64 * 1024, .usage = MemoryUsage::GPU });
+	const auto ibo = reg.create_buffer(BufferCreateInfo{ .size = 64 * 1024, .usage = MemoryUsage::GPU });
+	GraphicsPipeline pl;
+	CommandGraph graph;
+
+	u64 num_allocations = 0;
+	double record_ns = 0.;
+	double execute_ms = 0.;
+	const u32 num_warm_up_frames = 2 * static_cast<u32>(c.frames.size());
+	for (u32 i = 0; i < num_warm_up_frames + num_frames; ++i) {
+		(void)c.BeginRendering();
+		const u64 allocations_before = get_num_heap_allocations();
+		graph.recorder.reset();
+		auto [recorder] = graph.record();
+		const auto& output_image = c.swap_chain.images[0];
+		for (u32 draw = 0; draw < num_draws; ++draw) {
+			recorder.draw(DrawInfo{
+				.resources = { vbo.ref(AccessDomain::eVertex), output_image.ref(AccessType::eRenderTarget) },
+				.push_constants = { ByteSpan(vbo.read_view(true, 0, 1024, {}).desc_index()) },
+				.draw_cmds = { DrawCmd{ .ibo_view = ibo.ibo_view(0, 3 * 1024), .index_count_per_instance = 3 * 1024, .instance_count = 1 } },
+				.pl = &pl,
+				.debug_name = "draw",
+			});
+		}
+		recorder.mark_output(output_image);
+		graph.compile();
+		graph.execute();
+		const u64 allocations = get_num_heap_allocations() - allocations_before;
+		c.EndRendering();
+		if (i < num_warm_up_frames) continue;
+		num_allocations += allocations;
+		record_ns += graph.recorder.stats.record_ns;
+		execute_ms += graph.record_stats.execute_ms;
+	}
+
+	info_log("record benchmark: {} draws over {} frames | {:.2f} heap allocations per frame, {:.1f} ns per draw to record, {:.1f} ns per draw to execute",
+		num_draws, num_frames, static_cast<double>(num_allocations) / num_frames, record_ns / (static_cast<double>(num_draws) * num_frames),
+		execute_ms * 1e6 / (static_cast<double>(num_draws) * num_frames));
+	graph.report_stats();
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && std::string_view(argv[1]) == "--headless") {
+		return run_headless(argc > 2 ? static_cast<u32>(std::stoul(argv[2])) : 100u);
+	}
+	if (argc > 1 && std::string_view(argv[1]) == "--bench-barriers") {
+		return run_barrier_benchmark(argc > 2 ? static_cast<u32>(std::stoul(argv[2])) : 100000u, 10);
+	}
+	if (argc > 1 && std::string_view(argv[1]) == "--bench-graphify") {
+		return run_graphify_benchmark();
+	}
+	if (argc > 1 && std::string_view(argv[1]) == "--bench-view-cache") {
+		return run_view_cache_benchmark(argc > 2 ? static_cast<u32>(std::stoul(argv[2])) : 4096u, 100);
+	}
+	if (argc > 1 && std::string_view(argv[1]) == "--bench-uploads") {
+		return run_upload_benchmark(argc > 2 ? static_cast<u32>(std::stoul(argv[2])) : 1000u);
+	}
+	if (argc > 1 && std::string_view(argv[1]) == "--bench-record") {
+		return run_record_benchmark(argc > 2 ? static_cast<u32>(std::stoul(argv[2])) : 10000u, 100);
+	}
+
 	glfwInit();
 
 	GLFWwindow* window;
@@ -49,6 +316,7 @@ int main() {
 	d::Resource<d::Buffer> vbo;
 	d::Resource<d::Buffer> ibo;
 	d::GraphicsPipeline pl;
+	std::vector<d::ResourceFuture> uploads;
 	{
 		using namespace d;
 
@@ -58,7 +326,7 @@ int main() {
 		Stager stager;
 		stager.stage_buffer(vbo, vert_bytes);
 		stager.stage_buffer(ibo, indices_bytes);
-		stager.stage_block_until_over();
+		std::ranges::copy(stager.flush(), std::back_inserter(uploads));
 
 		assets.add_shader("shaders/test.hlsl", d::ShaderType::VERTEX, "test_vs");
 		assets.add_shader("shaders/test.hlsl", d::ShaderType::FRAGMENT, "test_fs");
@@ -70,34 +338,10 @@ int main() {
 			.build(true, 3);
 	}
 	d::CommandGraph graph;
-	{
-		struct DrawConsts {
-			u32 vbo_loc;
-		};
-		using namespace d;
-		auto [recorder] = graph.record();
-		const auto& output_image = c.swap_chain.images[0];
-		recorder.draw(DrawInfo{
-			.resources = { vbo.ref(AccessDomain::eVertex), output_image.ref(AccessType::eRenderTarget) },
-			.push_constants = {
-				ByteSpan(DrawConsts {
-					.vbo_loc = vbo.read_view(true, 0, static_cast<u32>(verts.size()), {})
-												.desc_index(),
-				})
-			},
-			.draw_cmds = {
-				DrawCmd {
-					.ibo_view = ibo.ibo_view(0, static_cast<u32>(indices.size())),
-					.index_count_per_instance = static_cast<u32>(indices.size()),
-					.instance_count = 1,
-					.start_index_location = 0,
-				},
-			},
-			.debug_name = "GBuffer",
-		});
-		graph.graphify();
-		graph.flatten();
-	}
+	const auto record = [&] { record_frame(graph, vbo, ibo, static_cast<u32>(verts.size()), static_cast<u32>(indices.size()), pl, uploads); };
+	record();
+	graph.report_stats();
+	graph.export_trace("output/graph_trace.json");
 
 	auto prev_time = static_cast<float>(glfwGetTime());
 	float dt = 0.;
@@ -113,13 +357,18 @@ int main() {
 		auto t0 = glfwGetTime() * 1e3;
 		{
 			const auto [output_image, cl] = d::c.BeginRendering();
-			graph.do_commands(cl);
+			record();
+			graph.execute();
 			d::c.EndRendering();
 		}
 		auto t1 = glfwGetTime() * 1e3;
 		glfwSetWindowTitle(window, std::format("b | Render Time: {:.2f} ms", t1 - t0).c_str());
 		glfwPollEvents();
 	}
+	// frames still in flight reference the graph's lists and resources
+	d::c.wait_for_fences(d::c.get_fences());
+	graph.report_stats();
+	d::c.report_stats();
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	return 0;
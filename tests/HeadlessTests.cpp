@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <set>
+
+#include "d/CommandGraph.h"
+#include "d/Compression.h"
+#include "d/Context.h"
+#include "d/HeapAllocations.h"
+#include "d/Stager.h"
+#include "d/WorkerPool.h"
+
+using namespace d;
+
+namespace {
+	// every test gets a fresh null backend, the context is a global
+	struct Headless : testing::Test {
+		ResourceRegistry* reg{ nullptr };
+
+		auto SetUp() -> void override { reg = &InitHeadlessContext(1280, 720, 3); }
+
+		auto make_buffers(u32 count, u64 size = 256) const -> std::vector<Resource<Buffer>> {
+			std::vector<Resource<Buffer>> buffers(count);
+			for (auto& buffer : buffers) buffer = reg->create_buffer(BufferCreateInfo{ .size = size, .usage = MemoryUsage::GPU });
+			return buffers;
+		}
+	};
+
+	// the first half of buffers copied into the second half and back, every handle needs a barrier between the two steps
+	auto record_copy_graph(CommandGraph& graph, std::span<const Resource<Buffer>> buffers) -> void {
+		const auto half = static_cast<u32>(buffers.size() / 2);
+		graph.recorder.reset();
+		auto [recorder] = graph.record();
+		for (u32 b = 0; b < half; ++b) recorder.copy_buffer(CopyBufferInfo{ .dst = buffers[half + b], .src = buffers[b], .num_bytes = 256 });
+		for (u32 b = 0; b < half; ++b) recorder.copy_buffer(CopyBufferInfo{ .dst = buffers[b], .src = buffers[half + b], .num_bytes = 256 });
+		for (u32 b = 0; b < half; ++b) recorder.mark_output(buffers[b]);
+	}
+
+	// num_draws draws of the same buffers onto the swap chain, the way a frame is recorded every frame
+	auto record_draw_graph(CommandGraph& graph, Resource<Buffer> vbo, Resource<Buffer> ibo, const GraphicsPipeline& pl, u32 num_draws) -> void {
+		graph.recorder.reset();
+		auto [recorder] = graph.record();
+		const auto& output_image = c.swap_chain.images[0];
+		for (u32 i = 0; i < num_draws; ++i) {
+			recorder.draw(DrawInfo{
+				.resources = { vbo.ref(AccessDomain::eVertex), output_image.ref(AccessType::eRenderTarget) },
+				.push_constants = { ByteSpan(vbo.read_view(true, 0, 64, {}).desc_index()) },
+				.draw_cmds = { DrawCmd{ .ibo_view = ibo.ibo_view(0, 36), .index_count_per_instance = 36, .instance_count = 1 } },
+				.pl = &pl,
+				.debug_name = "draw",
+			});
+		}
+		recorder.mark_output(output_image);
+		graph.compile();
+	}
+
+	auto make_bytes(usize size) -> std::vector<std::byte> {
+		std::vector<std::byte> bytes(size);
+		// repeats often enough for lz4 to find matches
+		for (usize i = 0; i < size; ++i) bytes[i] = static_cast<std::byte>((i / 7) % 13);
+		return bytes;
+	}
+}
+
+TEST_F(Headless, ResourcesAreTrackedWithoutADevice) {
+	const auto stats_before = c.headless_stats;
+	const auto buffers = make_buffers(4, 1000);
+	EXPECT_EQ(c.headless_stats.num_resources, stats_before.num_resources + 4);
+	// placed at the default resource alignment
+	EXPECT_EQ(c.headless_stats.resource_bytes, stats_before.resource_bytes + 4 * D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+	for (const auto& buffer : buffers) EXPECT_TRUE(reg->is_alive(buffer));
+	EXPECT_EQ(get_native_res(buffers[0]), nullptr);
+}
+
+TEST_F(Headless, ReleasedHandlesGoStale) {
+	const auto buffer = make_buffers(1)[0];
+	c.release_resource(buffer);
+	EXPECT_FALSE(reg->is_alive(buffer));
+
+	// the slot comes back with a new generation once the release got collected
+	for (u32 i = 0; i < default_frames_in_flight + 1; ++i) {
+		(void)c.BeginRendering();
+		c.EndRendering();
+	}
+	const auto reused = make_buffers(1)[0];
+	EXPECT_TRUE(reg->is_alive(reused));
+	EXPECT_FALSE(reg->is_alive(buffer));
+}
+
+TEST_F(Headless, ViewsAreCachedPerResource) {
+	const auto buffer = make_buffers(1)[0];
+	const u32 views_before = c.headless_stats.num_views;
+	const u32 index = buffer.read_view(true, 0, 64, {}).desc_index();
+	EXPECT_EQ(buffer.read_view(true, 0, 64, {}).desc_index(), index);
+	EXPECT_EQ(c.headless_stats.num_views, views_before + 1);
+	EXPECT_NE(buffer.read_view(true, 64, 64, {}).desc_index(), index);
+}
+
+TEST_F(Headless, CopyGraphBarriersEveryHandleOnce) {
+	const auto buffers = make_buffers(16);
+	CommandGraph graph;
+	record_copy_graph(graph, buffers);
+	graph.compile();
+	const auto& stats = graph.compiled->stats;
+	EXPECT_EQ(stats.num_commands, 16u);
+	EXPECT_EQ(stats.num_steps, 2u);
+	EXPECT_EQ(stats.num_barriers, 16u);
+	EXPECT_EQ(stats.num_culled_commands, 0u);
+}
+
+TEST_F(Headless, SameTopologyHitsTheGraphCache) {
+	const auto buffers = make_buffers(8);
+	CommandGraph graph;
+	for (u32 i = 0; i < 3; ++i) {
+		record_copy_graph(graph, buffers);
+		graph.compile();
+	}
+	EXPECT_EQ(graph.cache_stats.misses, 1u);
+	EXPECT_EQ(graph.cache_stats.hits, 2u);
+
+	// reversing the halves is a different topology
+	std::vector reversed(buffers.rbegin(), buffers.rend());
+	record_copy_graph(graph, reversed);
+	graph.compile();
+	EXPECT_EQ(graph.cache_stats.misses, 2u);
+}
+
+TEST(WorkerPool, BatchesReuseTheSameThreads) {
+	WorkerPool pool(3);
+	std::mutex mutex;
+	std::set<std::thread::id> ids;
+	for (u32 batch = 0; batch < 100; ++batch) {
+		std::atomic<u32> mask{ 0 };
+		pool.run(4, [&](u32 thread_index) {
+			mask |= 1u << thread_index;
+			std::scoped_lock lock(mutex);
+			ids.insert(std::this_thread::get_id());
+		});
+		EXPECT_EQ(mask, 0b1111u);
+	}
+	EXPECT_EQ(ids.size(), 4u);
+
+	// fewer threads than workers leaves the rest asleep
+	std::atomic<u32> num_ran{ 0 };
+	pool.run(2, [&](u32 thread_index) { EXPECT_LT(thread_index, 2u); ++num_ran; });
+	EXPECT_EQ(num_ran, 2u);
+}
+
+TEST_F(Headless, ExecuteSubmitsToTheNullQueues) {
+	const auto buffers = make_buffers(8);
+	CommandGraph graph;
+	for (u32 i = 0; i < 4; ++i) {
+		(void)c.BeginRendering();
+		record_copy_graph(graph, buffers);
+		graph.compile();
+		graph.execute();
+		c.EndRendering();
+	}
+	EXPECT_GT(graph.record_stats.num_lists, 0u);
+	u32 num_submissions = 0;
+	for (usize q = 0; q < num_queue_types; ++q) num_submissions += c.get_queue(static_cast<QueueType>(q)).stats.num_submissions;
+	EXPECT_GE(num_submissions, 4u);
+	EXPECT_EQ(c.general_queue.stats.commands.num_copies, 4u * 8u);
+}
+
+TEST_F(Headless, WarmFramesRecordAndExecuteWithoutAllocating) {
+	const auto buffers = make_buffers(2, 4096);
+	GraphicsPipeline pl;
+	CommandGraph graph;
+	// the first frames grow the recorder, the lists of every frame slot and execute's bookkeeping
+	for (u32 i = 0; i < 2 * default_frames_in_flight; ++i) {
+		(void)c.BeginRendering();
+		record_draw_graph(graph, buffers[0], buffers[1], pl, 1000);
+		graph.execute();
+		c.EndRendering();
+		if (i == 0) EXPECT_GT(graph.recorder.stats.num_allocations, 0u);
+	}
+	(void)c.BeginRendering();
+	const u64 before = get_num_heap_allocations();
+	record_draw_graph(graph, buffers[0], buffers[1], pl, 1000);
+	graph.execute();
+	const u64 after = get_num_heap_allocations();
+	c.EndRendering();
+	EXPECT_EQ(after - before, 0u);
+	EXPECT_EQ(graph.recorder.stats.num_allocations, 0u);
+	EXPECT_EQ(graph.record_stats.num_allocations, 0u);
+	EXPECT_EQ(graph.cache_stats.misses, 1u);
+}
+
+TEST_F(Headless, StagedBuffersArePackedIntoTheUploadRing) {
+	const auto buffer = make_buffers(1, 1024)[0];
+	const auto data = make_bytes(1024);
+	Stager stager;
+	stager.stage_buffer(buffer, ByteSpan(data));
+	const auto futures = stager.flush();
+	ASSERT_EQ(futures.size(), 1u);
+	EXPECT_EQ(c.upload_ring.stats.num_copies, 1u);
+	EXPECT_EQ(c.upload_ring.stats.num_bytes, data.size());
+	EXPECT_EQ(std::memcmp(c.upload_ring.mapped, data.data(), data.size()), 0);
+	futures[0].wait();
+	EXPECT_TRUE(futures[0].ready());
+}
+
+TEST_F(Headless, CompressedPayloadsDecompressIntoTheUploadRing) {
+	const auto data = make_bytes(300'000);
+	const auto payload = compress_payload(data);
+	EXPECT_LT(payload.size(), data.size());
+	const auto buffer = make_buffers(1, data.size())[0];
+
+	Stager stager;
+	stager.stage_compressed_buffer(buffer, ByteSpan(payload));
+	EXPECT_EQ(stager.flush().size(), 1u);
+	EXPECT_EQ(c.upload_ring.stats.num_decompressed_bytes, data.size());
+	EXPECT_EQ(std::memcmp(c.upload_ring.mapped, data.data(), data.size()), 0);
+}
+
+TEST_F(Headless, CorruptPayloadsFailTheirFutureWithoutCopies) {
+	const auto data = make_bytes(300'000);
+	const auto good = compress_payload(data);
+	auto corrupt_chunks = good;
+	// every chunk an lz4 sequence whose literals run past its end
+	const usize chunks_offset = sizeof(PayloadHeader) + sizeof(u32) * ((data.size() + default_payload_chunk_size - 1) / default_payload_chunk_size);
+	std::fill(corrupt_chunks.begin() + chunks_offset, corrupt_chunks.end(), std::byte{ 0xff });
+	const auto not_a_payload = make_bytes(1000);
+	const auto buffers = make_buffers(3, data.size());
+
+	Stager stager;
+	stager.stage_compressed_buffer(buffers[0], ByteSpan(not_a_payload));
+	stager.stage_compressed_buffer(buffers[1], ByteSpan(corrupt_chunks));
+	stager.stage_compressed_buffer(buffers[2], ByteSpan(good));
+	const auto futures = stager.flush();
+	ASSERT_EQ(futures.size(), 3u);
+	EXPECT_TRUE(futures[0].failed);
+	EXPECT_TRUE(futures[1].failed);
+	EXPECT_FALSE(futures[2].failed);
+	EXPECT_TRUE(futures[0].ready());
+	EXPECT_TRUE(futures[1].ready());
+	EXPECT_EQ(c.upload_ring.stats.num_copies, 1u);
+	EXPECT_EQ(c.general_queue.stats.commands.num_copies + c.async_transfer_queue.stats.commands.num_copies, 1u);
+}
+
+TEST_F(Headless, ReadbacksAreDeliveredOnceWaitedOn) {
+	const auto buffer = make_buffers(1)[0];
+	u32 num_delivered = 0;
+	(void)c.BeginRendering();
+	auto future = c.readback_ring.request_readback(buffer, 0, 256, [&](const ReadbackResult& result) {
+		EXPECT_EQ(result.data.size(), 256u);
+		++num_delivered;
+	});
+	c.EndRendering();
+	future.wait();
+	EXPECT_EQ(num_delivered, 1u);
+}